@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+/// @brief The instruction set the engine's SIMD kernels were built for, set by the @c ENABLE_AVX2 CMake option
+inline const char* simd_width_name() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * @brief Runs @c function @c repetitions times and returns the fastest run in seconds
+ *
+ * The fastest run is the one least disturbed by the rest of the machine, @c function is also run once beforehand so caches and allocations are warm
+ */
+template <typename Function>
+double fastest_run_seconds(int repetitions, Function&& function) {
+    function();
+    double fastest = 1e30;
+    for (int i = 0; i < repetitions; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        fastest = std::min(fastest, elapsed.count());
+    }
+    return fastest;
+}
+
+/// @brief Prints one result line, @c items is how many things (matrices, boxes) one run processed
+inline void print_throughput(const std::string& name, std::size_t items, double seconds) {
+    std::printf("  %-34s %9.2f M/s  %8.3f ms per run  %8.3f ms per million\n",
+                name.c_str(), static_cast<double>(items) / seconds * 1e-6, seconds * 1e3, seconds * 1e3 * 1e6 / static_cast<double>(items));
+}
@@ -0,0 +1,85 @@
+/**
+ * Measures how many boxes per second @ref cull_aabbs tests against the camera frustum, against calling @ref is_aabb_visible once per instance
+ * like the CPU culling path did before the boxes were kept in @ref WorldAABBs
+ *
+ * Usage: frustum_culling_benchmark [instance count] [repetitions]
+ */
+
+#include "Benchmark.h"
+
+#include "Core/Camera.h"
+#include "Renderer/Culling/FrustumCulling.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr std::size_t DEFAULT_INSTANCE_COUNT = 1'000'000;
+    constexpr int DEFAULT_REPETITIONS = 20;
+
+    /// @brief Instances scattered around the camera, wider than the far plane so a realistic share of them is culled
+    std::vector<glm::mat4> random_models(std::size_t count) {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> scale(0.2f, 3.0f);
+
+        std::vector<glm::mat4> models(count);
+        for (glm::mat4& model : models) {
+            model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+            model = glm::rotate(model, angle(random), glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+            model = glm::scale(model, glm::vec3(scale(random)));
+        }
+        return models;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_INSTANCE_COUNT;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : DEFAULT_REPETITIONS;
+    const std::vector<glm::mat4> models = random_models(count);
+    const glm::vec3 local_min{ -0.5f }, local_max{ 0.5f };
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f);
+    camera.update_vectors();
+    const Frustum frustum = Frustum::from_camera(camera, 16.0f / 9.0f);
+
+    std::printf("Culling %zu instances, fastest of %d runs, %s build\n", count, repetitions, simd_width_name());
+
+    std::vector<std::uint8_t> scalar_visible(count);
+    const double scalar_seconds = fastest_run_seconds(repetitions, [&] {
+        for (std::size_t i = 0; i < count; i++)
+            scalar_visible[i] = is_aabb_visible(frustum, models[i], local_min, local_max);
+    });
+
+    // Filling the columns is paid once per moved instance, not every frame, so it is timed on its own
+    WorldAABBs boxes;
+    boxes.resize(count);
+    const double set_seconds = fastest_run_seconds(repetitions, [&] {
+        for (std::size_t i = 0; i < count; i++)
+            boxes.set(i, models[i], local_min, local_max);
+    });
+
+    std::vector<std::uint8_t> batch_visible(count);
+    const double batch_seconds = fastest_run_seconds(repetitions, [&] { cull_aabbs(frustum, boxes, batch_visible.data()); });
+
+    std::size_t visible = 0, mismatches = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        visible += batch_visible[i];
+        mismatches += batch_visible[i] != scalar_visible[i];
+    }
+
+    print_throughput("is_aabb_visible per instance", count, scalar_seconds);
+    print_throughput("WorldAABBs::set", count, set_seconds);
+    print_throughput("cull_aabbs", count, batch_seconds);
+    std::printf("cull_aabbs speedup over is_aabb_visible: %.1fx\n", scalar_seconds / batch_seconds);
+    std::printf("Visible: %zu of %zu, %zu results differ from is_aabb_visible\n", visible, count, mismatches);
+    return 0;
+}
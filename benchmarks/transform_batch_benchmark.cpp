@@ -0,0 +1,189 @@
+/**
+ * Measures how many model matrices per second the @ref TransformSystem composes, against the path @ref TransformComponent setters used to take
+ * before the batch pass: building a translation, rotation and scale @c glm::mat4 and multiplying them on every setter call
+ *
+ * Besides the kernel on its own it times the two ways the system really calls it:
+ * - @c syncChangedTransforms mirrors the changed transforms into the @ref SoAComponentManager and composes them from its columns at their indices
+ * - @c interpolateTransforms blends the last two ticks into a @ref TransformBatch and writes the matrices straight into the instance data
+ *
+ * Usage: transform_batch_benchmark [transform count] [repetitions]
+ */
+
+#include "Benchmark.h"
+
+#include "ECS_modules/Transform/Transform_batch.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr std::size_t DEFAULT_TRANSFORM_COUNT = 100'000;
+    constexpr int DEFAULT_REPETITIONS = 50;
+
+    std::vector<TransformTRS> random_transforms(std::size_t count) {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.1f, 4.0f);
+
+        std::vector<TransformTRS> transforms(count);
+        for (TransformTRS& trs : transforms) {
+            float x = component(random), y = component(random), z = component(random), w = component(random);
+            const float length = std::sqrt(x * x + y * y + z * z + w * w);
+            x /= length;
+            y /= length;
+            z /= length;
+            w /= length;
+            trs = TransformTRS{
+                .positionX = position(random), .positionY = position(random), .positionZ = position(random),
+                .rotationX = x, .rotationY = y, .rotationZ = z, .rotationW = w,
+                .scaleX = scale(random), .scaleY = scale(random), .scaleZ = scale(random),
+            };
+        }
+        return transforms;
+    }
+
+    /// @brief Same size and layout as @c meshRenderer::PerInstanceData, which needs daxa
+    struct InstanceData {
+        float model_matrix[16];
+        std::uint64_t texture;
+        std::uint64_t tex_sampler;
+        std::uint32_t pad0;
+        std::uint32_t pad1;
+    };
+
+    /// @brief What @c TransformComponent::updateModelMatrix did on every setter call before the batch pass
+    glm::mat4 compose_old_path(const TransformTRS& trs) {
+        const glm::mat4 rotation = glm::toMat4(glm::quat(trs.rotationW, trs.rotationX, trs.rotationY, trs.rotationZ));
+        const glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::vec3(trs.positionX, trs.positionY, trs.positionZ));
+        const glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(trs.scaleX, trs.scaleY, trs.scaleZ));
+        return translation * rotation * scale;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_TRANSFORM_COUNT;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : DEFAULT_REPETITIONS;
+    const std::vector<TransformTRS> transforms = random_transforms(count);
+
+    std::printf("Composing %zu transforms, fastest of %d runs, %s build\n", count, repetitions, simd_width_name());
+
+    std::vector<glm::mat4> old_matrices(count);
+    const double old_seconds = fastest_run_seconds(repetitions, [&] {
+        for (std::size_t i = 0; i < count; i++)
+            old_matrices[i] = compose_old_path(transforms[i]);
+    });
+
+    // The kernel on its own, composing contiguous columns into matrix columns
+    std::vector<float> columns[10];
+    for (std::vector<float>& column : columns)
+        column.resize(count);
+    for (std::size_t i = 0; i < count; i++) {
+        const TransformTRS& trs = transforms[i];
+        const float fields[10] = { trs.positionX, trs.positionY, trs.positionZ, trs.rotationX, trs.rotationY, trs.rotationZ, trs.rotationW, trs.scaleX, trs.scaleY, trs.scaleZ };
+        for (std::size_t field = 0; field < 10; field++)
+            columns[field][i] = fields[field];
+    }
+    const TRSColumns kernel_inputs{
+        columns[0].data(), columns[1].data(), columns[2].data(),
+        columns[3].data(), columns[4].data(), columns[5].data(), columns[6].data(),
+        columns[7].data(), columns[8].data(), columns[9].data(),
+    };
+    std::vector<float> outputs[4][3];
+    MatrixColumns kernel_outputs;
+    for (std::size_t column = 0; column < 4; column++) {
+        for (std::size_t row = 0; row < 3; row++) {
+            outputs[column][row].resize(count);
+            kernel_outputs.elements[column][row] = outputs[column][row].data();
+        }
+    }
+    const double kernel_seconds = fastest_run_seconds(repetitions, [&] { composeTransformMatrices(kernel_inputs, kernel_outputs, count); });
+
+    // syncChangedTransforms: every transform changed, its TransformTRS is overwritten and its matrix composed from the manager's columns at its index
+    SoAComponentManager<TransformTRS> trs_manager;
+    for (std::size_t i = 0; i < count; i++)
+        trs_manager.addComponent(makeEntity(static_cast<std::uint32_t>(i + 1), 0), transforms[i]);
+    std::vector<std::uint32_t> indices;
+    std::vector<glm::mat4> sync_matrices(count);
+    std::vector<float*> sync_destinations;
+    for (glm::mat4& matrix : sync_matrices)
+        sync_destinations.push_back(glm::value_ptr(matrix));
+    const double sync_seconds = fastest_run_seconds(repetitions, [&] {
+        indices.clear();
+        for (std::size_t i = 0; i < count; i++) {
+            const Entity entity = makeEntity(static_cast<std::uint32_t>(i + 1), 0);
+            trs_manager.setComponent(entity, transforms[i]);
+            indices.push_back(trs_manager.indexOf(entity));
+        }
+        composeTransformMatrices(trsColumnsOf(trs_manager), indices.data(), sync_destinations.data(), count);
+    });
+
+    // The same mirroring with the old path composing each matrix
+    std::vector<glm::mat4> old_sync_matrices(count);
+    const double old_sync_seconds = fastest_run_seconds(repetitions, [&] {
+        for (std::size_t i = 0; i < count; i++) {
+            trs_manager.setComponent(makeEntity(static_cast<std::uint32_t>(i + 1), 0), transforms[i]);
+            old_sync_matrices[i] = compose_old_path(transforms[i]);
+        }
+    });
+
+    // interpolateTransforms: blend into the batch and write each matrix into its instance, the instances of a mesh are spread over its instance data
+    std::vector<InstanceData> instances(count);
+    std::vector<float*> instance_destinations(count);
+    std::mt19937 shuffle_random(99);
+    std::vector<std::size_t> instance_order(count);
+    for (std::size_t i = 0; i < count; i++)
+        instance_order[i] = i;
+    std::shuffle(instance_order.begin(), instance_order.end(), shuffle_random);
+    for (std::size_t i = 0; i < count; i++)
+        instance_destinations[i] = instances[instance_order[i]].model_matrix;
+    TransformBatch batch;
+    const double interpolate_seconds = fastest_run_seconds(repetitions, [&] {
+        batch.clear();
+        for (const TransformTRS& trs : transforms)
+            batch.push(interpolateTRS(trs, trs, 0.5f));
+        batch.compose(instance_destinations.data());
+    });
+
+    // The old path writing into the same instances, for the end to end comparison
+    const double old_instances_seconds = fastest_run_seconds(repetitions, [&] {
+        for (std::size_t i = 0; i < count; i++) {
+            const glm::mat4 matrix = compose_old_path(interpolateTRS(transforms[i], transforms[i], 0.5f));
+            std::copy_n(glm::value_ptr(matrix), 16, instance_destinations[i]);
+        }
+    });
+
+    float max_error = 0.0f;
+    for (std::size_t i = 0; i < count; i++) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                max_error = std::max(max_error, std::abs(sync_matrices[i][column][row] - old_matrices[i][column][row]));
+                max_error = std::max(max_error, std::abs(instance_destinations[i][column * 4 + row] - old_matrices[i][column][row]));
+                if (row < 3)
+                    max_error = std::max(max_error, std::abs(outputs[column][row][i] - old_matrices[i][column][row]));
+            }
+        }
+    }
+
+    print_throughput("translate * toMat4 * scale (old)", count, old_seconds);
+    print_throughput("composeTransformMatrices", count, kernel_seconds);
+    print_throughput("syncChangedTransforms path", count, sync_seconds);
+    print_throughput("sync with the old path", count, old_sync_seconds);
+    print_throughput("interpolateTransforms path", count, interpolate_seconds);
+    print_throughput("interpolate with the old path", count, old_instances_seconds);
+    std::printf("Kernel speedup over the old path: %.1fx\n", old_seconds / kernel_seconds);
+    std::printf("syncChangedTransforms speedup over the old path: %.1fx\n", old_sync_seconds / sync_seconds);
+    std::printf("interpolateTransforms speedup over the old path: %.1fx\n", old_instances_seconds / interpolate_seconds);
+    std::printf("Max abs difference from the old path: %g\n", max_error);
+    return 0;
+}
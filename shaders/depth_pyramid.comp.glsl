@@ -0,0 +1,26 @@
+#include <mesh_rendering_shared.inl>
+
+DAXA_DECL_PUSH_CONSTANT(DepthPyramidPushConstant, push)
+
+layout(local_size_x = DEPTH_PYRAMID_WORKGROUP_SIZE, local_size_y = DEPTH_PYRAMID_WORKGROUP_SIZE) in;
+
+void main() {
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(texel, push.dst_size)))
+        return;
+
+    // Every source texel the destination texel overlaps, the sizes don't have to halve exactly so odd sizes stay conservative
+    uvec2 begin = (texel * push.src_size) / push.dst_size;
+    uvec2 end = max(((texel + 1u) * push.src_size + push.dst_size - 1u) / push.dst_size, begin + 1u);
+
+    float farthest = 0.0;
+    for (daxa_u32 y = begin.y; y < end.y; y++) {
+        for (daxa_u32 x = begin.x; x < end.x; x++) {
+            float depth = push.from_depth != 0
+                ? texelFetch(daxa_sampler2D(push.src, push.depth_sampler), ivec2(x, y), 0).r
+                : imageLoad(daxa_image2D(push.src), ivec2(x, y)).r;
+            farthest = max(farthest, depth);
+        }
+    }
+    imageStore(daxa_image2D(push.dst), ivec2(texel), vec4(farthest));
+}
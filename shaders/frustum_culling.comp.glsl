@@ -0,0 +1,139 @@
+#include <mesh_rendering_shared.inl>
+
+DAXA_DECL_PUSH_CONSTANT(CullPushConstant, push)
+
+layout(local_size_x = CULL_WORKGROUP_SIZE) in;
+
+// The world space box around the local bounds transformed by the model matrix, see WorldAABBs::set in FrustumCulling.h for the CPU version
+void world_bounds(daxa_f32mat4x4 model, daxa_f32vec3 aabb_min, daxa_f32vec3 aabb_max, out vec3 center, out vec3 extent) {
+    vec3 local_center = (aabb_min + aabb_max) * 0.5;
+    vec3 local_extent = (aabb_max - aabb_min) * 0.5;
+
+    center = (model * vec4(local_center, 1.0)).xyz;
+    // The extent along each world axis, GLSL has no abs() for matrices so it is summed column by column
+    extent = abs(model[0].xyz) * local_extent.x + abs(model[1].xyz) * local_extent.y + abs(model[2].xyz) * local_extent.z;
+}
+
+// Checks the box against every plane, see is_aabb_visible in FrustumCulling.h for the CPU version
+bool is_in_frustum(vec3 center, vec3 extent, UniformBufferObject ubo) {
+    for (int i = 0; i < 6; i++) {
+        vec4 plane = ubo.frustum_planes[i];
+        // The box is outside if even its corner furthest along the normal is behind the plane
+        if (dot(plane.xyz, center) + dot(abs(plane.xyz), extent) + plane.w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+// Checks if the nearest depth of the box is behind the farthest depth of the pyramid texels its screen rectangle covers
+bool is_occluded(vec3 center, vec3 extent, UniformBufferObject ubo) {
+    mat4 view_proj = ubo.proj * ubo.view;
+
+    vec2 uv_min = vec2(1.0);
+    vec2 uv_max = vec2(0.0);
+    float nearest = 1.0;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 corner_sign = vec3((corner & 1) != 0 ? 1.0 : -1.0, (corner & 2) != 0 ? 1.0 : -1.0, (corner & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = view_proj * vec4(center + extent * corner_sign, 1.0);
+        // A box that reaches behind the camera covers the whole screen
+        if (clip.w <= 0.0)
+            return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+        uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z);
+    }
+    uv_min = clamp(uv_min, 0.0, 1.0);
+    uv_max = clamp(uv_max, 0.0, 1.0);
+
+    // The level where the rectangle is at most one texel across, so it touches at most 2x2 texels
+    vec2 size = (uv_max - uv_min) * vec2(push.depth_pyramid_size);
+    int level = max(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0);
+    if (level >= DEPTH_PYRAMID_MIP_COUNT)
+        return false;
+
+    ivec2 level_size = max(ivec2(push.depth_pyramid_size) >> level, ivec2(1));
+    ivec2 texel_min = clamp(ivec2(uv_min * vec2(level_size)), ivec2(0), level_size - 1);
+    ivec2 texel_max = clamp(ivec2(uv_max * vec2(level_size)), ivec2(0), level_size - 1);
+
+    float farthest = 0.0;
+    for (int y = texel_min.y; y <= texel_max.y; y++) {
+        for (int x = texel_min.x; x <= texel_max.x; x++)
+            farthest = max(farthest, texelFetch(daxa_sampler2D(push.depth_pyramid, push.depth_sampler), ivec2(x, y), level).r);
+    }
+    return nearest > farthest;
+}
+
+// The coarsest level whose error covers less than LOD_ERROR_THRESHOLD of the screen's height, see select_lod in LodSelection.h for the CPU version
+daxa_u32 select_lod(CullDrawInfo info, daxa_f32mat4x4 model, vec3 center, vec3 extent, UniformBufferObject ubo) {
+    float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+    // Measured to the nearest point of the sphere around the box, from inside it the full mesh is drawn
+    float camera_distance = length(center - ubo.camera_position) - length(extent);
+    if (camera_distance <= 0.0)
+        return 0u;
+
+    daxa_u32 lod = 0u;
+    for (daxa_u32 level = 1u; level < info.lod_count; level++) {
+        if (info.lods[level].error * scale * ubo.lod_error_scale > camera_distance)
+            break;
+        lod = level;
+    }
+    return lod;
+}
+
+void main() {
+    daxa_u32 index = gl_GlobalInvocationID.x;
+    if (index >= push.count)
+        return;
+
+    if (push.pass == CULL_PASS_INSTANCES) {
+        // One invocation per instance, survivors are appended to their draw and level's part of the visible list
+        daxa_u32 draw = deref(push.instance_draw_ptr[index]);
+        CullDrawInfo info = deref(push.draw_info_ptr[draw]);
+        PerInstanceData instance = deref(push.instance_buffer_ptr[index]);
+        UniformBufferObject ubo = deref(push.ubo_ptr);
+
+        vec3 center;
+        vec3 extent;
+        world_bounds(instance.model_matrix, info.aabb_min, info.aabb_max, center, extent);
+        bool visible = is_in_frustum(center, extent, ubo);
+        bool was_visible = deref(push.visibility_history_ptr[index]) != 0;
+
+        if (push.phase == CULL_PHASE_EARLY) {
+            // Whatever was visible last frame is drawn first without an occlusion test, its depth is what the pyramid is built from
+            visible = visible && was_visible;
+        } else {
+            // The late phase tests everything against this frame's pyramid and only draws what the early phase didn't
+            visible = visible && !is_occluded(center, extent, ubo);
+            deref(push.visibility_history_ptr[index]) = visible ? 1u : 0u;
+            visible = visible && !was_visible;
+        }
+
+        if (!visible)
+            return;
+
+        daxa_u32 lod = select_lod(info, instance.model_matrix, center, extent, ubo);
+        // Each level of a draw has room for all of the draw's instances
+        daxa_u32 slot = atomicAdd(deref(push.counter_ptr[1 + draw * MAX_LOD_COUNT + lod]), 1u);
+        deref(push.visible_instance_ptr[info.first_instance * MAX_LOD_COUNT + lod * info.instance_count + slot]) = index;
+    } else {
+        // One invocation per level of each draw, levels with no visible instances are left out of the command buffer
+        daxa_u32 visible_count = deref(push.counter_ptr[1 + index]);
+        if (visible_count == 0)
+            return;
+
+        daxa_u32 draw = index / MAX_LOD_COUNT;
+        daxa_u32 lod = index % MAX_LOD_COUNT;
+        CullDrawInfo info = deref(push.draw_info_ptr[draw]);
+        DrawCommand command;
+        command.index_count = info.lods[lod].index_count;
+        command.instance_count = visible_count;
+        command.first_index = info.lods[lod].first_index;
+        command.vertex_offset = info.vertex_offset;
+        command.first_instance = info.first_instance * MAX_LOD_COUNT + lod * info.instance_count;
+
+        daxa_u32 command_index = atomicAdd(deref(push.counter_ptr[0]), 1u);
+        deref(push.command_ptr[command_index]) = command;
+    }
+}
@@ -11,7 +11,9 @@ layout(location = 1) flat out int v_InstanceIndex;
 
 void main() {
     Vertex vert = deref(push.vertex_ptr[gl_VertexIndex]);
-    PerInstanceData instData = deref(push.instance_buffer_ptr[gl_InstanceIndex]);
+    // The culling pass compacts the visible instances of each draw, gl_InstanceIndex indexes that list and not the instance buffer
+    daxa_u32 instance_index = deref(push.visible_instance_ptr[gl_InstanceIndex]);
+    PerInstanceData instData = deref(push.instance_buffer_ptr[instance_index]);
     UniformBufferObject ubo = deref(push.ubo_ptr);
 
 //    vec4 world_pos = instData.model_matrix * vec4(vert.position, 1.0);
@@ -21,5 +23,5 @@ void main() {
     gl_Position = ubo.proj * ubo.view * instData.model_matrix * vec4(vert.position, 1.0);
 
     v_uv = vert.uv;
-    v_InstanceIndex = gl_InstanceIndex;
+    v_InstanceIndex = int(instance_index);
 }
\ No newline at end of file
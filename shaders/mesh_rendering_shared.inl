@@ -16,9 +16,31 @@ namespace meshRenderer {
 
 // Code that can be 100% shared between CPU and GPU
 
+#define CULL_WORKGROUP_SIZE 64
+/// The two dispatches of the culling pass, see frustum_culling.comp.glsl
+#define CULL_PASS_INSTANCES 0
+#define CULL_PASS_COMMANDS 1
+/// Occlusion culling draws in two phases, the instances visible last frame first and then the ones the depth pyramid shows were uncovered,
+/// each phase has its own part of the command, counter and visible instance buffers
+#define CULL_PHASE_EARLY 0
+#define CULL_PHASE_LATE 1
+#define CULL_PHASE_COUNT 2
+
+#define DEPTH_PYRAMID_WORKGROUP_SIZE 8
+/// The pyramid always has this many levels, boxes too big for its smallest level are never occluded
+#define DEPTH_PYRAMID_MIP_COUNT 8
+
+/// Meshes have up to this many levels of detail, each draw has one command slot per level
+#define MAX_LOD_COUNT 5
+
 struct UniformBufferObject {
     daxa_f32mat4x4 view;
     daxa_f32mat4x4 proj;
+    /// Left, right, bottom, top, near, far, xyz is the inward facing normal and w the distance
+    daxa_f32vec4 frustum_planes[6];
+    daxa_f32vec3 camera_position;
+    /// A LOD's error times this over its distance is the fraction of LOD_ERROR_THRESHOLD of the screen it covers, see lod_error_scale in LodSelection.h
+    daxa_f32 lod_error_scale;
 };
 
 struct PerInstanceData {
@@ -34,14 +56,83 @@ struct Vertex {
     daxa_f32vec2 uv;
 };
 
+/// One level of detail of a mesh, a range of the DrawGroup index buffer
+struct MeshLod {
+    daxa_u32 first_index;
+    daxa_u32 index_count;
+    /// How far the level's surface is from the full mesh, in the mesh's local units
+    daxa_f32 error;
+    daxa_u32 _pad0;
+};
+
+/// One draw of a DrawGroup as the culling pass sees it, the bounds are in the mesh's local space
+struct CullDrawInfo {
+    daxa_f32vec3 aabb_min;
+    daxa_u32 lod_count;
+    daxa_f32vec3 aabb_max;
+    daxa_i32 vertex_offset;
+    daxa_u32 first_instance;
+    daxa_u32 instance_count;
+    daxa_u32 _pad0;
+    daxa_u32 _pad1;
+    /// Finest first, only the first lod_count are set
+    MeshLod lods[MAX_LOD_COUNT];
+};
+
+/// Same layout as VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    daxa_u32 index_count;
+    daxa_u32 instance_count;
+    daxa_u32 first_index;
+    daxa_i32 vertex_offset;
+    daxa_u32 first_instance;
+};
+
 DAXA_DECL_BUFFER_PTR(Vertex)
 DAXA_DECL_BUFFER_PTR(UniformBufferObject)
 DAXA_DECL_BUFFER_PTR(PerInstanceData)
+DAXA_DECL_BUFFER_PTR(CullDrawInfo)
+DAXA_DECL_BUFFER_PTR(DrawCommand)
 
 struct PushConstant {
     daxa_BufferPtr(Vertex) vertex_ptr;
     daxa_BufferPtr(UniformBufferObject) ubo_ptr;
     daxa_BufferPtr(PerInstanceData) instance_buffer_ptr;
+    /// The instances that survived culling, indexed by gl_InstanceIndex
+    daxa_BufferPtr(daxa_u32) visible_instance_ptr;
+};
+
+struct CullPushConstant {
+    daxa_BufferPtr(UniformBufferObject) ubo_ptr;
+    daxa_BufferPtr(PerInstanceData) instance_buffer_ptr;
+    daxa_BufferPtr(CullDrawInfo) draw_info_ptr;
+    /// The draw each instance belongs to
+    daxa_BufferPtr(daxa_u32) instance_draw_ptr;
+    /// [0] is the number of commands written, [1 + draw * MAX_LOD_COUNT + lod] the number of visible instances of each draw drawn at each level
+    daxa_RWBufferPtr(daxa_u32) counter_ptr;
+    daxa_RWBufferPtr(daxa_u32) visible_instance_ptr;
+    daxa_RWBufferPtr(DrawCommand) command_ptr;
+    /// 1 for every instance that was visible at the end of the last frame's late phase
+    daxa_RWBufferPtr(daxa_u32) visibility_history_ptr;
+    /// Instances for CULL_PASS_INSTANCES, draws times MAX_LOD_COUNT for CULL_PASS_COMMANDS
+    daxa_u32 count;
+    daxa_u32 pass;
+    daxa_u32 phase;
+    /// The depth pyramid, only read by the late phase
+    daxa_ImageViewId depth_pyramid;
+    daxa_SamplerId depth_sampler;
+    daxa_u32vec2 depth_pyramid_size;
+};
+
+/// Reduces one level of the depth pyramid into the next, each texel keeps the farthest depth it covers
+struct DepthPyramidPushConstant {
+    daxa_ImageViewId src;
+    daxa_ImageViewId dst;
+    daxa_SamplerId depth_sampler;
+    daxa_u32vec2 src_size;
+    daxa_u32vec2 dst_size;
+    /// 1 when src is the depth buffer, which is sampled rather than loaded as a storage image
+    daxa_u32 from_depth;
 };
 
 #ifdef __cplusplus
@@ -1,12 +1,48 @@
 #pragma once
 
 #include "ECS_Entity.h"
+#include "ECS_CommandBuffer.h"
 #include "ECS_Component.h"
+#include "ECS_View.h"
 
 /// @brief The ecs namespace has a EntityManager in the global scope as a singleton
 /// @see ECS_DESIGN for ECS design suggestion/guidelines
 namespace ecs {
     inline EntityManager entityManager;
+    /// @brief The @ref CommandBuffer systems should record structural changes into, it is played back at the end of @ref updateSystems
+    inline CommandBuffer commandBuffer{ entityManager };
+
+    /// @brief Forwards to @ref EntityManager::createEntity; this exists to reduce boilderplate
+    inline Entity createEntity() {
+        return entityManager.createEntity();
+    }
+
+    /// @brief Forwards to @ref EntityManager::destroyEntity; this exists to reduce boilderplate
+    inline void destroyEntity(Entity entity) {
+        entityManager.destroyEntity(entity);
+    }
+
+    /// @brief Forwards to @ref EntityManager::spawnBatch; this exists to reduce boilderplate
+    /// @param count The number of entities to create
+    /// @param prototypes The components every new entity gets a copy of
+    /// @return The entityIDs of the new entities
+    template <typename... Ts>
+    inline std::vector<Entity> spawnBatch(std::size_t count, const Ts&... prototypes) {
+        return entityManager.spawnBatch(count, prototypes...);
+    }
+
+    /// @brief Forwards to @ref EntityManager::clone; this exists to reduce boilderplate
+    /// @param prefab The entity whose components are copied
+    /// @param count The number of copies to create
+    /// @return The entityIDs of the new entities
+    inline std::vector<Entity> clone(Entity prefab, std::size_t count) {
+        return entityManager.clone(prefab, count);
+    }
+
+    /// @brief Forwards to @ref EntityManager::isAlive; this exists to reduce boilderplate
+    inline bool isAlive(Entity entity) {
+        return entityManager.isAlive(entity);
+    }
 
     /// @brief Forwards getComponent to the appropriate @ref ComponentManager; this exists to reduce boilderplate
     /// @tparam T This is used to select the @ref ComponentManager
@@ -22,19 +58,33 @@ namespace ecs {
     /// @param entity EntityID of the entity to get the @ref ComponentManager for; this exists to reduce boilderplate
     /// @return A reference to the @ref ComponentManager
     template <typename T>
-    inline ComponentManager<T>& getComponentManager() {
+    inline ComponentManagerFor<T>& getComponentManager() {
         return entityManager.getComponentManager<T>();
     }
 
+    /// @brief Gets the @ref ArchetypeStorage; this exists to reduce boilderplate
+    /// @return A reference to the @ref ArchetypeStorage
+    inline ArchetypeStorage& getArchetypeStorage() {
+        return entityManager.getArchetypeStorage();
+    }
+
     /// @brief Forwards getSytem to the appropriate @ref SystemManager; this exists to reduce boilderplate
     /// @tparam T This is used to select the @ref SystemManager
     /// @param entity EntityID of the entity to get the system for
-    /// @return A pointer to the system
+    /// @return A reference to the system
     template <typename T>
-    inline T* getSystem() {
+    inline T& getSystem() {
         return entityManager.getSystemManager().getSystem<T>();
     }
 
+    /// @brief Creates a @ref View over every entity that has all of the given components
+    /// @tparam Ts The component types to query, iteration is driven by the smallest of their @ref ComponentManager "ComponentManagers"
+    /// @return A @ref View that can be iterated with a range-based for loop or @c each
+    template <typename... Ts>
+    inline View<Ts...> view() {
+        return entityManager.view<Ts...>();
+    }
+
     /// @brief Gets the appropriate @ref SystemManager
     /// @tparam T This is used to select the @ref SystemManager
     /// @param entity EntityID of the entity to get the @ref SystemManager for; this exists to reduce boilderplate
@@ -43,8 +93,9 @@ namespace ecs {
         return entityManager.getSystemManager();
     }
 
-    /// @brief Forwards to @ref EntityManager::SystemManager; this exists to reduce boilderplate
+    /// @brief Forwards to @ref EntityManager::SystemManager then plays back @ref commandBuffer; this exists to reduce boilderplate
     inline void updateSystems() {
         entityManager.getSystemManager().updateSystems();
+        commandBuffer.playback();
     }
 }
\ No newline at end of file
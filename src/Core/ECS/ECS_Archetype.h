@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ECS_Types.h"
+
+/// @brief The size in bytes of one chunk of an @ref Archetype, every component column of the chunk lives inside it
+constexpr std::size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+/// @brief Type-erased description of a component type so columns of it can be moved and destroyed inside raw chunk memory
+struct ComponentTypeInfo {
+    std::size_t size;
+    std::size_t alignment;
+    void (*moveConstruct)(void* destination, void* source);
+    void (*destroy)(void* component);
+};
+
+/// @brief Returns the @ref ComponentTypeInfo of @c T
+template <typename T>
+const ComponentTypeInfo& getComponentTypeInfo() {
+    static const ComponentTypeInfo info{
+        .size = sizeof(T),
+        .alignment = alignof(T),
+        .moveConstruct = [](void* destination, void* source) { new (destination) T(std::move(*static_cast<T*>(source))); },
+        .destroy = [](void* component) { static_cast<T*>(component)->~T(); },
+    };
+    return info;
+}
+
+/**
+ * @brief A fixed size block of memory that holds up to @ref Archetype::chunkCapacity entities of one archetype
+ *
+ * The chunk starts with a column of @c Entity followed by one contiguous column per component type, the column offsets are stored in the owning @ref Archetype
+ */
+struct ArchetypeChunk {
+    alignas(64) std::byte data[ARCHETYPE_CHUNK_SIZE];
+    std::uint32_t count = 0;
+};
+
+/**
+ * @brief All the entities that have exactly the same set of components
+ *
+ * Entities are packed into @ref ArchetypeChunk "ArchetypeChunks", only the last chunk may be partially filled
+ */
+struct Archetype {
+    ComponentSignature signature;
+    /// @brief The component types of the archetype in ascending @ref ComponentTypeID order
+    std::vector<ComponentTypeID> types;
+    std::vector<const ComponentTypeInfo*> typeInfos;
+    /// @brief Byte offset of each column inside a chunk, indexed the same as @c types
+    std::vector<std::size_t> columnOffsets;
+    /// @brief Maps a @ref ComponentTypeID to its index in @c types, or -1 if the archetype doesn't have that component
+    std::array<std::int32_t, MAX_COMPONENT_TYPES> columnOf;
+
+    std::uint32_t chunkCapacity = 0;
+    std::vector<std::unique_ptr<ArchetypeChunk>> chunks;
+
+    /// @brief Cached archetype indices reached by adding or removing one component type
+    std::array<std::uint32_t, MAX_COMPONENT_TYPES> addEdges;
+    std::array<std::uint32_t, MAX_COMPONENT_TYPES> removeEdges;
+
+    Entity* entities(ArchetypeChunk& chunk) const {
+        return reinterpret_cast<Entity*>(chunk.data);
+    }
+
+    void* component(ArchetypeChunk& chunk, std::size_t column, std::uint32_t row) const {
+        return chunk.data + columnOffsets[column] + row * typeInfos[column]->size;
+    }
+
+    template <typename T>
+    T* column(ArchetypeChunk& chunk) const {
+        return reinterpret_cast<T*>(chunk.data + columnOffsets[columnOf[getComponentTypeID<T>()]]);
+    }
+
+    std::size_t size() const {
+        return chunks.empty() ? 0 : (chunks.size() - 1) * chunkCapacity + chunks.back()->count;
+    }
+};
+
+/**
+ * @brief An alternative to the per-type @ref ComponentManager storage that groups entities by their component signature
+ *
+ * Each combination of component types gets an @ref Archetype whose components are stored column by column in 16 KiB chunks,
+ * so systems that touch several components of the same entities stream through memory linearly instead of joining separate arrays by entity
+ * Adding or removing a component moves the entity to another archetype, so this storage suits components that are mostly set up once and then iterated
+ * Components stored here are separate from the ones in the @ref ComponentManager "ComponentManagers", a component type should only be used with one of them
+ * @warning Like @ref ComponentManager the components can move whenever an entity changes archetype, don't hold on to pointers across structural changes
+ * @see ECS_DESIGN for ECS design suggestion/guidelines
+ */
+class ArchetypeStorage {
+public:
+    ArchetypeStorage() {
+        // Archetype 0 is the empty archetype that entities without any components live in conceptually, it never stores rows
+        archetypes.push_back(makeArchetype(ComponentSignature{}));
+        archetypeIndices[ComponentSignature{}] = 0;
+    }
+
+    ArchetypeStorage(const ArchetypeStorage&) = delete;
+    ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+    ~ArchetypeStorage() {
+        for (auto& archetype : archetypes) {
+            for (auto& chunk : archetype.chunks) {
+                for (std::uint32_t row = 0; row < chunk->count; row++)
+                    destroyRow(archetype, *chunk, row);
+            }
+        }
+    }
+
+    /// @brief Adds the component to the entity, moving it to the archetype with the new signature, if the entity already has one of that type it is replaced
+    /// @param entity The entity the component belongs to
+    /// @param component A rvalue reference to the component, you should either construct the component in place or use @c std::move
+    template <typename T>
+    void addComponent(Entity entity, T&& component) {
+        const ComponentTypeID typeID = registerType<T>();
+        if (!canAddTo(entity)) {
+            std::cerr << "Error: Trying to add a component to an entity that is not alive\n";
+            return;
+        }
+
+        if (T* existing = getComponent<T>(entity)) {
+            *existing = std::move(component);
+            initializeComponent(*existing, entity);
+            return;
+        }
+
+        const std::uint32_t sourceIndex = hasRecord(entity) ? records[entityIndex(entity)].archetype : 0;
+        const std::uint32_t targetIndex = addEdge(sourceIndex, typeID);
+        moveEntity(entity, targetIndex);
+
+        EntityRecord& record = records[entityIndex(entity)];
+        Archetype& target = archetypes[targetIndex];
+        auto* destination = static_cast<T*>(target.component(*target.chunks[record.chunk], target.columnOf[typeID], record.row));
+        new (destination) T(std::move(component));
+        initializeComponent(*destination, entity);
+    }
+
+    /// @brief Returns a pointer to the component of the given type that belongs to the entity
+    /// @return A pointer to the component or @c nullptr if the entity doesn't have one in archetype storage
+    template <typename T>
+    T* getComponent(Entity entity) {
+        const ComponentTypeID typeID = getComponentTypeID<T>();
+        // Types past MAX_COMPONENT_TYPES can never have been added, registerType refuses them
+        if (typeID >= MAX_COMPONENT_TYPES || !hasRecord(entity))
+            return nullptr;
+
+        const EntityRecord& record = records[entityIndex(entity)];
+        Archetype& archetype = archetypes[record.archetype];
+        const std::int32_t column = archetype.columnOf[typeID];
+        if (column < 0)
+            return nullptr;
+        return static_cast<T*>(archetype.component(*archetype.chunks[record.chunk], column, record.row));
+    }
+
+    /// @brief Removes the component of type @c T from the entity, moving it to the archetype without @c T, prints an error if the entity doesn't have one
+    template <typename T>
+    void removeComponent(Entity entity) {
+        if (!getComponent<T>(entity)) {
+            std::cerr << "Error: Trying to remove nonexistent component from entity\n";
+            return;
+        }
+
+        const ComponentTypeID typeID = getComponentTypeID<T>();
+        const std::uint32_t targetIndex = removeEdge(records[entityIndex(entity)].archetype, typeID);
+        moveEntity(entity, targetIndex);
+    }
+
+    /// @brief Removes all of the entity's components, called by the @ref EntityManager when the entity is destroyed
+    void destroyEntity(Entity entity) {
+        if (hasRecord(entity))
+            moveEntity(entity, 0);
+    }
+
+    /// @brief Calls @c function once per chunk of every archetype that has all of @c Ts
+    /// @param function Callable taking @c (std::uint32_t count, const Entity* entities, Ts*... columns) where each column holds @c count contiguous components
+    template <typename... Ts, typename Function>
+    void eachChunk(Function&& function) {
+        if (((getComponentTypeID<Ts>() >= MAX_COMPONENT_TYPES) || ...))
+            return;
+
+        ComponentSignature query;
+        (query.set(getComponentTypeID<Ts>()), ...);
+
+        for (Archetype& archetype : archetypes) {
+            if ((archetype.signature & query) != query)
+                continue;
+            for (auto& chunk : archetype.chunks)
+                function(chunk->count, archetype.entities(*chunk), archetype.column<Ts>(*chunk)...);
+        }
+    }
+
+    /// @brief Calls @c function for every entity that has all of @c Ts, walking each chunk's columns linearly
+    /// @param function Callable taking @c (Entity, Ts&...)
+    template <typename... Ts, typename Function>
+    void each(Function&& function) {
+        eachChunk<Ts...>([&](std::uint32_t count, const Entity* entities, Ts*... columns) {
+            for (std::uint32_t row = 0; row < count; row++)
+                function(entities[row], columns[row]...);
+        });
+    }
+
+    /// @brief The number of archetypes that have been created, including the empty one
+    std::size_t archetypeCount() const { return archetypes.size(); }
+
+    /// @brief Attached by the @ref EntityManager that owns this storage, adding a component to a handle that isn't alive is rejected with it
+    EntityLiveness liveness;
+
+private:
+    /// @brief Where an entity's row lives, @c entity is stored so stale handles to a recycled index are rejected
+    struct EntityRecord {
+        Entity entity = INVALID_ENTITY;
+        std::uint32_t archetype = 0;
+        std::uint32_t chunk = 0;
+        std::uint32_t row = 0;
+    };
+
+    static constexpr std::uint32_t NO_EDGE = UINT32_MAX;
+
+    std::vector<Archetype> archetypes;
+    std::unordered_map<ComponentSignature, std::uint32_t> archetypeIndices;
+    std::array<const ComponentTypeInfo*, MAX_COMPONENT_TYPES> typeInfos{};
+    /// @brief Indexed by @ref entityIndex, entities in archetype 0 have no row
+    std::vector<EntityRecord> records;
+
+    template <typename T>
+    ComponentTypeID registerType() {
+        const ComponentTypeID typeID = getComponentTypeID<T>();
+        if (typeID >= MAX_COMPONENT_TYPES)
+            throw std::runtime_error("Error: Too many component types, increase MAX_COMPONENT_TYPES");
+        typeInfos[typeID] = &getComponentTypeInfo<T>();
+        return typeID;
+    }
+
+    bool hasRecord(Entity entity) const {
+        const std::uint32_t index = entityIndex(entity);
+        return index < records.size() && records[index].entity == entity && records[index].archetype != 0;
+    }
+
+    /// @brief The handle must be alive and its index must not still hold a row of another generation, @ref moveEntity would overwrite that record
+    bool canAddTo(Entity entity) const {
+        if (!liveness.isAlive(entity))
+            return false;
+        const std::uint32_t index = entityIndex(entity);
+        return index >= records.size() || records[index].archetype == 0 || records[index].entity == entity;
+    }
+
+    Archetype makeArchetype(const ComponentSignature& signature) const {
+        Archetype archetype;
+        archetype.signature = signature;
+        archetype.columnOf.fill(-1);
+        archetype.addEdges.fill(NO_EDGE);
+        archetype.removeEdges.fill(NO_EDGE);
+
+        std::size_t rowSize = sizeof(Entity);
+        for (ComponentTypeID typeID = 0; typeID < MAX_COMPONENT_TYPES; typeID++) {
+            if (!signature.test(typeID))
+                continue;
+            archetype.columnOf[typeID] = static_cast<std::int32_t>(archetype.types.size());
+            archetype.types.push_back(typeID);
+            archetype.typeInfos.push_back(typeInfos[typeID]);
+            rowSize += typeInfos[typeID]->size;
+        }
+
+        // Start from the capacity ignoring padding and shrink until every aligned column fits in the chunk
+        std::uint32_t capacity = static_cast<std::uint32_t>(ARCHETYPE_CHUNK_SIZE / rowSize);
+        while (capacity > 0) {
+            std::size_t offset = capacity * sizeof(Entity);
+            archetype.columnOffsets.clear();
+            for (const ComponentTypeInfo* info : archetype.typeInfos) {
+                offset = (offset + info->alignment - 1) / info->alignment * info->alignment;
+                archetype.columnOffsets.push_back(offset);
+                offset += capacity * info->size;
+            }
+            if (offset <= ARCHETYPE_CHUNK_SIZE)
+                break;
+            capacity--;
+        }
+        if (capacity == 0)
+            throw std::runtime_error("Error: Archetype components are too large to fit in a chunk");
+
+        archetype.chunkCapacity = capacity;
+        return archetype;
+    }
+
+    std::uint32_t findOrCreateArchetype(const ComponentSignature& signature) {
+        auto found = archetypeIndices.find(signature);
+        if (found != archetypeIndices.end())
+            return found->second;
+
+        const auto index = static_cast<std::uint32_t>(archetypes.size());
+        archetypes.push_back(makeArchetype(signature));
+        archetypeIndices[signature] = index;
+        return index;
+    }
+
+    std::uint32_t addEdge(std::uint32_t archetypeIndex, ComponentTypeID typeID) {
+        if (archetypes[archetypeIndex].addEdges[typeID] == NO_EDGE) {
+            ComponentSignature signature = archetypes[archetypeIndex].signature;
+            signature.set(typeID);
+            const std::uint32_t target = findOrCreateArchetype(signature);
+            archetypes[archetypeIndex].addEdges[typeID] = target;
+        }
+        return archetypes[archetypeIndex].addEdges[typeID];
+    }
+
+    std::uint32_t removeEdge(std::uint32_t archetypeIndex, ComponentTypeID typeID) {
+        if (archetypes[archetypeIndex].removeEdges[typeID] == NO_EDGE) {
+            ComponentSignature signature = archetypes[archetypeIndex].signature;
+            signature.reset(typeID);
+            const std::uint32_t target = findOrCreateArchetype(signature);
+            archetypes[archetypeIndex].removeEdges[typeID] = target;
+        }
+        return archetypes[archetypeIndex].removeEdges[typeID];
+    }
+
+    void destroyRow(Archetype& archetype, ArchetypeChunk& chunk, std::uint32_t row) {
+        for (std::size_t column = 0; column < archetype.types.size(); column++)
+            archetype.typeInfos[column]->destroy(archetype.component(chunk, column, row));
+    }
+
+    /// @brief Appends an uninitialised row to the archetype and returns its chunk and row
+    std::pair<std::uint32_t, std::uint32_t> allocateRow(Archetype& archetype) {
+        if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.chunkCapacity)
+            archetype.chunks.push_back(std::make_unique<ArchetypeChunk>());
+
+        ArchetypeChunk& chunk = *archetype.chunks.back();
+        return { static_cast<std::uint32_t>(archetype.chunks.size() - 1), chunk.count++ };
+    }
+
+    /// @brief Moves the archetype's last row into the hole at @c chunkIndex / @c row, the components at the hole must already be destroyed or moved from
+    void fillHole(Archetype& archetype, std::uint32_t chunkIndex, std::uint32_t row) {
+        ArchetypeChunk& lastChunk = *archetype.chunks.back();
+        const std::uint32_t lastChunkIndex = static_cast<std::uint32_t>(archetype.chunks.size() - 1);
+        const std::uint32_t lastRow = lastChunk.count - 1;
+
+        if (chunkIndex != lastChunkIndex || row != lastRow) {
+            ArchetypeChunk& chunk = *archetype.chunks[chunkIndex];
+            for (std::size_t column = 0; column < archetype.types.size(); column++) {
+                void* source = archetype.component(lastChunk, column, lastRow);
+                archetype.typeInfos[column]->moveConstruct(archetype.component(chunk, column, row), source);
+                archetype.typeInfos[column]->destroy(source);
+            }
+
+            const Entity movedEntity = archetype.entities(lastChunk)[lastRow];
+            archetype.entities(chunk)[row] = movedEntity;
+            records[entityIndex(movedEntity)].chunk = chunkIndex;
+            records[entityIndex(movedEntity)].row = row;
+        }
+
+        if (--lastChunk.count == 0)
+            archetype.chunks.pop_back();
+    }
+
+    /// @brief Moves the entity's row to another archetype, components the target doesn't have are destroyed and ones the source doesn't have are left uninitialised
+    void moveEntity(Entity entity, std::uint32_t targetIndex) {
+        const std::uint32_t index = entityIndex(entity);
+        if (index >= records.size())
+            records.resize(index + 1);
+
+        EntityRecord& record = records[index];
+        const bool hadRow = hasRecord(entity);
+        const std::uint32_t sourceIndex = hadRow ? record.archetype : 0;
+
+        std::uint32_t targetChunk = 0, targetRow = 0;
+        if (targetIndex != 0) {
+            Archetype& target = archetypes[targetIndex];
+            std::tie(targetChunk, targetRow) = allocateRow(target);
+            target.entities(*target.chunks[targetChunk])[targetRow] = entity;
+        }
+
+        if (hadRow) {
+            Archetype& source = archetypes[sourceIndex];
+            ArchetypeChunk& sourceChunk = *source.chunks[record.chunk];
+
+            for (std::size_t column = 0; column < source.types.size(); column++) {
+                void* component = source.component(sourceChunk, column, record.row);
+                const std::int32_t targetColumn = archetypes[targetIndex].columnOf[source.types[column]];
+                if (targetColumn >= 0) {
+                    Archetype& target = archetypes[targetIndex];
+                    source.typeInfos[column]->moveConstruct(target.component(*target.chunks[targetChunk], targetColumn, targetRow), component);
+                }
+                source.typeInfos[column]->destroy(component);
+            }
+
+            fillHole(source, record.chunk, record.row);
+        }
+
+        record = EntityRecord{
+            .entity = entity,
+            .archetype = targetIndex,
+            .chunk = targetChunk,
+            .row = targetRow,
+        };
+    }
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ECS_Entity.h"
+
+namespace ecs {
+    /**
+     * @brief Records structural changes (creating and destroying entities, adding and removing components) so they can be applied later at a sync point
+     *
+     * Adding or removing components while a @ref ComponentManager or @ref View is being iterated can reallocate the storage underneath it,
+     * systems should record those changes here instead and let @ref playback apply them once no system is running
+     * Recording is thread safe so systems running in parallel can share one buffer, the global one is @ref ecs::commandBuffer and is played back at the end of @ref ecs::updateSystems
+     *
+     * Playback groups the commands by component type, each type's additions are sorted by entity and inserted in one batch after a single reserve
+     * Additions are applied first, then removals and finally entity destruction, so a component that is both added and removed in the same frame ends up removed
+     * @note If the same entity gets several components of the same type only the last one recorded is kept
+     * @see ECS_DESIGN for ECS design suggestion/guidelines
+     */
+    class CommandBuffer {
+    public:
+        explicit CommandBuffer(EntityManager& entityManager) : entityManager(entityManager) {}
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        /// @brief Reserves a new entity straight away so components can be recorded for it, it has no components until @ref playback
+        /// @return The entityID of the new entity
+        Entity createEntity() {
+            return entityManager.reserveEntity();
+        }
+
+        /// @brief Records the destruction of an entity, the entity and its components stay valid until @ref playback
+        void destroyEntity(Entity entity) {
+            std::lock_guard lock(mutex);
+            destroyedEntities.push_back(entity);
+        }
+
+        /// @brief Records adding a component to the entity, like @ref ComponentManager::addComponent it replaces the component if the entity already has one
+        /// @param component A rvalue reference to the component, you should either construct the component in place or use @c std::move
+        template <typename T>
+        void addComponent(Entity entity, T&& component) {
+            std::lock_guard lock(mutex);
+            batch<std::remove_cvref_t<T>>().additions.emplace_back(entity, std::forward<T>(component));
+        }
+
+        /// @brief Records removing a component from the entity, it is not an error if the entity no longer has the component when the buffer is played back
+        template <typename T>
+        void removeComponent(Entity entity) {
+            std::lock_guard lock(mutex);
+            batch<T>().removals.push_back(entity);
+        }
+
+        /// @brief Applies every recorded command and clears the buffer
+        /// @warning Must only be called while no systems are running, i.e. between calls to @ref SystemManager::updateSystems
+        void playback() {
+            std::lock_guard lock(mutex);
+            entityManager.flushReservedEntities();
+
+            for (auto& componentBatch : batches) {
+                if (componentBatch)
+                    componentBatch->playAdditions(entityManager);
+            }
+            for (auto& componentBatch : batches) {
+                if (componentBatch)
+                    componentBatch->playRemovals(entityManager);
+            }
+
+            std::sort(destroyedEntities.begin(), destroyedEntities.end());
+            destroyedEntities.erase(std::unique(destroyedEntities.begin(), destroyedEntities.end()), destroyedEntities.end());
+            for (Entity entity : destroyedEntities) {
+                if (entityManager.isAlive(entity))
+                    entityManager.destroyEntity(entity);
+            }
+            destroyedEntities.clear();
+        }
+
+    private:
+        struct IComponentBatch {
+            virtual ~IComponentBatch() = default;
+            virtual void playAdditions(EntityManager& entityManager) = 0;
+            virtual void playRemovals(EntityManager& entityManager) = 0;
+        };
+
+        template <typename T>
+        struct ComponentBatch : IComponentBatch {
+            std::vector<std::pair<Entity, T>> additions;
+            std::vector<Entity> removals;
+
+            void playAdditions(EntityManager& entityManager) override {
+                if (additions.empty())
+                    return;
+
+                // Stable so that for repeated entities the last recorded component is the one kept
+                std::stable_sort(additions.begin(), additions.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                auto& componentManager = entityManager.getComponentManager<T>();
+                componentManager.reserve(componentManager.size() + additions.size());
+                for (std::size_t i = 0; i < additions.size(); i++) {
+                    if (i + 1 < additions.size() && additions[i + 1].first == additions[i].first)
+                        continue;
+                    if (entityManager.isAlive(additions[i].first))
+                        componentManager.addComponent(additions[i].first, std::move(additions[i].second));
+                }
+                additions.clear();
+            }
+
+            void playRemovals(EntityManager& entityManager) override {
+                if (removals.empty())
+                    return;
+
+                std::sort(removals.begin(), removals.end());
+                removals.erase(std::unique(removals.begin(), removals.end()), removals.end());
+
+                auto& componentManager = entityManager.getComponentManager<T>();
+                for (Entity entity : removals)
+                    componentManager.entityDestroyed(entity);
+                removals.clear();
+            }
+        };
+
+        EntityManager& entityManager;
+
+        std::mutex mutex;
+        /// @brief One batch per component type, indexed by @ref ComponentTypeID
+        std::vector<std::unique_ptr<IComponentBatch>> batches;
+        std::vector<Entity> destroyedEntities;
+
+        template <typename T>
+        ComponentBatch<T>& batch() {
+            const ComponentTypeID typeID = getComponentTypeID<T>();
+            if (typeID >= batches.size())
+                batches.resize(typeID + 1);
+            if (!batches[typeID])
+                batches[typeID] = std::make_unique<ComponentBatch<T>>();
+            return *static_cast<ComponentBatch<T>*>(batches[typeID].get());
+        }
+    };
+}
@@ -1,90 +1,451 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
 #include <iostream>
-#include <unordered_map>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 #include "ECS_Types.h"
 
+/// @brief Number of entity indices covered by one page of the sparse array in @ref ComponentManager, must be a power of two
+constexpr std::uint32_t SPARSE_PAGE_SIZE = 4096;
+/// @brief Marks a slot in the sparse array of @ref ComponentManager that does not point to a component
+constexpr std::uint32_t INVALID_COMPONENT_INDEX = UINT32_MAX;
+
+/**
+ * @brief The paged sparse array of a sparse set, maps an entity's index to the index of its component in a dense array
+ *
+ * Pages are only allocated once an entity in their range is added, stale entities are rejected by comparing against the dense array of entities
+ */
+class SparseEntityIndex {
+public:
+    /// @brief Finds the dense index of the entity without allocating any pages
+    /// @param denseEntities The entity stored at each dense index, used to reject stale handles
+    /// @return The dense index or @c INVALID_COMPONENT_INDEX
+    std::uint32_t find(Entity entity, const std::vector<Entity>& denseEntities) const {
+        const std::uint32_t index = entityIndex(entity);
+        const std::size_t page = index / SPARSE_PAGE_SIZE;
+        if (page >= pages.size() || !pages[page])
+            return INVALID_COMPONENT_INDEX;
+
+        const std::uint32_t denseIndex = (*pages[page])[index & (SPARSE_PAGE_SIZE - 1)];
+        if (denseIndex == INVALID_COMPONENT_INDEX || denseEntities[denseIndex] != entity)
+            return INVALID_COMPONENT_INDEX;
+        return denseIndex;
+    }
+
+    /// @brief Returns the entity holding the slot of this entity's index, which may be another generation of it
+    /// @return The holding entity or @c INVALID_ENTITY if the slot is empty
+    Entity occupant(Entity entity, const std::vector<Entity>& denseEntities) const {
+        const std::uint32_t index = entityIndex(entity);
+        const std::size_t page = index / SPARSE_PAGE_SIZE;
+        if (page >= pages.size() || !pages[page])
+            return INVALID_ENTITY;
+
+        const std::uint32_t denseIndex = (*pages[page])[index & (SPARSE_PAGE_SIZE - 1)];
+        return denseIndex == INVALID_COMPONENT_INDEX ? INVALID_ENTITY : denseEntities[denseIndex];
+    }
+
+    /// @brief Returns the sparse slot of the entity's index, allocating its page if needed
+    std::uint32_t& slot(Entity entity) {
+        const std::uint32_t index = entityIndex(entity);
+        const std::size_t page = index / SPARSE_PAGE_SIZE;
+        if (page >= pages.size())
+            pages.resize(page + 1);
+        if (!pages[page]) {
+            pages[page] = std::make_unique<SparsePage>();
+            pages[page]->fill(INVALID_COMPONENT_INDEX);
+        }
+        return (*pages[page])[index & (SPARSE_PAGE_SIZE - 1)];
+    }
+
+private:
+    using SparsePage = std::array<std::uint32_t, SPARSE_PAGE_SIZE>;
+
+    std::vector<std::unique_ptr<SparsePage>> pages;
+};
+
 /**
  * @brief Holds a @c std::vector of all the components of its type
- * 
+ *
  * Every component has a component manager of that type, it is what you use to access and modify the compoents themselves
+ * Components are stored in a sparse set, the dense @c std::vector of components is indexed through a @ref SparseEntityIndex that maps an entity's index to its component index so lookups never hash
+ * Stale entities (an older generation of a recycled slot) are rejected by comparing against the entity stored alongside the component
+ * Components are plain types (see @ref Component), the entity that owns each one is only kept in a parallel array and can be found with @ref getEntity
+ * Trivially copyable components are swap-removed and serialized with raw memory copies, @c std::vector already relocates them with @c memmove when it grows
+ * Each component also has a @ref ChangeTick that is bumped whenever it is added or passed to @c markChanged, so consumers can skip components that haven't changed since they last looked with @c changedSince
+ * Lookups never bump it, even non-const ones, whoever writes to a component marks it (@ref TransformComponent setters do this themselves, non-const @ref View types do it for you)
  * @warning The @c this pointer should never be used inside of a component or system as they are stored directly in @c std::vector and may reallocate at anytime invalidating them
- * Caution should also be taken if you do anything within a component that may add another component like in @ref ManagedMesh::instanciate (ideally this should be done through a system)
+ * Caution should also be taken if you do anything within a component that may add another component like in @ref ManagedMesh::instanciate, record the change in an @ref ecs::CommandBuffer instead
  * @note Each entity may only have one of each type of component, trying to add a component when an entity already has a component of that type will result in the previous component being replaced by the new one
- * 
+ *
  * @tparam T The actual component that the manager will be managing
  * @see ECS_DESIGN for ECS design suggestion/guidelines
  */
-template <typename T>
+template <Component T>
 class ComponentManager: public IComponentManager {
 public:
     /// @brief Adds component if the enttiy doesn't already have one of that type, if the entity does the previous component will be replaced
     /// @param entity The entity the component belongs to
     /// @param component A rvalue reference to the component, you should either construct the component in place or use @c std::move
     void addComponent(Entity entity, T&& component) {
-        if (entityToComponentIndex.contains(entity)) {
-            components[entityToComponentIndex[entity]] = std::move(component);
-            components[entityToComponentIndex[entity]].initialize(entity);
+        if (!canAddTo(entity)) {
+            std::cerr << "Error: Trying to add a component to an entity that is not alive\n";
+            return;
+        }
+        std::uint32_t& slot = sparseSlot(entity);
+
+        if (slot != INVALID_COMPONENT_INDEX) {
+            componentIndexToEntity[slot] = entity;
+            components[slot] = std::move(component);
+            stampChanged(slot);
+            initializeComponent(components[slot], entity);
         } else {
-            entityToComponentIndex[entity] = components.size();
+            slot = static_cast<std::uint32_t>(components.size());
             componentIndexToEntity.push_back(entity);
             components.push_back(std::move(component));
-            // Add pointer to reverse lookup map
-            components.back().initialize(entity);
+            changeTicks.push_back(0);
+            stampChanged(slot);
+            initializeComponent(components.back(), entity);
+        }
+    }
+
+    /**
+     * @brief Gives every entity in @c entities a copy of @c prototype, reserving storage once for the whole batch
+     *
+     * If @c T has a static @c initializeBatch(std::span<T> components, std::span<const Entity> entities) it is called once for all the newly added components
+     * so they can send a single notification between them, otherwise the optional @c initialize is called on each of them as @ref addComponent would
+     * @note Entities that already have a component of this type have it replaced and initialized individually, after the new ones are added
+     * @note An entity listed more than once only gets the component from its first entry, the rest are skipped (and reported) so it is never initialized twice
+     * @note Entities that aren't alive are skipped and reported like @ref addComponent does
+     */
+    void addComponents(std::span<const Entity> entities, const T& prototype) {
+        reserve(components.size() + entities.size());
+
+        const std::size_t firstAdded = components.size();
+        std::vector<Entity> replaced;
+        std::size_t duplicateCount = 0;
+        std::size_t deadCount = 0;
+        for (Entity entity : entities) {
+            if (!canAddTo(entity)) {
+                deadCount++;
+                continue;
+            }
+            std::uint32_t& slot = sparseSlot(entity);
+            if (slot != INVALID_COMPONENT_INDEX) {
+                // A slot past firstAdded was added by an earlier entry of this batch
+                if (slot >= firstAdded)
+                    duplicateCount++;
+                else
+                    replaced.push_back(entity);
+                continue;
+            }
+
+            slot = static_cast<std::uint32_t>(components.size());
+            componentIndexToEntity.push_back(entity);
+            components.push_back(prototype);
+            changeTicks.push_back(currentChangeTick());
+        }
+        lastChangeTick = currentChangeTick();
+
+        // Sorted so an entity listed more than once is only replaced once
+        std::sort(replaced.begin(), replaced.end());
+        const auto uniqueEnd = std::unique(replaced.begin(), replaced.end());
+        duplicateCount += static_cast<std::size_t>(replaced.end() - uniqueEnd);
+        replaced.erase(uniqueEnd, replaced.end());
+        if (duplicateCount > 0)
+            std::cerr << "Error: Skipped " << duplicateCount << " duplicate entities in a batch of added components\n";
+        if (deadCount > 0)
+            std::cerr << "Error: Skipped " << deadCount << " entities that are not alive in a batch of added components\n";
+
+        const std::span<T> addedComponents(components.data() + firstAdded, components.size() - firstAdded);
+        const std::span<const Entity> addedEntities(componentIndexToEntity.data() + firstAdded, componentIndexToEntity.size() - firstAdded);
+        if constexpr (requires { T::initializeBatch(addedComponents, addedEntities); }) {
+            if (!addedComponents.empty())
+                T::initializeBatch(addedComponents, addedEntities);
+        } else {
+            for (std::size_t i = 0; i < addedComponents.size(); i++)
+                initializeComponent(addedComponents[i], addedEntities[i]);
+        }
+
+        for (Entity entity : replaced)
+            addComponent(entity, T(prototype));
+    }
+
+    /// @brief Copies @c source's component to every entity in @c targets with @ref addComponents
+    void cloneComponent(Entity source, std::span<const Entity> targets) override {
+        if constexpr (std::is_copy_constructible_v<T>) {
+            const T* component = getComponent(source);
+            if (!component)
+                return;
+
+            // Copied first as adding the batch may reallocate the storage the source lives in
+            const T prototype = *component;
+            addComponents(targets, prototype);
+        } else {
+            if (contains(source))
+                std::cerr << "Error: Trying to clone a component that is not copy constructible\n";
         }
     }
 
     /// @brief Returns a pointer to the component of the given type that belongs to the entity
     /// @param entity Entities are just a @c uint32_t that represents that entity's id
-    /// @return Returns a pointer to the component, a @c nullptr will be returned if the entity does not have a component of that type
+    /// @return Returns a pointer to the component, a @c nullptr will be returned if the entity does not have a component of that type or the handle is stale
+    /// @note The component is not marked as changed, call @ref markChanged after writing to it
     T* getComponent(Entity entity) {
-        if (entityToComponentIndex.contains(entity)) {
-            uint32_t component_index = entityToComponentIndex[entity];
-            return &components[component_index];
-        } else return nullptr;
+        const std::uint32_t componentIndex = findIndex(entity);
+        if (componentIndex != INVALID_COMPONENT_INDEX)
+            return &components[componentIndex];
+        else return nullptr;
+    }
+
+    /// @brief Read only version of @c getComponent
+    const T* getComponent(Entity entity) const {
+        const std::uint32_t componentIndex = findIndex(entity);
+        if (componentIndex != INVALID_COMPONENT_INDEX)
+            return &components[componentIndex];
+        else return nullptr;
+    }
+
+    /// @brief Returns the component at @c index in the dense array (the same index as @ref get_raw_component_list)
+    /// @note The component is not marked as changed, call @ref markChangedAt after writing to it
+    T& getComponentAt(std::size_t index) {
+        return components[index];
+    }
+
+    /// @brief Read only version of @c getComponentAt
+    const T& getComponentAt(std::size_t index) const {
+        return components[index];
+    }
+
+    /// @brief Returns the dense index of the entity's component (the index into @ref get_raw_component_list), or @c INVALID_COMPONENT_INDEX
+    std::uint32_t indexOf(Entity entity) const {
+        return findIndex(entity);
+    }
+
+    /// @brief Marks the entity's component as changed, use this after writing to a component through @ref get_raw_component_list
+    void markChanged(Entity entity) {
+        const std::uint32_t componentIndex = findIndex(entity);
+        if (componentIndex != INVALID_COMPONENT_INDEX)
+            stampChanged(componentIndex);
+    }
+
+    /// @brief Marks the component at @c index in the dense array as changed
+    void markChangedAt(std::size_t index) {
+        stampChanged(index);
+    }
+
+    /// @brief Marks a component stored in this manager as changed, this is how a component marks itself without knowing its entity
+    /// @note Does nothing if @c component isn't stored in this manager (e.g. it hasn't been added yet)
+    void markChanged(const T& component) {
+        if (owns(component))
+            stampChanged(static_cast<std::size_t>(&component - components.data()));
+    }
+
+    /// @brief Returns the entity that owns a component stored in this manager, found from the component's address so it costs no lookup
+    /// @return The entity or @c INVALID_ENTITY if @c component isn't stored in this manager
+    Entity getEntity(const T& component) const {
+        if (!owns(component))
+            return INVALID_ENTITY;
+        return componentIndexToEntity[static_cast<std::size_t>(&component - components.data())];
+    }
+
+    /// @brief Checks if the entity's component was added or changed after @c tick, false if the entity doesn't have one
+    bool changedSince(Entity entity, ChangeTick tick) const {
+        const std::uint32_t componentIndex = findIndex(entity);
+        return componentIndex != INVALID_COMPONENT_INDEX && changeTicks[componentIndex] > tick;
+    }
+
+    /// @brief Checks if any component of this type was added or changed after @c tick, this is a single comparison so untouched managers can be skipped entirely
+    bool changedSince(ChangeTick tick) const {
+        return lastChangeTick > tick;
+    }
+
+    /// @brief Checks if the entity has a component of this type
+    bool contains(Entity entity) const {
+        return findIndex(entity) != INVALID_COMPONENT_INDEX;
     }
 
     /**
      * @brief Removes component of the given type from the entity, it will throw a @c std::cerr if the entity does not have a component of the given type
-     * 
+     *
      * The way it removes a component is it swaps it to the last in the @c std::vector that stores all of the components, then it deletes the last element
      */
     void removeComponent(Entity entity) override {
-        if (!entityToComponentIndex.contains(entity)) {
+        const std::uint32_t removeIndex = findIndex(entity);
+        if (removeIndex == INVALID_COMPONENT_INDEX) {
             std::cerr << "Error: Trying to remove nonexistent component from entity\n";
             return;
         }
 
-        auto remove_component = entityToComponentIndex.find(entity);
-
-        uint32_t removeIndex = remove_component->second;
-        uint32_t lastIndex = static_cast<uint32_t>(components.size()) - 1;
-        Entity lastEntity = componentIndexToEntity[lastIndex];
-
-        // Get component pointers before swap so we can remap componentPtrToEntity
-        T* removePtr = &components[removeIndex];
-        T* lastPtr = &components[lastIndex];
+        const std::uint32_t lastIndex = static_cast<std::uint32_t>(components.size()) - 1;
+        const Entity lastEntity = componentIndexToEntity[lastIndex];
 
         // Swap the last element and removed element to preserve dense packing
-        components[removeIndex] = std::move(components[lastIndex]);
-        componentIndexToEntity[removeIndex] = lastEntity;
-        entityToComponentIndex[lastEntity] = removeIndex;
+        if (removeIndex != lastIndex) {
+            if constexpr (std::is_trivially_copyable_v<T>)
+                std::memcpy(static_cast<void*>(&components[removeIndex]), &components[lastIndex], sizeof(T));
+            else
+                components[removeIndex] = std::move(components[lastIndex]);
+            componentIndexToEntity[removeIndex] = lastEntity;
+            changeTicks[removeIndex] = changeTicks[lastIndex];
+            sparseSlot(lastEntity) = removeIndex;
+        }
 
         // Remove the last element now it's swapped with removed element
         components.pop_back();
         componentIndexToEntity.pop_back();
-        entityToComponentIndex.erase(remove_component);
+        changeTicks.pop_back();
+        sparseSlot(entity) = INVALID_COMPONENT_INDEX;
+    }
+
+    /// @brief Removes the entity's component if it has one, called by the @ref EntityManager when the entity is destroyed
+    void entityDestroyed(Entity entity) override {
+        if (contains(entity))
+            removeComponent(entity);
     }
 
-    /// @brief Returns a pointer of the @c std::vector that holds the components 
+    /// @brief Returns a pointer of the @c std::vector that holds the components
+    /// @note Writing through this doesn't mark components as changed, call @ref markChanged for the ones written to
     std::vector<T>& get_raw_component_list() {
         return components;
     }
 
+    /// @brief Read only version of @c get_raw_component_list
+    const std::vector<T>& get_raw_component_list() const {
+        return components;
+    }
+
+    /// @brief Returns the @ref ChangeTick each component was last changed on, indexed the same as @ref get_raw_component_list
+    const std::vector<ChangeTick>& get_raw_change_tick_list() const {
+        return changeTicks;
+    }
+
+    /// @brief Returns the entities that own each component, indexed the same as @ref get_raw_component_list
+    const std::vector<Entity>& get_raw_entity_list() const {
+        return componentIndexToEntity;
+    }
+
+    /// @brief The number of components currently stored
+    std::size_t size() const {
+        return components.size();
+    }
+
+    /**
+     * @brief Appends every component and the entity that owns it to @c bytes as raw memory, only available for trivially copyable components
+     * @note Components that point to anything (handles, pointers) need those fixed up after @ref deserialize
+     */
+    void serialize(std::vector<std::byte>& bytes) const requires std::is_trivially_copyable_v<T> {
+        const std::uint64_t count = components.size();
+        const std::size_t start = bytes.size();
+        bytes.resize(start + sizeof(count) + count * (sizeof(Entity) + sizeof(T)));
+
+        std::byte* out = bytes.data() + start;
+        std::memcpy(out, &count, sizeof(count));
+        out += sizeof(count);
+        std::memcpy(out, componentIndexToEntity.data(), count * sizeof(Entity));
+        out += count * sizeof(Entity);
+        std::memcpy(out, components.data(), count * sizeof(T));
+    }
+
+    /**
+     * @brief Adds the components written by @ref serialize, replacing any the entities already have
+     * @param bytes The serialized data, starting at the data written by @ref serialize
+     * @return The number of bytes read
+     * @throws std::runtime_error if @c bytes is too short
+     */
+    std::size_t deserialize(std::span<const std::byte> bytes) requires std::is_trivially_copyable_v<T> {
+        std::uint64_t count = 0;
+        if (bytes.size() < sizeof(count))
+            throw std::runtime_error("Error: Serialized component data is truncated");
+        std::memcpy(&count, bytes.data(), sizeof(count));
+
+        const std::size_t totalSize = sizeof(count) + count * (sizeof(Entity) + sizeof(T));
+        if (bytes.size() < totalSize)
+            throw std::runtime_error("Error: Serialized component data is truncated");
+
+        const std::byte* entityBytes = bytes.data() + sizeof(count);
+        const std::byte* componentBytes = entityBytes + count * sizeof(Entity);
+
+        reserve(components.size() + count);
+        for (std::size_t i = 0; i < count; i++) {
+            Entity entity;
+            std::memcpy(&entity, entityBytes + i * sizeof(Entity), sizeof(Entity));
+
+            // Copying the bytes into suitably aligned storage creates the component, trivially copyable types don't need constructing
+            alignas(T) std::byte storage[sizeof(T)];
+            std::memcpy(storage, componentBytes + i * sizeof(T), sizeof(T));
+            const T& component = *std::launder(reinterpret_cast<const T*>(storage));
+
+            std::uint32_t& slot = sparseSlot(entity);
+            if (slot == INVALID_COMPONENT_INDEX) {
+                slot = static_cast<std::uint32_t>(components.size());
+                componentIndexToEntity.push_back(entity);
+                components.push_back(component);
+                changeTicks.push_back(0);
+            } else {
+                componentIndexToEntity[slot] = entity;
+                components[slot] = component;
+            }
+            stampChanged(slot);
+        }
+        return totalSize;
+    }
+
+    /// @brief Reserves room for @c count components in total so a batch of @c addComponent calls only reallocates once
+    void reserve(std::size_t count) {
+        components.reserve(count);
+        componentIndexToEntity.reserve(count);
+        changeTicks.reserve(count);
+    }
+
 private:
     std::vector<T> components;
-    std::unordered_map<Entity, uint32_t> entityToComponentIndex;
     std::vector<Entity> componentIndexToEntity;
+    std::vector<ChangeTick> changeTicks;
+    /// @brief The newest tick any component was stamped with
+    ChangeTick lastChangeTick = 0;
+    /// @brief Maps an entity index to its index in @c components
+    SparseEntityIndex sparseIndex;
+
+    bool owns(const T& component) const {
+        // std::less gives a total order even for pointers into different arrays
+        const std::less<const T*> less;
+        return !less(&component, components.data()) && less(&component, components.data() + components.size());
+    }
+
+    void stampChanged(std::size_t index) {
+        const ChangeTick tick = currentChangeTick();
+        changeTicks[index] = tick;
+        lastChangeTick = tick;
+    }
+
+    /// @brief Finds the dense index of the entity's component without allocating any pages
+    std::uint32_t findIndex(Entity entity) const {
+        return sparseIndex.find(entity, componentIndexToEntity);
+    }
+
+    /// @brief Returns the sparse slot of the entity's index, allocating its page if needed
+    std::uint32_t& sparseSlot(Entity entity) {
+        return sparseIndex.slot(entity);
+    }
+
+    /**
+     * @brief Checks the handle is alive and that its slot isn't held by another generation of the same index
+     *
+     * A stale handle would otherwise find the live entity's slot by index and take its component over
+     */
+    bool canAddTo(Entity entity) const {
+        if (!liveness.isAlive(entity))
+            return false;
+        const Entity occupant = sparseIndex.occupant(entity, componentIndexToEntity);
+        return occupant == INVALID_ENTITY || occupant == entity;
+    }
 };
@@ -1,37 +1,167 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
-#include <typeindex>
-#include <unordered_map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
+#include "ECS_Archetype.h"
 #include "ECS_Component.h"
+#include "ECS_SoA.h"
 #include "ECS_System.h"
-
-static Entity next_entity_id = 1;
+#include "ECS_View.h"
 
 /**
  * @brief A singleton class that manages the whole ECS accessed through the @c ecs namespace
  * All of the @ref ComponentManager and @ref SystemManager for each type of component and system should be registered with this
- * The @ref ComponentManagers are stored in a @c std::unordered_map based on their types
+ * The @ref ComponentManagers are stored in a flat array indexed by their @ref ComponentTypeID
+ * Entity slots are recycled through a free list, each slot has a generation that is bumped when it is destroyed so old handles stop being alive
  * @see ECS_DESIGN for ECS design suggestion/guidelines
  */
 class EntityManager {
 public:
-    /// @brief Allocates an ID for a new entity
+    EntityManager() {
+        archetypeStorage.liveness.attach(generations);
+    }
+
+    /// @brief Allocates an ID for a new entity, reusing a destroyed slot if there is one
     /// @return The entityID for the new entity
-    static Entity createEntity() {
-        next_entity_id++;
-        return next_entity_id - 1;
+    Entity createEntity() {
+        flushReservedEntities();
+
+        std::uint32_t index;
+        if (!freeIndices.empty()) {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            index = static_cast<std::uint32_t>(generations.size());
+            if (index > ENTITY_INDEX_MASK)
+                throw std::runtime_error("Error: EntityManager ran out of entity indices");
+            generations.push_back(0);
+        }
+        freeCursor.store(static_cast<std::int64_t>(freeIndices.size()), std::memory_order_relaxed);
+        return makeEntity(index, generations[index]);
+    }
+
+    /// @brief Allocates @c count entities at once, reusing destroyed slots first
+    /// @return The entityIDs of the new entities
+    std::vector<Entity> createEntities(std::size_t count) {
+        std::vector<Entity> entities;
+        entities.reserve(count);
+        generations.reserve(generations.size() + (count > freeIndices.size() ? count - freeIndices.size() : 0));
+        for (std::size_t i = 0; i < count; i++)
+            entities.push_back(createEntity());
+        return entities;
+    }
+
+    /**
+     * @brief Creates @c count entities that each get a copy of every component in @c prototypes
+     *
+     * Each component type is added with @ref ComponentManager::addComponents so storage is reserved once per type and components can batch their initialization
+     * @return The entityIDs of the new entities
+     */
+    template <typename... Ts>
+    std::vector<Entity> spawnBatch(std::size_t count, const Ts&... prototypes) {
+        std::vector<Entity> entities = createEntities(count);
+        (getComponentManager<Ts>().addComponents(entities, prototypes), ...);
+        return entities;
+    }
+
+    /**
+     * @brief Creates @c count entities that each get a copy of every component @c prefab has in the @ref ComponentManager "ComponentManagers"
+     * @note Components in the @ref ArchetypeStorage are not cloned
+     * @return The entityIDs of the new entities
+     */
+    std::vector<Entity> clone(Entity prefab, std::size_t count) {
+        if (!isAlive(prefab)) {
+            std::cerr << "Error: Trying to clone an entity that is not alive\n";
+            return {};
+        }
+
+        std::vector<Entity> entities = createEntities(count);
+        for (std::size_t i = 0; i < componentManagers.size(); i++) {
+            if (componentManagers[i])
+                componentManagers[i]->cloneComponent(prefab, entities);
+        }
+        return entities;
+    }
+
+    /**
+     * @brief Hands out an entity handle without modifying the entity bookkeeping, so it is safe to call from several threads while systems are running
+     *
+     * Reserved entities reuse destroyed slots first and then take fresh indices past the end, they only become fully alive once @ref flushReservedEntities is called
+     * (@ref ecs::CommandBuffer::playback does this) and until then they have no components
+     * @warning Must not be called at the same time as @c createEntity, @c destroyEntity or @c flushReservedEntities
+     */
+    Entity reserveEntity() {
+        const std::int64_t cursor = freeCursor.fetch_sub(1, std::memory_order_relaxed);
+        if (cursor > 0) {
+            const std::uint32_t index = freeIndices[cursor - 1];
+            return makeEntity(index, generations[index]);
+        }
+
+        // The free list has run out, everything past it is a brand new index
+        const std::uint64_t index = generations.size() + static_cast<std::uint64_t>(-cursor);
+        if (index > ENTITY_INDEX_MASK)
+            throw std::runtime_error("Error: EntityManager ran out of entity indices");
+        return makeEntity(static_cast<std::uint32_t>(index), 0);
+    }
+
+    /// @brief Makes the entities handed out by @ref reserveEntity alive, this must be called from a single thread while no systems are running
+    void flushReservedEntities() {
+        const std::int64_t cursor = freeCursor.load(std::memory_order_relaxed);
+        if (cursor == static_cast<std::int64_t>(freeIndices.size()))
+            return;
+
+        if (cursor >= 0) {
+            // Reserved slots were taken from the back of the free list
+            freeIndices.resize(static_cast<std::size_t>(cursor));
+        } else {
+            freeIndices.clear();
+            generations.resize(generations.size() + static_cast<std::size_t>(-cursor), 0);
+        }
+        freeCursor.store(static_cast<std::int64_t>(freeIndices.size()), std::memory_order_relaxed);
+    }
+
+    /// @brief Removes all of the entity's components and frees its slot to be reused by @c createEntity
+    /// @param entity The entity to destroy, destroying an entity that is not alive does nothing apart from printing an error
+    void destroyEntity(Entity entity) {
+        flushReservedEntities();
+        if (!isAlive(entity)) {
+            std::cerr << "Error: Trying to destroy an entity that is not alive\n";
+            return;
+        }
+
+        for (auto& componentManager : componentManagers) {
+            if (componentManager)
+                componentManager->entityDestroyed(entity);
+        }
+        archetypeStorage.destroyEntity(entity);
+
+        const std::uint32_t index = entityIndex(entity);
+        generations[index] = (generations[index] + 1) & ENTITY_GENERATION_MASK;
+        freeIndices.push_back(index);
+        freeCursor.store(static_cast<std::int64_t>(freeIndices.size()), std::memory_order_relaxed);
+    }
+
+    /// @brief Checks if the entity handle still refers to a living entity, this is false for handles to destroyed (and possibly recycled) slots
+    bool isAlive(Entity entity) const {
+        const std::uint32_t index = entityIndex(entity);
+        return entity != INVALID_ENTITY && index < generations.size() && generations[index] == entityGeneration(entity);
     }
 
     /// @brief Registers a @ref ComponentManager if one of that type is not already registered
-    /// @tparam T The type of the @ref ComponentManager
+    /// @tparam T The type of the @ref ComponentManager, types with @ref ComponentFields get a @ref SoAComponentManager instead
     template <typename T>
     void registerComponentManager() {
-        const auto typeIndex = std::type_index(typeid(T));
-        if (!componentManagers.contains(typeIndex)) {
-            auto manager = std::make_unique<ComponentManager<T>>();
-            componentManagers[typeIndex] = std::move(manager);
+        const ComponentTypeID typeID = getComponentTypeID<T>();
+        if (typeID >= componentManagers.size())
+            componentManagers.resize(typeID + 1);
+        if (!componentManagers[typeID]) {
+            componentManagers[typeID] = std::make_unique<ComponentManagerFor<T>>();
+            componentManagers[typeID]->liveness.attach(generations);
         }
     }
 
@@ -39,16 +169,22 @@ public:
     /// @tparam T The type of the @ref ComponentManager to get a reference for
     /// @return A reference to the @ref ComponentManager
     template <typename T>
-    ComponentManager<T>& getComponentManager() {
-        const auto typeIndex = std::type_index(typeid(T));
-        const auto componentManager = componentManagers.find(typeIndex);
-
-        if (componentManager != componentManagers.end())
-            return *static_cast<ComponentManager<T>*>(componentManager->second.get());
+    ComponentManagerFor<T>& getComponentManager() {
+        const ComponentTypeID typeID = getComponentTypeID<T>();
+        if (typeID < componentManagers.size() && componentManagers[typeID])
+            return *static_cast<ComponentManagerFor<T>*>(componentManagers[typeID].get());
         else
             throw std::runtime_error("Error: EntityManager does not have a componentManager");
     }
 
+    /// @brief Creates a @ref View over every entity that has all of the component types @c Ts
+    /// @tparam Ts The component types to query, all of their @ref ComponentManager "ComponentManagers" must be registered, @c const types are only read
+    /// @note @ref SoAComponent types can't be viewed and fail to compile here, see @ref View
+    template <typename... Ts>
+    View<Ts...> view() {
+        return View<Ts...>(getComponentManager<std::remove_const_t<Ts>>()...);
+    }
+
     /**
      * @brief Forwards registration to the @c SystemManager
      * 
@@ -76,7 +212,20 @@ public:
     inline SystemManager& getSystemManager() {
 		return systemManager;
 	}
+
+    /// @brief Returns a reference to the @ref ArchetypeStorage, the chunked alternative to the @ref ComponentManager "ComponentManagers"
+    inline ArchetypeStorage& getArchetypeStorage() {
+        return archetypeStorage;
+    }
 private:
-    std::unordered_map<std::type_index, std::unique_ptr<IComponentManager>> componentManagers;
+    /// @brief Indexed by @ref ComponentTypeID, types without a registered manager are @c nullptr
+    std::vector<std::unique_ptr<IComponentManager>> componentManagers;
     SystemManager systemManager;
+    ArchetypeStorage archetypeStorage;
+
+    /// @brief The current generation of each entity slot, slot 0 is never handed out so @c INVALID_ENTITY is never alive
+    std::vector<std::uint32_t> generations = { 0 };
+    std::vector<std::uint32_t> freeIndices;
+    /// @brief The number of @c freeIndices not yet taken by @ref reserveEntity, negative once reservations have run past the free list into new indices
+    std::atomic<std::int64_t> freeCursor = 0;
 };
\ No newline at end of file
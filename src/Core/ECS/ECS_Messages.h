@@ -1,7 +1,124 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
 /// @brief For making messages that are sent to a specific systems unlike broadcasts which are sent to all systems
 /// @see ECS_DESIGN for ECS design suggestion/guidelines
 struct Message {
     virtual ~Message() = default;
-};
\ No newline at end of file
+};
+
+/// @brief Size used to keep atomics written by different threads on separate cache lines
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/// @brief What @ref MessageChannel::push does when the ring is full
+enum class MessageOverflow {
+    /// @brief Give up on the message and return @c false
+    Drop,
+    /// @brief Yield until the consumer drains a slot, only safe if the consumer can run while the producer waits
+    Wait,
+};
+
+/**
+ * @brief A bounded multi-producer/single-consumer queue, the standard way for anything to send messages to an @ref ISystem
+ *
+ * Any number of threads can @c push at the same time without taking a lock or allocating, only the system that owns the channel may @c drain it
+ * Each slot has a sequence number that tells producers and the consumer whose turn it is, so a full ring is detected without locking
+ * The channel never grows, when the ring is full the producer decides with a @ref MessageOverflow whether the message is dropped or waits for a free slot
+ *
+ * @tparam T The message type, usually a @c std::variant of the messages the system accepts
+ * @tparam Capacity The number of messages the ring holds, must be a power of two, size it for the most messages the system can be sent between two drains
+ * @see ECS_DESIGN for ECS design suggestion/guidelines
+ */
+template <typename T, std::size_t Capacity = 1024>
+class MessageChannel {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MessageChannel capacity must be a power of two");
+
+public:
+    MessageChannel() : cells(std::make_unique<Cell[]>(Capacity)) {
+        for (std::size_t i = 0; i < Capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    MessageChannel(const MessageChannel&) = delete;
+    MessageChannel& operator=(const MessageChannel&) = delete;
+
+    /// @brief Tries to add a message to the ring without ever blocking
+    /// @return @c false if the ring is full, @c message is left untouched in that case
+    bool tryPush(T& message) {
+        std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & (Capacity - 1)];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+            if (difference == 0) {
+                // The slot is free, claim it by moving the enqueue position past it
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.message = std::move(message);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // The consumer hasn't freed this slot yet so the ring is full
+                return false;
+            } else {
+                // Another producer claimed the slot first
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Adds a message, @c overflow decides what happens if the ring is full
+     * @warning @ref MessageOverflow::Wait never returns if the consumer can't drain until the producer finishes, e.g. a system waiting on the job that pushes
+     * @return @c false if the ring was full and the message was dropped
+     */
+    bool push(T message, MessageOverflow overflow = MessageOverflow::Drop) {
+        while (!tryPush(message)) {
+            if (overflow == MessageOverflow::Drop)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Calls @c function on every message in the channel in the order they were added, must only be called by the consumer
+     * @param function Callable taking @c (T&)
+     * @return The number of messages handled
+     */
+    template <typename Function>
+    std::size_t drain(Function&& function) {
+        std::size_t handled = 0;
+        while (true) {
+            Cell& cell = cells[dequeuePosition & (Capacity - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+                break;
+
+            T message = std::move(cell.message);
+            // Hand the slot back to the producers one lap ahead
+            cell.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+            dequeuePosition++;
+
+            function(message);
+            handled++;
+        }
+        return handled;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T message;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueuePosition = 0;
+    /// @brief Only touched by the consumer
+    alignas(CACHE_LINE_SIZE) std::size_t dequeuePosition = 0;
+};
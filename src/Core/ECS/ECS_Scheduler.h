@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ECS_Types.h"
+#include "Core/JobSystem.h"
+
+/**
+ * @brief Runs a list of systems as a dependency graph built from their @ref SystemAccess declarations
+ *
+ * A system depends on every earlier registered system it conflicts with, so conflicting systems always run in registration order
+ * and the result of an update does not depend on thread timing. Systems with no unfinished dependencies are handed to the engine's @ref jobs::JobSystem as soon as they are ready
+ * @see ECS_DESIGN for ECS design suggestion/guidelines
+ */
+class SystemScheduler {
+public:
+    /// @brief Rebuilds the dependency graph, needs to be called whenever the list of systems changes
+    /// @param systems The systems in registration order
+    void build(const std::vector<ISystem*>& systems) {
+        scheduledSystems = systems;
+        dependents.assign(systems.size(), {});
+        dependencyCounts.assign(systems.size(), 0);
+        remainingDependencies = std::make_unique<std::atomic<std::size_t>[]>(systems.size());
+
+        std::vector<SystemAccess> accesses;
+        accesses.reserve(systems.size());
+        for (ISystem* system : systems)
+            accesses.push_back(system->getAccess());
+
+        for (std::size_t later = 0; later < systems.size(); later++) {
+            for (std::size_t earlier = 0; earlier < later; earlier++) {
+                if (accesses[earlier].conflictsWith(accesses[later])) {
+                    dependents[earlier].push_back(later);
+                    dependencyCounts[later]++;
+                }
+            }
+        }
+    }
+
+    /// @brief Runs every system once and returns when all of them have finished, rethrows the first exception thrown by a system
+    void run() {
+        if (scheduledSystems.empty())
+            return;
+
+        // Nothing to overlap, skip the hand-off to the workers
+        if (jobs::job_system.worker_count() == 0 || scheduledSystems.size() == 1) {
+            for (ISystem* system : scheduledSystems)
+                system->update();
+            return;
+        }
+
+        for (std::size_t i = 0; i < scheduledSystems.size(); i++)
+            remainingDependencies[i].store(dependencyCounts[i], std::memory_order_relaxed);
+        firstException = nullptr;
+
+        jobs::Counter counter;
+        for (std::size_t i = 0; i < scheduledSystems.size(); i++) {
+            if (dependencyCounts[i] == 0)
+                submitSystem(i, counter);
+        }
+
+        // The main thread helps run systems while it waits
+        jobs::wait(counter);
+        if (firstException)
+            std::rethrow_exception(firstException);
+    }
+
+private:
+    std::vector<ISystem*> scheduledSystems;
+    std::vector<std::vector<std::size_t>> dependents;
+    std::vector<std::size_t> dependencyCounts;
+    std::unique_ptr<std::atomic<std::size_t>[]> remainingDependencies;
+
+    std::mutex exceptionMutex;
+    std::exception_ptr firstException;
+
+    void submitSystem(std::size_t index, jobs::Counter& counter) {
+        jobs::run([this, index, &counter] {
+            try {
+                scheduledSystems[index]->update();
+            } catch (...) {
+                std::lock_guard lock(exceptionMutex);
+                if (!firstException)
+                    firstException = std::current_exception();
+            }
+
+            // Dependents are queued before this job finishes so the counter can't reach zero early
+            for (std::size_t dependent : dependents[index]) {
+                if (remainingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    submitSystem(dependent, counter);
+            }
+        }, &counter);
+    }
+};
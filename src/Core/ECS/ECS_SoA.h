@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ECS_Component.h"
+
+/// @brief Alignment in bytes of every column of a @ref SoAComponentManager, wide enough for any SIMD load
+constexpr std::size_t SOA_COLUMN_ALIGNMENT = 64;
+
+/**
+ * @brief Opts a component type into structure-of-arrays storage by listing its fields
+ *
+ * Specialize it with a @c static @c constexpr tuple of member pointers called @c fields, each field then gets its own column:
+ * @code
+ * template <>
+ * struct ComponentFields<Velocity> {
+ *     static constexpr auto fields = std::make_tuple(&Velocity::x, &Velocity::y, &Velocity::z);
+ * };
+ * @endcode
+ * Every field of the component should be listed, fields that aren't are default initialized when a component is read back
+ */
+template <typename T>
+struct ComponentFields;
+
+/// @brief A component stored by a @ref SoAComponentManager instead of a @ref ComponentManager
+template <typename T>
+concept SoAComponent = Component<T>
+    && std::is_trivially_copyable_v<T>
+    && std::is_default_constructible_v<T>
+    && requires { ComponentFields<T>::fields; };
+
+/// @brief One column of a @ref SoAComponentManager, a growable array of trivially copyable values aligned to @ref SOA_COLUMN_ALIGNMENT
+template <typename F>
+class SoAColumn {
+    static_assert(std::is_trivially_copyable_v<F>, "SoA columns can only hold trivially copyable fields");
+
+public:
+    F* data() { return values.get(); }
+    const F* data() const { return values.get(); }
+
+    F& operator[](std::size_t index) { return values[index]; }
+    const F& operator[](std::size_t index) const { return values[index]; }
+
+    /// @brief Grows the column to at least @c count values, keeping the first @c used of them
+    void reserve(std::size_t count, std::size_t used) {
+        if (count <= capacity)
+            return;
+
+        std::unique_ptr<F[], AlignedDelete> grown(static_cast<F*>(::operator new(count * sizeof(F), std::align_val_t(SOA_COLUMN_ALIGNMENT))));
+        if (used > 0)
+            std::memcpy(grown.get(), values.get(), used * sizeof(F));
+        values = std::move(grown);
+        capacity = count;
+    }
+
+private:
+    struct AlignedDelete {
+        void operator()(F* pointer) const { ::operator delete(pointer, std::align_val_t(SOA_COLUMN_ALIGNMENT)); }
+    };
+
+    std::unique_ptr<F[], AlignedDelete> values;
+    std::size_t capacity = 0;
+};
+
+/**
+ * @brief Stores a component type with one aligned array per field, the structure-of-arrays alternative to @ref ComponentManager
+ *
+ * Types opt in by specializing @ref ComponentFields, the @ref EntityManager then stores them with this manager automatically
+ * Kernels get a whole field with @c column, e.g. @c column<&Velocity::x>(), and can process @c SOA_COLUMN_ALIGNMENT bytes of it per instruction
+ * Column capacity is always rounded up to a multiple of @ref SOA_COLUMN_ALIGNMENT bytes so a kernel may read (but not rely on) whole vectors past @c size
+ * Components are not stored as whole objects so they are read and written by value with @c getComponent and @c addComponent, @ref View "Views" can't be used with them
+ *
+ * @tparam T The component type, see @ref SoAComponent
+ * @see ECS_DESIGN for ECS design suggestion/guidelines
+ */
+template <SoAComponent T>
+class SoAComponentManager : public IComponentManager {
+    static constexpr auto fields = ComponentFields<T>::fields;
+    static constexpr std::size_t FIELD_COUNT = std::tuple_size_v<std::remove_cv_t<decltype(fields)>>;
+
+    template <std::size_t I>
+    using FieldType = std::remove_cvref_t<decltype(std::declval<T&>().*std::get<I>(fields))>;
+
+    template <typename Indices>
+    struct ColumnsOf;
+    template <std::size_t... Is>
+    struct ColumnsOf<std::index_sequence<Is...>> {
+        using type = std::tuple<SoAColumn<FieldType<Is>>...>;
+    };
+
+public:
+    /// @brief Adds the component to the entity, if the entity already has one it is overwritten
+    /// @note A handle that isn't alive is rejected and reported, see @ref ComponentManager::addComponent
+    void addComponent(Entity entity, const T& component) {
+        if (!canAddTo(entity)) {
+            std::cerr << "Error: Trying to add a component to an entity that is not alive\n";
+            return;
+        }
+        std::uint32_t& slot = sparseIndex.slot(entity);
+        if (slot == INVALID_COMPONENT_INDEX) {
+            reserve(count + 1);
+            slot = static_cast<std::uint32_t>(count);
+            componentIndexToEntity.push_back(entity);
+            changeTicks.push_back(0);
+            count++;
+        }
+        scatter(slot, component, std::make_index_sequence<FIELD_COUNT>{});
+        stampChanged(slot);
+    }
+
+    /// @brief Overwrites the entity's component if it has one, unlike @c addComponent this never adds a component so it is safe while systems are running
+    /// @return @c false if the entity doesn't have a component of this type, nothing is written then
+    bool setComponent(Entity entity, const T& component) {
+        const std::uint32_t index = sparseIndex.find(entity, componentIndexToEntity);
+        if (index == INVALID_COMPONENT_INDEX)
+            return false;
+        scatter(index, component, std::make_index_sequence<FIELD_COUNT>{});
+        stampChanged(index);
+        return true;
+    }
+
+    /// @brief Gives every entity in @c entities a copy of @c prototype, reserving the columns once for the whole batch
+    /// @note An entity listed more than once is only added by its first entry, the rest are skipped and reported like @ref ComponentManager::addComponents does
+    void addComponents(std::span<const Entity> entities, const T& prototype) {
+        reserve(count + entities.size());
+
+        const std::size_t firstAdded = count;
+        std::size_t duplicateCount = 0;
+        std::size_t deadCount = 0;
+        for (Entity entity : entities) {
+            if (!canAddTo(entity)) {
+                deadCount++;
+                continue;
+            }
+            const std::uint32_t index = sparseIndex.find(entity, componentIndexToEntity);
+            if (index != INVALID_COMPONENT_INDEX && index >= firstAdded) {
+                duplicateCount++;
+                continue;
+            }
+            addComponent(entity, prototype);
+        }
+        if (duplicateCount > 0)
+            std::cerr << "Error: Skipped " << duplicateCount << " duplicate entities in a batch of added components\n";
+        if (deadCount > 0)
+            std::cerr << "Error: Skipped " << deadCount << " entities that are not alive in a batch of added components\n";
+    }
+
+    /// @brief Reads the entity's component back out of the columns
+    /// @return The component or @c std::nullopt if the entity doesn't have one or the handle is stale
+    std::optional<T> getComponent(Entity entity) const {
+        const std::uint32_t index = sparseIndex.find(entity, componentIndexToEntity);
+        if (index == INVALID_COMPONENT_INDEX)
+            return std::nullopt;
+        return gather(index, std::make_index_sequence<FIELD_COUNT>{});
+    }
+
+    /// @brief Returns the dense index of the entity's component, the index into every @c column, or @c INVALID_COMPONENT_INDEX
+    std::uint32_t indexOf(Entity entity) const {
+        return sparseIndex.find(entity, componentIndexToEntity);
+    }
+
+    /// @brief Checks if the entity has a component of this type
+    bool contains(Entity entity) const {
+        return sparseIndex.find(entity, componentIndexToEntity) != INVALID_COMPONENT_INDEX;
+    }
+
+    /// @brief Returns the column holding the field @c Member of every component, indexed the same as @ref get_raw_entity_list
+    /// @note Writing through the column doesn't mark components as changed, call @ref markChanged for the ones written to
+    template <auto Member>
+    auto* column() {
+        return std::get<fieldIndex<Member>()>(columns).data();
+    }
+
+    /// @brief Read only version of @c column
+    template <auto Member>
+    const auto* column() const {
+        return std::get<fieldIndex<Member>()>(columns).data();
+    }
+
+    /// @brief Removes the entity's component by moving the last component of every column into its place
+    void removeComponent(Entity entity) override {
+        const std::uint32_t removeIndex = sparseIndex.find(entity, componentIndexToEntity);
+        if (removeIndex == INVALID_COMPONENT_INDEX) {
+            std::cerr << "Error: Trying to remove nonexistent component from entity\n";
+            return;
+        }
+
+        const std::uint32_t lastIndex = static_cast<std::uint32_t>(count - 1);
+        if (removeIndex != lastIndex) {
+            std::apply([&](auto&... column) { ((column[removeIndex] = column[lastIndex]), ...); }, columns);
+            const Entity lastEntity = componentIndexToEntity[lastIndex];
+            componentIndexToEntity[removeIndex] = lastEntity;
+            changeTicks[removeIndex] = changeTicks[lastIndex];
+            sparseIndex.slot(lastEntity) = removeIndex;
+        }
+
+        componentIndexToEntity.pop_back();
+        changeTicks.pop_back();
+        count--;
+        sparseIndex.slot(entity) = INVALID_COMPONENT_INDEX;
+    }
+
+    /// @brief Removes the entity's component if it has one, called by the @ref EntityManager when the entity is destroyed
+    void entityDestroyed(Entity entity) override {
+        if (contains(entity))
+            removeComponent(entity);
+    }
+
+    /// @brief Copies @c source's component to every entity in @c targets
+    void cloneComponent(Entity source, std::span<const Entity> targets) override {
+        if (const std::optional<T> prototype = getComponent(source))
+            addComponents(targets, *prototype);
+    }
+
+    /// @brief Marks the entity's component as changed
+    void markChanged(Entity entity) {
+        const std::uint32_t index = sparseIndex.find(entity, componentIndexToEntity);
+        if (index != INVALID_COMPONENT_INDEX)
+            stampChanged(index);
+    }
+
+    /// @brief Checks if the entity's component was added or changed after @c tick
+    bool changedSince(Entity entity, ChangeTick tick) const {
+        const std::uint32_t index = sparseIndex.find(entity, componentIndexToEntity);
+        return index != INVALID_COMPONENT_INDEX && changeTicks[index] > tick;
+    }
+
+    /// @brief Checks if any component of this type was added or changed after @c tick
+    bool changedSince(ChangeTick tick) const {
+        return lastChangeTick > tick;
+    }
+
+    /// @brief Returns the entities that own each component, indexed the same as the columns
+    const std::vector<Entity>& get_raw_entity_list() const {
+        return componentIndexToEntity;
+    }
+
+    /// @brief Returns the @ref ChangeTick each component was last changed on, indexed the same as the columns
+    const std::vector<ChangeTick>& get_raw_change_tick_list() const {
+        return changeTicks;
+    }
+
+    /// @brief The number of components currently stored
+    std::size_t size() const {
+        return count;
+    }
+
+    /// @brief Reserves room for @c newCapacity components in every column
+    void reserve(std::size_t newCapacity) {
+        if (newCapacity <= capacity)
+            return;
+
+        newCapacity = std::max(newCapacity, capacity * 2);
+        newCapacity = (newCapacity + COLUMN_GRANULARITY - 1) / COLUMN_GRANULARITY * COLUMN_GRANULARITY;
+        std::apply([&](auto&... column) { (column.reserve(newCapacity, count), ...); }, columns);
+        componentIndexToEntity.reserve(newCapacity);
+        changeTicks.reserve(newCapacity);
+        capacity = newCapacity;
+    }
+
+private:
+    /// @brief Capacity is a multiple of this so even the smallest field's column fills whole @ref SOA_COLUMN_ALIGNMENT sized vectors
+    static constexpr std::size_t COLUMN_GRANULARITY = SOA_COLUMN_ALIGNMENT;
+
+    typename ColumnsOf<std::make_index_sequence<FIELD_COUNT>>::type columns;
+    std::size_t count = 0;
+    std::size_t capacity = 0;
+
+    std::vector<Entity> componentIndexToEntity;
+    std::vector<ChangeTick> changeTicks;
+    ChangeTick lastChangeTick = 0;
+    SparseEntityIndex sparseIndex;
+
+    /// @brief Same check as @ref ComponentManager uses, the handle must be alive and not share its slot with another generation
+    bool canAddTo(Entity entity) const {
+        if (!liveness.isAlive(entity))
+            return false;
+        const Entity occupant = sparseIndex.occupant(entity, componentIndexToEntity);
+        return occupant == INVALID_ENTITY || occupant == entity;
+    }
+
+    template <auto Member>
+    static constexpr std::size_t fieldIndex() {
+        constexpr std::size_t index = []<std::size_t... Is>(std::index_sequence<Is...>) {
+            std::size_t found = FIELD_COUNT;
+            ((found = (found == FIELD_COUNT && sameMember<Member>(std::get<Is>(fields))) ? Is : found), ...);
+            return found;
+        }(std::make_index_sequence<FIELD_COUNT>{});
+        static_assert(index < FIELD_COUNT, "The member is not listed in ComponentFields");
+        return index;
+    }
+
+    template <auto Member, typename M>
+    static constexpr bool sameMember(M member) {
+        if constexpr (std::is_same_v<decltype(Member), M>)
+            return Member == member;
+        else
+            return false;
+    }
+
+    template <std::size_t... Is>
+    void scatter(std::size_t index, const T& component, std::index_sequence<Is...>) {
+        ((std::get<Is>(columns)[index] = component.*std::get<Is>(fields)), ...);
+    }
+
+    template <std::size_t... Is>
+    T gather(std::size_t index, std::index_sequence<Is...>) const {
+        T component{};
+        ((component.*std::get<Is>(fields) = std::get<Is>(columns)[index]), ...);
+        return component;
+    }
+
+    void stampChanged(std::size_t index) {
+        const ChangeTick tick = currentChangeTick();
+        changeTicks[index] = tick;
+        lastChangeTick = tick;
+    }
+};
+
+/// @brief Picks the manager a component type is stored in, @ref SoAComponentManager for types with @ref ComponentFields and @ref ComponentManager for everything else
+template <typename T>
+struct ComponentStorage {
+    using type = ComponentManager<T>;
+};
+
+template <SoAComponent T>
+struct ComponentStorage<T> {
+    using type = SoAComponentManager<T>;
+};
+
+template <typename T>
+using ComponentManagerFor = typename ComponentStorage<T>::type;
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <typeindex>
-#include <unordered_map>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #include "ECS_Types.h"
 #include "ECS_Messages.h"
+#include "ECS_Scheduler.h"
 
 /// @brief Manages the systems of all the entities
+///
+/// Systems are updated through a @ref SystemScheduler, systems that declare non-conflicting @ref SystemAccess run in parallel and conflicting ones run in registration order
 /// @see ECS_DESIGN for ECS design suggestion/guidelines
 class SystemManager {
 public:
@@ -22,8 +28,21 @@ public:
      */
     template <typename T, typename... Args>
     inline void registerSystem (Args&... args) {
+        static_assert(std::is_base_of_v<ISystem, T>, "Systems must inherit from ISystem");
+
         auto system = std::make_unique<T> (args...);
-        systems[std::type_index(typeid(T))] = std::move(system);
+        const SystemTypeID typeID = getSystemTypeID<T>();
+        if (typeID >= systemIndices.size())
+            systemIndices.resize(typeID + 1, NO_SYSTEM);
+
+        // Re-registering a system replaces it but keeps its place in the update order
+        if (systemIndices[typeID] != NO_SYSTEM) {
+            systems[systemIndices[typeID]] = std::move(system);
+        } else {
+            systemIndices[typeID] = systems.size();
+            systems.push_back(std::move(system));
+        }
+        scheduleOutOfDate = true;
     }
 
     /// @brief Returns a reference to the system based off of the type of it
@@ -31,19 +50,33 @@ public:
     /// @return A reference to the system
     template <typename T>
     inline T& getSystem() {
-        auto system = systems.find(std::type_index(typeid(T)));
-        if (system != systems.end())
-            return *dynamic_cast<T*>(system->second.get());
+        const SystemTypeID typeID = getSystemTypeID<T>();
+        if (typeID < systemIndices.size() && systemIndices[typeID] != NO_SYSTEM)
+            return *static_cast<T*>(systems[systemIndices[typeID]].get());
         else
             throw std::runtime_error("Error: System not found");
     }
 
     /// @brief Calls @c update on all the systems which is defined by @ref ISystem which all systems should inherit from
+    /// @note Returns once every system has finished, systems may be updated on worker threads
     inline void updateSystems() {
-        for (auto& system : systems) {
-            system.second->update();
+        if (scheduleOutOfDate) {
+            std::vector<ISystem*> orderedSystems;
+            orderedSystems.reserve(systems.size());
+            for (auto& system : systems)
+                orderedSystems.push_back(system.get());
+            scheduler.build(orderedSystems);
+            scheduleOutOfDate = false;
         }
+        scheduler.run();
     }
 private:
-    std::unordered_map<std::type_index, std::shared_ptr<ISystem>> systems;
+    /// @brief The systems in registration order, this is the order conflicting systems are updated in
+    std::vector<std::unique_ptr<ISystem>> systems;
+    /// @brief The position in @c systems of each system, indexed by @ref SystemTypeID
+    std::vector<std::size_t> systemIndices;
+    static constexpr std::size_t NO_SYSTEM = SIZE_MAX;
+
+    SystemScheduler scheduler;
+    bool scheduleOutOfDate = false;
 };
\ No newline at end of file
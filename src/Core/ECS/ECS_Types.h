@@ -1,29 +1,174 @@
 #pragma once
+#include <atomic>
+#include <bitset>
 #include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
 
-/// @brief @c Entity is just an alias of @c std::uint32_t which is just the id of the entity
+/// @brief @c Entity is just an alias of @c std::uint32_t which is the id of the entity
+///
+/// The lower @c ENTITY_INDEX_BITS bits are the index of the entity's slot and the upper @c ENTITY_GENERATION_BITS bits are the generation of that slot,
+/// the generation is bumped every time the slot is recycled so stale handles to destroyed entities can be detected
 /// @see ECS_DESIGN for ECS design suggestion/guidelines
 using Entity = std::uint32_t;
 constexpr Entity INVALID_ENTITY = 0;
 
+constexpr std::uint32_t ENTITY_INDEX_BITS = 20;
+constexpr std::uint32_t ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+constexpr std::uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+constexpr std::uint32_t ENTITY_GENERATION_MASK = (1u << ENTITY_GENERATION_BITS) - 1;
+
+/// @brief Returns the slot index part of the entity, this is what sparse storage is indexed by
+constexpr std::uint32_t entityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+/// @brief Returns the generation part of the entity
+constexpr std::uint32_t entityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+/// @brief Packs a slot index and a generation into an @c Entity
+constexpr Entity makeEntity(std::uint32_t index, std::uint32_t generation) {
+    return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+}
+
+/**
+ * @brief Lets component storage check if a handle is alive without depending on the @ref EntityManager
+ *
+ * It reads the manager's generation of each slot, storage that was never registered with an @ref EntityManager takes every valid handle as alive
+ */
+class EntityLiveness {
+public:
+    void attach(const std::vector<std::uint32_t>& entityGenerations) { generations = &entityGenerations; }
+
+    /// @brief The same check as @ref EntityManager::isAlive
+    bool isAlive(Entity entity) const {
+        if (entity == INVALID_ENTITY)
+            return false;
+        if (!generations)
+            return true;
+        const std::uint32_t index = entityIndex(entity);
+        return index < generations->size() && (*generations)[index] == entityGeneration(entity);
+    }
+
+private:
+    const std::vector<std::uint32_t>* generations = nullptr;
+};
+
+/// @brief A small integer id given to each component type the first time it is asked for, used to build component signatures
+using ComponentTypeID = std::uint32_t;
+/// @brief The maximum number of distinct component types, this is the width of @ref ComponentSignature
+constexpr ComponentTypeID MAX_COMPONENT_TYPES = 64;
+
+inline std::atomic<ComponentTypeID> nextComponentTypeID = 0;
+
+/// @brief Returns the id of the component type @c T, ids are handed out in the order the types are first used
+///
+/// The id is also the index of the type's @ref ComponentManager inside the @ref EntityManager so typed lookups are a plain array access
+/// @note @c const and @c volatile are ignored, @c const T has the same id as @c T
+template <typename T>
+ComponentTypeID getComponentTypeID() {
+    if constexpr (!std::is_same_v<T, std::remove_cv_t<T>>) {
+        return getComponentTypeID<std::remove_cv_t<T>>();
+    } else {
+        static const ComponentTypeID id = nextComponentTypeID.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+}
+
+/// @brief A small integer id given to each system type the first time it is asked for, it is the index of the system inside the @ref SystemManager
+using SystemTypeID = std::uint32_t;
+
+inline std::atomic<SystemTypeID> nextSystemTypeID = 0;
+
+/// @brief Returns the id of the system type @c T, ids are handed out in the order the types are first used
+template <typename T>
+SystemTypeID getSystemTypeID() {
+    static const SystemTypeID id = nextSystemTypeID.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+/**
+ * @brief A global counter used to tell which components changed since a point in time
+ *
+ * Every write to a component through a @ref ComponentManager stamps it with the current tick, consumers remember the tick returned by @ref advanceChangeTick
+ * and next time only look at components stamped after it with @c changedSince
+ */
+using ChangeTick = std::uint32_t;
+
+/// @brief Starts at 1 so a tick of 0 means "never seen anything" and every stamped component counts as changed since it
+inline std::atomic<ChangeTick> globalChangeTick = 1;
+
+/// @brief The tick writes are currently being stamped with
+inline ChangeTick currentChangeTick() { return globalChangeTick.load(std::memory_order_relaxed); }
+
+/// @brief Moves writes onto a new tick and returns the old one, changes stamped up to and including the returned tick have been seen once the caller is done
+inline ChangeTick advanceChangeTick() { return globalChangeTick.fetch_add(1, std::memory_order_relaxed); }
+
+/// @brief Which component types an entity has, bit @c i is set if it has the component with @ref ComponentTypeID @c i
+using ComponentSignature = std::bitset<MAX_COMPONENT_TYPES>;
+
 struct IComponentManager {
     virtual ~IComponentManager() = default;
+    /// @brief Attached by @ref EntityManager::registerComponentManager, adding a component to a handle that isn't alive is rejected with it
+    EntityLiveness liveness;
     virtual void removeComponent(Entity entity) = 0;
+    /// @brief Called by the @ref EntityManager when an entity is destroyed, unlike @c removeComponent it is not an error if the entity has no component
+    virtual void entityDestroyed(Entity entity) = 0;
+    /// @brief Gives every entity in @c targets a copy of @c source's component, does nothing if @c source doesn't have one
+    virtual void cloneComponent(Entity source, std::span<const Entity> targets) = 0;
 };
 
 /**
- * @brief Every component should inherit from this interface
- * @warning variable @c thisEntity is the entityID of the entity that owns the component, it should always be used in conjunction with @ref ComponentManager::getComponent to get a reference of itself and the @c this pointer should never be used
+ * @brief What a type needs to be stored as a component, components are plain types and don't inherit from anything
+ *
+ * The entity that owns a component is only stored by its @ref ComponentManager, use @ref ComponentManager::getEntity to find it from the component
+ * Trivially copyable components take faster paths when they are moved around, removed or serialized so prefer keeping components as plain data
  */
-struct IComponent {
-    Entity thisEntity;
+template <typename T>
+concept Component = std::is_object_v<T> && !std::is_const_v<T> && std::is_move_constructible_v<T> && std::is_move_assignable_v<T>;
 
-    virtual ~IComponent() = default;
-    virtual void initialize(Entity initializedEntity) { thisEntity = initializedEntity; };
-};
+/// @brief Components can optionally define @c initialize(Entity) which is called once they've been added to an entity
+template <typename T>
+concept InitializableComponent = requires(T& component, Entity entity) { component.initialize(entity); };
+
+/// @brief Calls the component's @c initialize if it has one
+template <typename T>
+void initializeComponent(T& component, Entity entity) {
+    if constexpr (InitializableComponent<T>)
+        component.initialize(entity);
+}
 
 
+/**
+ * @brief The components a system reads and writes during @c update, used by the @ref SystemManager to decide which systems can run at the same time
+ *
+ * Two systems conflict if either one writes a component the other one reads or writes, conflicting systems always run in the order they were registered
+ * Systems that don't declare their access are @c exclusive and never run alongside any other system
+ */
+struct SystemAccess {
+    ComponentSignature reads{};
+    ComponentSignature writes{};
+    bool exclusive = false;
+
+    template <typename... Ts>
+    SystemAccess& read() {
+        (reads.set(getComponentTypeID<Ts>()), ...);
+        return *this;
+    }
+
+    template <typename... Ts>
+    SystemAccess& write() {
+        (writes.set(getComponentTypeID<Ts>()), ...);
+        return *this;
+    }
+
+    bool conflictsWith(const SystemAccess& other) const {
+        return exclusive || other.exclusive
+            || (writes & (other.reads | other.writes)).any()
+            || (other.writes & reads).any();
+    }
+};
+
 struct ISystem {
     virtual ~ISystem() = default;
     virtual void update() = 0;
+    /// @brief Declares which components @c update touches, override this so the system can run in parallel with systems it doesn't conflict with
+    virtual SystemAccess getAccess() const { return SystemAccess{ .exclusive = true }; }
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "ECS_Component.h"
+#include "ECS_SoA.h"
+
+/**
+ * @brief A query over every entity that has all of the component types @c Ts
+ *
+ * Iteration is driven by whichever @ref ComponentManager is the smallest when the view is created, every other component is found through its manager's sparse array so no hashing is done
+ * Each element is a @c std::tuple of the entity followed by references to its components, so it can be used with structured bindings:
+ * @code
+ * for (auto [entity, mesh, transform] : ecs::view<ManagedMesh, TransformComponent>()) { ... }
+ * @endcode
+ * Components of a non-const type are marked as changed when they are accessed, a non-const view type is how a system says it writes them,
+ * list a type as @c const (e.g. @c View<const TransformComponent>) to only read it
+ * @c changedSince narrows the view down to entities whose component of a given type changed after a @ref ChangeTick
+ * @warning Adding or removing components of the viewed types while iterating invalidates the view, record those changes and apply them afterwards
+ * @note Only types stored in a @ref ComponentManager can be viewed, @ref SoAComponent types have no component objects to reference,
+ * walk their @ref SoAComponentManager::column "columns" or read them by value with @ref SoAComponentManager::getComponent instead
+ *
+ * @tparam Ts The component types an entity must have to be part of the view
+ * @see ECS_DESIGN for ECS design suggestion/guidelines
+ */
+template <typename... Ts>
+class View {
+    static_assert(sizeof...(Ts) > 0, "A view needs at least one component type");
+    static_assert((!SoAComponent<std::remove_const_t<Ts>> && ...),
+        "SoA components can't be viewed, use SoAComponentManager::column or SoAComponentManager::getComponent for them");
+
+    /// @brief The manager of a viewed type, read only for @c const types so accessing them doesn't mark them as changed
+    template <typename T>
+    using ManagerOf = std::conditional_t<std::is_const_v<T>, const ComponentManager<std::remove_const_t<T>>, ComponentManager<std::remove_const_t<T>>>;
+
+public:
+    using Element = std::tuple<Entity, Ts&...>;
+
+    explicit View(ManagerOf<Ts>&... managers)
+        : pools(&managers...) {
+        const std::array<std::size_t, sizeof...(Ts)> sizes = { managers.size()... };
+        const std::array<const std::vector<Entity>*, sizeof...(Ts)> entityLists = { &managers.get_raw_entity_list()... };
+        for (std::size_t i = 1; i < sizes.size(); i++) {
+            if (sizes[i] < sizes[driver])
+                driver = i;
+        }
+        drivingEntities = entityLists[driver];
+    }
+
+    class Iterator {
+    public:
+        Iterator(const View* view, std::size_t position)
+            : view(view), position(position) { skipUnmatched(); }
+
+        Element operator*() const {
+            return view->elementAt(position, std::index_sequence_for<Ts...>{});
+        }
+
+        Iterator& operator++() {
+            position++;
+            skipUnmatched();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return position == other.position; }
+        bool operator!=(const Iterator& other) const { return position != other.position; }
+
+    private:
+        const View* view;
+        std::size_t position;
+
+        void skipUnmatched() {
+            while (position < view->drivingSize() && !view->matches(position))
+                position++;
+        }
+    };
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, drivingSize()); }
+
+    /// @brief Calls @c function with the entity and references to each of its components for every entity in the view
+    /// @param function Callable taking @c (Entity, Ts&...)
+    template <typename Function>
+    void each(Function&& function) const {
+        for (std::size_t position = 0; position < drivingSize(); position++) {
+            if (matches(position))
+                std::apply(function, elementAt(position, std::index_sequence_for<Ts...>{}));
+        }
+    }
+
+    /// @brief The number of entities the view iterates before filtering, this is the size of the smallest @ref ComponentManager
+    std::size_t size_hint() const { return drivingSize(); }
+
+    /**
+     * @brief Returns a copy of the view that only has the entities whose @c T component was added or changed after @c tick
+     * @code
+     * for (auto [entity, transform] : ecs::view<const TransformComponent>().changedSince<TransformComponent>(lastTick)) { ... }
+     * @endcode
+     * @tparam T One of the viewed component types, with or without @c const
+     */
+    template <typename T>
+    View changedSince(ChangeTick tick) const {
+        constexpr std::array<bool, sizeof...(Ts)> isT = { std::is_same_v<std::remove_const_t<Ts>, std::remove_const_t<T>>... };
+        constexpr std::size_t index = [isT] {
+            for (std::size_t i = 0; i < isT.size(); i++) {
+                if (isT[i])
+                    return i;
+            }
+            return isT.size();
+        }();
+        static_assert(index < sizeof...(Ts), "changedSince needs one of the viewed component types");
+
+        View filtered = *this;
+        filtered.changeFilters[index] = tick;
+        return filtered;
+    }
+
+private:
+    std::tuple<ManagerOf<Ts>*...> pools;
+    /// @brief Per viewed type, only components changed after this tick match, 0 lets every component through
+    std::array<ChangeTick, sizeof...(Ts)> changeFilters = {};
+    /// @brief Index into @c Ts of the smallest manager, its dense entity array is what is iterated
+    std::size_t driver = 0;
+    const std::vector<Entity>* drivingEntities = nullptr;
+
+    std::size_t drivingSize() const { return drivingEntities->size(); }
+    Entity entityAt(std::size_t position) const { return (*drivingEntities)[position]; }
+
+    bool matches(std::size_t position) const {
+        return matchesAll(position, entityAt(position), std::index_sequence_for<Ts...>{});
+    }
+
+    template <std::size_t... Is>
+    bool matchesAll(std::size_t position, Entity entity, std::index_sequence<Is...>) const {
+        return ((Is == driver || std::get<Is>(pools)->contains(entity)) && ...)
+            && (matchesChangeFilter<Is>(position, entity) && ...);
+    }
+
+    template <std::size_t I>
+    bool matchesChangeFilter(std::size_t position, Entity entity) const {
+        if (changeFilters[I] == 0)
+            return true;
+        if (I == driver)
+            return std::get<I>(pools)->get_raw_change_tick_list()[position] > changeFilters[I];
+        return std::get<I>(pools)->changedSince(entity, changeFilters[I]);
+    }
+
+    template <std::size_t I>
+    auto& componentAt(std::size_t position, Entity entity) const {
+        auto* pool = std::get<I>(pools);
+        // The driving manager can be indexed directly, everything else goes through the sparse array
+        const std::size_t index = I == driver ? position : pool->indexOf(entity);
+        if constexpr (!std::is_const_v<std::tuple_element_t<I, std::tuple<Ts...>>>)
+            pool->markChangedAt(index);
+        return pool->getComponentAt(index);
+    }
+
+    template <std::size_t... Is>
+    Element elementAt(std::size_t position, std::index_sequence<Is...>) const {
+        const Entity entity = entityAt(position);
+        return Element(entity, componentAt<Is>(position, entity)...);
+    }
+};
@@ -19,6 +19,8 @@
 #include "ECS_modules/Managed_mesh/ManagedMesh.h"
 
 #include "ECS/ECS.h"
+#include "Core/JobSystem.h"
+#include "Core/FixedTimestep.h"
 
 #include "ECS_modules/Transform/Transform_component.h"
 
@@ -26,14 +28,24 @@
 #include <daxa/utils/pipeline_manager.hpp>
 #include <daxa/utils/task_graph.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 #include <Daxa/utils/imgui.hpp>
 #include <imgui_impl_glfw.h>
 
 constexpr float MAX_DELTA_TIME = 0.1f;
+/// @brief Systems update at this rate whatever the frame rate is, transforms are interpolated between ticks for rendering
+constexpr float SIMULATION_TICK_RATE = 60.0f;
+constexpr int MAX_SIMULATION_TICKS_PER_FRAME = 5;
+/// @brief With @c CullingMode::CPU, meshes whose bounds are at least this fraction of the largest mesh's (walls, floors, pillars) become occluders
+constexpr float OCCLUDER_MIN_RELATIVE_SIZE = 0.25f;
 
 int init() {
+    // One core less for the workers than usual, the main thread and the render thread each keep one
+    const std::size_t worker_count = jobs::JobSystem::default_worker_count();
+    jobs::job_system.init(worker_count > 0 ? worker_count - 1 : 0);
+
     ///@brief Sets up a window, daxa instance and a @ref Renderer
     auto window = GLFW_Window::AppWindow("Hur Dur", 1600, 900);
 
@@ -145,7 +157,9 @@ int init() {
     ecs::entityManager.registerComponentManager<ManagedMesh>();    
 
     ecs::entityManager.registerComponentManager<TransformComponent>();
-    ecs::entityManager.registerSystem<TransformSystem>(device, renderer, ecs::entityManager.getComponentManager<ManagedMesh>());
+    ecs::entityManager.registerComponentManager<TransformTRS>();
+    ecs::entityManager.registerComponentManager<TransformParent>();
+    ecs::entityManager.registerSystem<TransformSystem>(renderer, ecs::entityManager.getComponentManager<ManagedMesh>());
 
     // Meshes
     {
@@ -155,7 +169,7 @@ int init() {
 
         for (int model_i = 0; model_i < loader.modelData.size(); ++model_i) {
             for (int prim_i = 0; prim_i < loader.modelData[model_i].primitives.size(); ++prim_i) {
-                testEntities.push_back(EntityManager::createEntity());
+                testEntities.push_back(ecs::createEntity());
 
                 if (loader.modelData[model_i].primitives[prim_i].albedo.has_value()) {
                     textures.push_back(std::make_unique<TextureHandle>(device));
@@ -169,7 +183,7 @@ int init() {
         for (int model_i = 0; model_i < loader.modelData.size(); ++model_i) {
             for (int prim_i = 0; prim_i < loader.modelData[model_i].primitives.size(); ++prim_i) {
                 ecs::getComponentManager<ManagedMesh>().addComponent(testEntities[model_i * loader.modelData.size() + prim_i], ManagedMesh(loader, model_i, prim_i, meshManager, renderer.drawGroups[0], renderer, {views[model_i * loader.modelData.size() + prim_i], sampler}));
-                ecs::getComponentManager<TransformComponent>().addComponent(testEntities[model_i * loader.modelData.size() + prim_i], TransformComponent(ecs::entityManager, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.01f)));
+                ecs::getComponentManager<TransformComponent>().addComponent(testEntities[model_i * loader.modelData.size() + prim_i], TransformComponent(ecs::entityManager, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.01f), true));
             }
         }
     }
@@ -202,7 +216,7 @@ int init() {
     //                int cubeIndex = x * grid_size * grid_size + y * grid_size + z; // Unique speed per instance
     //                
     //                if (cubeIndex != 0) {
-    //                    testEntities.push_back(EntityManager::createEntity());
+    //                    testEntities.push_back(ecs::createEntity());
     //                    ecs::getComponent<ManagedMesh>(testEntities[0])->instantiate(testEntities[cubeIndex], meshComponenetManager, { view1, sampler });
     //                    ecs::getComponentManager<TransformComponent>().addComponent(testEntities[cubeIndex], TransformComponent(ecs::entityManager, position, glm::vec3(0.0f), glm::vec3(1.0f)));
     //                } else {
@@ -213,10 +227,26 @@ int init() {
     //    }
     //}
 
+    // The big architectural meshes hide most of the rest, a few occluders keep the software rasterization cheap
+    if constexpr (CULLING_MODE == CullingMode::CPU) {
+        auto bounds_size = [](const DrawableMesh& mesh) { return glm::length(to_glm(mesh.aabb_max) - to_glm(mesh.aabb_min)); };
+
+        float largest_size = 0.0f;
+        for (const auto& mesh : meshManager.meshes)
+            largest_size = std::max(largest_size, bounds_size(*mesh));
+        for (const auto& mesh : meshManager.meshes) {
+            if (bounds_size(*mesh) >= largest_size * OCCLUDER_MIN_RELATIVE_SIZE)
+                mesh->make_occluder();
+        }
+    }
+
+    // Bakes the static transforms into the instance data before it is uploaded
+    ecs::updateSystems();
     renderer.drawGroups[0].uploadBuffers(meshManager.upload_task_graph);
 
     meshManager.submit_upload_task_graph();
     renderer.submit_task_graph();
+    renderer.start_render_thread();
 
     Camera camera;
     camera.update_vectors();
@@ -227,12 +257,14 @@ int init() {
     window.set_mouse_capture(true);
 
     auto last_frame_time = static_cast<float>(glfwGetTime());
-    ecs::updateSystems();
+    FixedTimestep simulation_timestep(SIMULATION_TICK_RATE, MAX_SIMULATION_TICKS_PER_FRAME);
 
     ///@brief Main game loop
     while (!window.should_close()) {
         auto current_time = static_cast<float>(glfwGetTime());
 
+        const int simulation_ticks = simulation_timestep.advance(current_time - last_frame_time);
+
         float delta_time = current_time - last_frame_time;
         if (delta_time > MAX_DELTA_TIME) delta_time = MAX_DELTA_TIME;
 
@@ -241,8 +273,6 @@ int init() {
         window.update();
 
         InputSystem::process_input(window.get_glfw_window(), camera, delta_time);
-        
-        renderer.startFrame(camera);
 
         // ------------------------------------------------------ Goofy ahh test stuff ------------------------------------------------------
         //for (int x = 0; x < grid_size; ++x) {
@@ -273,10 +303,14 @@ int init() {
             ImGui::Render();
         }
         // ------------------------------------------------------- Goofy ahh test stuff ------------------------------------------------------
-        ecs::updateSystems();
+        for (int tick = 0; tick < simulation_ticks; tick++)
+            ecs::updateSystems();
+        ecs::getSystem<TransformSystem>().interpolateTransforms(simulation_timestep.alpha());
 
-        renderer.endFrame();
+        // The render thread records and submits this frame while the loop goes on to simulate the next one
+        renderer.publish_snapshot(camera);
     }
+    renderer.stop_render_thread();
 
     for (auto& texture : textures) {
         texture->cleanup();
@@ -292,5 +326,7 @@ int init() {
     device.wait_idle();
     device.collect_garbage();
 
+    jobs::job_system.shutdown();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Turns variable frame times into a whole number of fixed length simulation ticks
+ *
+ * Each frame's time is added to an accumulator and @c advance returns how many whole ticks fit in it, the remainder carries over to the next frame
+ * so the simulation runs at the same rate whatever the frame rate is. @c alpha is how far the frame is into the next tick, for interpolating what is rendered
+ *
+ * If the simulation falls behind (after a hitch or while debugging) at most @c max_ticks_per_frame are run and the rest of the backlog is dropped,
+ * otherwise a slow frame would cause more ticks, making the next frame slower still
+ */
+class FixedTimestep {
+public:
+    /// @param tick_rate Simulation ticks per second
+    /// @param max_ticks_per_frame The catch-up limit, how many ticks a single frame may run
+    explicit FixedTimestep(float tick_rate, int max_ticks_per_frame = 5)
+        : tick_duration(1.0f / tick_rate), max_ticks_per_frame(max_ticks_per_frame) {}
+
+    /// @brief Adds a frame's time to the accumulator
+    /// @return The number of ticks to run this frame
+    int advance(float frame_time) {
+        accumulator += std::max(frame_time, 0.0f);
+
+        int ticks = 0;
+        while (accumulator >= tick_duration && ticks < max_ticks_per_frame) {
+            accumulator -= tick_duration;
+            ticks++;
+        }
+
+        // Anything still left is more than the catch-up limit allows, drop it but keep the fraction of a tick so alpha stays smooth
+        if (accumulator >= tick_duration)
+            accumulator = std::fmod(accumulator, tick_duration);
+        return ticks;
+    }
+
+    /// @brief How far the current frame is between the last tick (0) and the next one (1)
+    float alpha() const {
+        return accumulator / tick_duration;
+    }
+
+    /// @brief The length of one tick in seconds, the delta time of the simulation
+    float get_tick_duration() const {
+        return tick_duration;
+    }
+
+private:
+    float tick_duration;
+    int max_ticks_per_frame;
+    float accumulator = 0.0f;
+};
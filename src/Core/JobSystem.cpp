@@ -0,0 +1,183 @@
+#include "JobSystem.h"
+
+#include <iostream>
+#include <utility>
+
+namespace jobs {
+    namespace {
+        constexpr std::size_t NOT_A_WORKER = SIZE_MAX;
+
+        /// @brief The index of the worker the current thread is, or @c NOT_A_WORKER for the main thread and any other thread
+        thread_local std::size_t current_worker = NOT_A_WORKER;
+    }
+
+    std::size_t JobSystem::default_worker_count() {
+        const unsigned int hardware_threads = std::thread::hardware_concurrency();
+        return hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+
+    void JobSystem::init(std::size_t worker_count) {
+        if (!workers.empty())
+            return;
+
+        stopping = false;
+        // One deque per worker in front of the injection queue, which keeps any jobs that were queued before init
+        for (std::size_t i = 0; i < worker_count; i++)
+            queues.insert(queues.begin(), std::make_unique<WorkerQueue>());
+
+        for (std::size_t i = 0; i < worker_count; i++)
+            workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    void JobSystem::shutdown() {
+        {
+            std::lock_guard lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_condition.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    void JobSystem::run(Job job, Counter* counter) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        push({ std::move(job), counter });
+    }
+
+    void JobSystem::run_after(Counter& dependency, Job job, Counter* counter) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard lock(dependency.continuation_mutex);
+            if (dependency.pending.load(std::memory_order_acquire) != 0) {
+                dependency.continuations.emplace_back(std::move(job), counter);
+                return;
+            }
+        }
+        push({ std::move(job), counter });
+    }
+
+    void JobSystem::wait(Counter& counter) {
+        std::pair<Job, Counter*> job;
+        while (!counter.is_done()) {
+            if (try_pop(job))
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+
+        // The last job to finish may still be releasing the counter's mutex, wait for it so the counter can be destroyed after returning
+        // Taking the exception out leaves the counter ready to be reused
+        std::exception_ptr exception;
+        {
+            std::lock_guard lock(counter.continuation_mutex);
+            exception = std::exchange(counter.first_exception, nullptr);
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+    void JobSystem::push(std::pair<Job, Counter*> job) {
+        // Workers push onto their own deque, everything else goes through the injection queue
+        WorkerQueue& queue = current_worker != NOT_A_WORKER ? *queues[current_worker] : *queues.back();
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+
+        queued_jobs.fetch_add(1, std::memory_order_release);
+        {
+            // Taking the lock makes sure a worker that just found no jobs is already waiting before it is notified
+            std::lock_guard lock(sleep_mutex);
+        }
+        sleep_condition.notify_one();
+    }
+
+    bool JobSystem::try_pop(std::pair<Job, Counter*>& job) {
+        if (queued_jobs.load(std::memory_order_acquire) == 0)
+            return false;
+
+        // Own deque first, newest job first since its data is most likely still in cache
+        if (current_worker != NOT_A_WORKER) {
+            WorkerQueue& own = *queues[current_worker];
+            std::lock_guard lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // Then steal the oldest job from the injection queue and the other workers, starting after ourselves to spread out contention
+        const std::size_t queue_count = queues.size();
+        const std::size_t start = current_worker != NOT_A_WORKER ? current_worker + 1 : queue_count - 1;
+        for (std::size_t offset = 0; offset < queue_count; offset++) {
+            const std::size_t victim = (start + offset) % queue_count;
+            if (victim == current_worker)
+                continue;
+
+            WorkerQueue& queue = *queues[victim];
+            std::lock_guard lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void JobSystem::execute(std::pair<Job, Counter*>& job) {
+        // A throwing job must still release its counter or its waiters and continuations would never run
+        try {
+            job.first();
+        } catch (...) {
+            if (job.second) {
+                std::lock_guard lock(job.second->continuation_mutex);
+                if (!job.second->first_exception)
+                    job.second->first_exception = std::current_exception();
+            } else {
+                std::cerr << "Error: A job without a counter threw an exception, nothing can wait on it so it was dropped\n";
+            }
+        }
+        job.first = nullptr;
+        if (job.second)
+            finish(*job.second);
+    }
+
+    void JobSystem::finish(Counter& counter) {
+        std::vector<std::pair<Job, Counter*>> ready;
+        {
+            std::lock_guard lock(counter.continuation_mutex);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter.continuations);
+        }
+
+        // The dependents' counters were incremented when they were submitted so they only need queueing
+        for (auto& continuation : ready)
+            push(std::move(continuation));
+    }
+
+    void JobSystem::worker_loop(std::size_t worker_index) {
+        current_worker = worker_index;
+
+        std::pair<Job, Counter*> job;
+        while (true) {
+            if (try_pop(job)) {
+                execute(job);
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex);
+            sleep_condition.wait(lock, [this] { return stopping || queued_jobs.load(std::memory_order_acquire) > 0; });
+            if (stopping && queued_jobs.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief The engine-wide job system, everything that wants to use more than one thread (the ECS, the loader, texture decoding) should share it instead of starting its own threads
+namespace jobs {
+    using Job = std::function<void()>;
+
+    /**
+     * @brief Tracks a group of jobs, it is incremented when a job is submitted with it and decremented once that job has finished
+     *
+     * Jobs can be made to wait on a counter with @ref JobSystem::run_after, and @ref JobSystem::wait blocks until a counter reaches zero
+     * If a job throws, the counter keeps the first exception and @ref JobSystem::wait rethrows it once every job has finished
+     * @warning A counter must outlive every job that was submitted with it
+     */
+    struct Counter {
+        std::atomic<std::uint32_t> pending = 0;
+
+        inline bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+
+        /// @brief Jobs submitted with @ref JobSystem::run_after that are waiting for this counter to reach zero
+        std::mutex continuation_mutex;
+        std::vector<std::pair<Job, Counter*>> continuations;
+        /// @brief The first exception thrown by a job submitted with this counter, guarded by @c continuation_mutex
+        std::exception_ptr first_exception;
+    };
+
+    /**
+     * @brief A work-stealing job system with one deque per worker thread
+     *
+     * Workers push and pop jobs at the back of their own deque and steal from the front of other workers' deques when theirs is empty,
+     * threads that are not workers (i.e. the main thread) submit into a shared injection queue
+     * Waiting on a @ref Counter never blocks idly, the waiting thread keeps running jobs until the counter reaches zero, so nested waits from inside jobs are fine
+     * @note With no workers (@c init never called or a single core machine) jobs are all run by whichever thread waits on them
+     */
+    class JobSystem {
+    public:
+        JobSystem() { queues.push_back(std::make_unique<WorkerQueue>()); }
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+        ~JobSystem() { shutdown(); }
+
+        /// @brief Starts the worker threads
+        /// @param worker_count The number of worker threads, by default one less than the number of hardware threads so the main thread keeps a core
+        void init(std::size_t worker_count = default_worker_count());
+        /// @brief Finishes the queued jobs and joins the worker threads
+        void shutdown();
+
+        /// @brief Queues a job
+        /// @param job The job to run
+        /// @param counter Optional counter that is incremented now and decremented once the job has finished
+        void run(Job job, Counter* counter = nullptr);
+
+        /// @brief Queues a job once @c dependency reaches zero, @c counter is incremented immediately so waiting on it also waits for the dependency
+        void run_after(Counter& dependency, Job job, Counter* counter = nullptr);
+
+        /// @brief Runs jobs on the calling thread until @c counter reaches zero
+        /// @throws The first exception thrown by a job submitted with @c counter, after every one of them has finished
+        void wait(Counter& counter);
+
+        /**
+         * @brief Splits @c [begin, end) into ranges of at most @c grain_size and runs @c function on each of them across the workers, returns once every range is done
+         *
+         * @param function Callable taking @c (std::size_t range_begin, std::size_t range_end)
+         * @throws The first exception thrown by @c function, after every range has finished
+         */
+        template <typename Function>
+        void parallel_for(std::size_t begin, std::size_t end, std::size_t grain_size, Function&& function) {
+            if (begin >= end)
+                return;
+            grain_size = std::max<std::size_t>(grain_size, 1);
+
+            // A single range isn't worth the hand-off
+            if (end - begin <= grain_size) {
+                function(begin, end);
+                return;
+            }
+
+            // The counter keeps the first exception a range throws and wait rethrows it
+            Counter counter;
+            for (std::size_t range_begin = begin; range_begin < end; range_begin += grain_size) {
+                const std::size_t range_end = std::min(range_begin + grain_size, end);
+                run([&function, range_begin, range_end] { function(range_begin, range_end); }, &counter);
+            }
+            wait(counter);
+        }
+
+        /// @brief The number of worker threads, not counting the main thread
+        inline std::size_t worker_count() const { return workers.size(); }
+
+        static std::size_t default_worker_count();
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<std::pair<Job, Counter*>> jobs;
+        };
+
+        std::vector<std::thread> workers;
+        /// @brief One queue per worker followed by the injection queue used by non-worker threads
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+        std::atomic<std::size_t> queued_jobs = 0;
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_condition;
+        bool stopping = false;
+
+        void push(std::pair<Job, Counter*> job);
+        bool try_pop(std::pair<Job, Counter*>& job);
+        void execute(std::pair<Job, Counter*>& job);
+        void finish(Counter& counter);
+        void worker_loop(std::size_t worker_index);
+    };
+
+    /// @brief The engine-wide @ref JobSystem singleton
+    inline JobSystem job_system;
+
+    /// @brief Forwards to @ref JobSystem::run
+    inline void run(Job job, Counter* counter = nullptr) { job_system.run(std::move(job), counter); }
+    /// @brief Forwards to @ref JobSystem::run_after
+    inline void run_after(Counter& dependency, Job job, Counter* counter = nullptr) { job_system.run_after(dependency, std::move(job), counter); }
+    /// @brief Forwards to @ref JobSystem::wait
+    inline void wait(Counter& counter) { job_system.wait(counter); }
+    /// @brief Forwards to @ref JobSystem::parallel_for
+    template <typename Function>
+    inline void parallel_for(std::size_t begin, std::size_t end, std::size_t grain_size, Function&& function) {
+        job_system.parallel_for(begin, end, grain_size, std::forward<Function>(function));
+    }
+}
@@ -5,6 +5,7 @@
 #include "mesh_rendering_shared.inl"
 
 #include "Core/ECS/ECS_Component.h"
+#include "Core/ECS/ECS_CommandBuffer.h"
 #include "Renderer/MeshManager.h"
 #include "Renderer/Renderer.h"
 
@@ -15,7 +16,7 @@ struct TextureData {
     daxa_SamplerId tex_sampler{};
 };
 
-class ManagedMesh : public IComponent {
+class ManagedMesh {
 public:
     std::weak_ptr<DrawableMesh> mesh;
 
@@ -45,18 +46,51 @@ public:
 
     void instantiate(Entity entity, ComponentManager<ManagedMesh>& componentManager, TextureData textures) {
         if (instanceNo == 0) {
-            int nextInstanceNo = numberOfInstances++;
+            int nextInstanceNo = static_cast<int>(mesh.lock()->instance_data.size());
             componentManager.addComponent(entity, ManagedMesh(nextInstanceNo, mesh.lock(), textures));
         } else std::cerr << "Warning: instantiate failed: only the first instance of a mesh can instantiate meshes\n";
     }
 
+    /// @brief Same as the other @c instantiate but records the new component in a @ref ecs::CommandBuffer, use this from inside systems
+    void instantiate(Entity entity, ecs::CommandBuffer& commandBuffer, TextureData textures) {
+        if (instanceNo == 0) {
+            int nextInstanceNo = static_cast<int>(mesh.lock()->instance_data.size());
+            commandBuffer.addComponent(entity, ManagedMesh(nextInstanceNo, mesh.lock(), textures));
+        } else std::cerr << "Warning: instantiate failed: only the first instance of a mesh can instantiate meshes\n";
+    }
+
+    /**
+     * @brief Called by @ref ComponentManager::addComponents, turns each copy of the prototype into a new instance of its mesh
+     *
+     * The instance data of every copy is appended to the mesh in one go, with the same texture as the prototype's instance
+     */
+    static void initializeBatch(std::span<ManagedMesh> components, std::span<const Entity> entities) {
+        auto sharedMesh = components.front().mesh.lock();
+        const meshRenderer::PerInstanceData prototypeData = components.front().getInstanceData();
+
+        const int firstInstanceNo = static_cast<int>(sharedMesh->instance_data.size());
+        sharedMesh->instance_data.resize(sharedMesh->instance_data.size() + components.size(), prototypeData);
+
+        for (std::size_t i = 0; i < components.size(); i++)
+            components[i].instanceNo = firstInstanceNo + static_cast<int>(i);
+    }
+
     [[nodiscard]] meshRenderer::PerInstanceData& getInstanceData() const {
         return mesh.lock()->instance_data[instanceNo];
     }
 
+    /// @brief The index of this instance inside its mesh's @c instance_data
+    [[nodiscard]] int getInstanceNo() const {
+        return instanceNo;
+    }
+
+    /// @brief Same as the other @c getInstanceData but takes the mesh the caller already locked, saving a @c weak_ptr::lock per call
+    [[nodiscard]] meshRenderer::PerInstanceData& getInstanceData(DrawableMesh& lockedMesh) const {
+        return lockedMesh.instance_data[instanceNo];
+    }
+
 private:
     int instanceNo = 0;    // If instance is 0 it is the actual mesh that is being instanced
-    int numberOfInstances = 1;
 
     glm::mat4 transform;
     TextureData textures;
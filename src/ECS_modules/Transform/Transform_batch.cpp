@@ -0,0 +1,221 @@
+#include "Transform_batch.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+    // The vector operations the kernel is written in, one struct per instruction set so the same kernel compiles to each of them
+
+    struct ScalarLanes {
+        using V = float;
+        static constexpr std::size_t WIDTH = 1;
+        static float load(const float* p) { return *p; }
+        static float gather(const float* p, const std::uint32_t* indices) { return p[*indices]; }
+        static void store(float* p, float v) { *p = v; }
+        static float set(float v) { return v; }
+        static float add(float a, float b) { return a + b; }
+        static float sub(float a, float b) { return a - b; }
+        static float mul(float a, float b) { return a * b; }
+
+        static void storeMatrices(const float elements[4][3], float* const* destinations) {
+            for (std::size_t column = 0; column < 4; column++) {
+                for (std::size_t row = 0; row < 3; row++)
+                    destinations[0][column * 4 + row] = elements[column][row];
+                destinations[0][column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+            }
+        }
+    };
+
+#ifdef TRANSFORM_BATCH_SSE
+    struct SseLanes {
+        using V = __m128;
+        static constexpr std::size_t WIDTH = 4;
+        static __m128 load(const float* p) { return _mm_loadu_ps(p); }
+        static __m128 gather(const float* p, const std::uint32_t* indices) { return _mm_setr_ps(p[indices[0]], p[indices[1]], p[indices[2]], p[indices[3]]); }
+        static void store(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+        static __m128 set(float v) { return _mm_set1_ps(v); }
+        static __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+        static __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+        static __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+
+        /// @brief Transposes one matrix column of 4 matrices from one vector per row to one vector per matrix and stores it
+        static void storeColumn(__m128 row0, __m128 row1, __m128 row2, std::size_t column, float* const* destinations) {
+            __m128 row3 = _mm_set1_ps(column == 3 ? 1.0f : 0.0f);
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_storeu_ps(destinations[0] + column * 4, row0);
+            _mm_storeu_ps(destinations[1] + column * 4, row1);
+            _mm_storeu_ps(destinations[2] + column * 4, row2);
+            _mm_storeu_ps(destinations[3] + column * 4, row3);
+        }
+
+        static void storeMatrices(const __m128 elements[4][3], float* const* destinations) {
+            for (std::size_t column = 0; column < 4; column++)
+                storeColumn(elements[column][0], elements[column][1], elements[column][2], column, destinations);
+        }
+    };
+#endif
+
+#ifdef __AVX2__
+    struct AvxLanes {
+        using V = __m256;
+        static constexpr std::size_t WIDTH = 8;
+        static __m256 load(const float* p) { return _mm256_loadu_ps(p); }
+        static __m256 gather(const float* p, const std::uint32_t* indices) {
+            return _mm256_i32gather_ps(p, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), sizeof(float));
+        }
+        static void store(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+        static __m256 set(float v) { return _mm256_set1_ps(v); }
+        static __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+        static __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+        static __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+
+        // Each half holds 4 matrices and is transposed like the SSE lanes do
+        static void storeMatrices(const __m256 elements[4][3], float* const* destinations) {
+            for (std::size_t column = 0; column < 4; column++) {
+                const __m256* rows = elements[column];
+                SseLanes::storeColumn(_mm256_castps256_ps128(rows[0]), _mm256_castps256_ps128(rows[1]), _mm256_castps256_ps128(rows[2]), column, destinations);
+                SseLanes::storeColumn(_mm256_extractf128_ps(rows[0], 1), _mm256_extractf128_ps(rows[1], 1), _mm256_extractf128_ps(rows[2], 1), column, destinations + 4);
+            }
+        }
+    };
+#endif
+
+    /// @brief Composes @c L::WIDTH matrices into the 12 non-constant elements, @c fetch reads one vector of a TRS column
+    template <typename L, typename Fetch>
+    void composeVector(const TRSColumns& trs, Fetch&& fetch, typename L::V elements[4][3]) {
+        using V = typename L::V;
+        const V one = L::set(1.0f);
+        const V two = L::set(2.0f);
+
+        const V x = fetch(trs.rotationX);
+        const V y = fetch(trs.rotationY);
+        const V z = fetch(trs.rotationZ);
+        const V w = fetch(trs.rotationW);
+
+        // Doubled once here so each rotation term below is a single multiply
+        const V x2 = L::mul(x, two);
+        const V y2 = L::mul(y, two);
+        const V z2 = L::mul(z, two);
+        const V xx = L::mul(x, x2), yy = L::mul(y, y2), zz = L::mul(z, z2);
+        const V xy = L::mul(x, y2), xz = L::mul(x, z2), yz = L::mul(y, z2);
+        const V wx = L::mul(w, x2), wy = L::mul(w, y2), wz = L::mul(w, z2);
+
+        const V scaleX = fetch(trs.scaleX);
+        const V scaleY = fetch(trs.scaleY);
+        const V scaleZ = fetch(trs.scaleZ);
+
+        elements[0][0] = L::mul(L::sub(one, L::add(yy, zz)), scaleX);
+        elements[0][1] = L::mul(L::add(xy, wz), scaleX);
+        elements[0][2] = L::mul(L::sub(xz, wy), scaleX);
+
+        elements[1][0] = L::mul(L::sub(xy, wz), scaleY);
+        elements[1][1] = L::mul(L::sub(one, L::add(xx, zz)), scaleY);
+        elements[1][2] = L::mul(L::add(yz, wx), scaleY);
+
+        elements[2][0] = L::mul(L::add(xz, wy), scaleZ);
+        elements[2][1] = L::mul(L::sub(yz, wx), scaleZ);
+        elements[2][2] = L::mul(L::sub(one, L::add(xx, yy)), scaleZ);
+
+        elements[3][0] = fetch(trs.positionX);
+        elements[3][1] = fetch(trs.positionY);
+        elements[3][2] = fetch(trs.positionZ);
+    }
+
+    /// @brief Composes matrices @c L::WIDTH at a time from @c first for as long as a whole vector fits
+    /// @return The index of the first matrix that wasn't composed
+    template <typename L>
+    std::size_t composeLanes(const TRSColumns& trs, const MatrixColumns& matrices, std::size_t first, std::size_t count) {
+        std::size_t i = first;
+        for (; i + L::WIDTH <= count; i += L::WIDTH) {
+            typename L::V elements[4][3];
+            composeVector<L>(trs, [i](const float* column) { return L::load(column + i); }, elements);
+
+            for (std::size_t column = 0; column < 4; column++)
+                for (std::size_t row = 0; row < 3; row++)
+                    L::store(matrices.elements[column][row] + i, elements[column][row]);
+        }
+        return i;
+    }
+
+    /// @brief Like @c composeLanes but reads the transforms at @c indices and writes whole matrices to @c destinations
+    template <typename L>
+    std::size_t composeLanesTo(const TRSColumns& trs, const std::uint32_t* indices, float* const* destinations, std::size_t first, std::size_t count) {
+        std::size_t i = first;
+        for (; i + L::WIDTH <= count; i += L::WIDTH) {
+            typename L::V elements[4][3];
+            if (indices)
+                composeVector<L>(trs, [&](const float* column) { return L::gather(column, indices + i); }, elements);
+            else
+                composeVector<L>(trs, [i](const float* column) { return L::load(column + i); }, elements);
+
+            // The destinations are usually far apart, so the lanes are transposed and each matrix is stored a whole column at a time
+            L::storeMatrices(elements, destinations + i);
+        }
+        return i;
+    }
+}
+
+void composeTransformMatrices(const TRSColumns& trs, const MatrixColumns& matrices, std::size_t count) {
+    std::size_t i = 0;
+#ifdef __AVX2__
+    i = composeLanes<AvxLanes>(trs, matrices, i, count);
+#endif
+#ifdef TRANSFORM_BATCH_SSE
+    i = composeLanes<SseLanes>(trs, matrices, i, count);
+#endif
+    composeLanes<ScalarLanes>(trs, matrices, i, count);
+}
+
+void composeTransformMatrices(const TRSColumns& trs, const std::uint32_t* indices, float* const* destinations, std::size_t count) {
+    std::size_t i = 0;
+#ifdef __AVX2__
+    i = composeLanesTo<AvxLanes>(trs, indices, destinations, i, count);
+#endif
+#ifdef TRANSFORM_BATCH_SSE
+    i = composeLanesTo<SseLanes>(trs, indices, destinations, i, count);
+#endif
+    composeLanesTo<ScalarLanes>(trs, indices, destinations, i, count);
+}
+
+TRSColumns trsColumnsOf(const SoAComponentManager<TransformTRS>& manager) {
+    return TRSColumns{
+        manager.column<&TransformTRS::positionX>(), manager.column<&TransformTRS::positionY>(), manager.column<&TransformTRS::positionZ>(),
+        manager.column<&TransformTRS::rotationX>(), manager.column<&TransformTRS::rotationY>(),
+        manager.column<&TransformTRS::rotationZ>(), manager.column<&TransformTRS::rotationW>(),
+        manager.column<&TransformTRS::scaleX>(), manager.column<&TransformTRS::scaleY>(), manager.column<&TransformTRS::scaleZ>(),
+    };
+}
+
+std::size_t TransformBatch::push(const TransformTRS& trs) {
+    if (count == capacity) {
+        // Whole vectors of SOA_COLUMN_ALIGNMENT bytes, like SoAComponentManager
+        constexpr std::size_t granularity = SOA_COLUMN_ALIGNMENT / sizeof(float);
+        const std::size_t grown = (std::max<std::size_t>(capacity * 2, granularity) + granularity - 1) / granularity * granularity;
+        for (SoAColumn<float>& column : inputs)
+            column.reserve(grown, count);
+        capacity = grown;
+    }
+
+    const float fields[TRS_FIELD_COUNT] = {
+        trs.positionX, trs.positionY, trs.positionZ,
+        trs.rotationX, trs.rotationY, trs.rotationZ, trs.rotationW,
+        trs.scaleX, trs.scaleY, trs.scaleZ,
+    };
+    for (std::size_t field = 0; field < TRS_FIELD_COUNT; field++)
+        inputs[field][count] = fields[field];
+    return count++;
+}
+
+void TransformBatch::compose(float* const* destinations) const {
+    const TRSColumns trs{
+        inputs[0].data(), inputs[1].data(), inputs[2].data(),
+        inputs[3].data(), inputs[4].data(), inputs[5].data(), inputs[6].data(),
+        inputs[7].data(), inputs[8].data(), inputs[9].data(),
+    };
+    composeTransformMatrices(trs, nullptr, destinations, count);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Core/ECS/ECS_SoA.h"
+#include "ECS_modules/Transform/Transform_trs.h"
+
+/// @brief The inputs of @ref composeTransformMatrices, one array per @ref TransformTRS field
+struct TRSColumns {
+    const float* positionX;
+    const float* positionY;
+    const float* positionZ;
+    const float* rotationX;
+    const float* rotationY;
+    const float* rotationZ;
+    const float* rotationW;
+    const float* scaleX;
+    const float* scaleY;
+    const float* scaleZ;
+};
+
+/// @brief The outputs of @ref composeTransformMatrices, one array per matrix element indexed @c [column][row]
+/// @note Only the first three rows are stored, the last row of a TRS matrix is always (0, 0, 0, 1)
+struct MatrixColumns {
+    float* elements[4][3];
+};
+
+/**
+ * @brief Composes @c count translation/rotation/scale triples into model matrices, the same as @c translate * @c toMat4(rotation) * @c scale with @c glm
+ *
+ * Runs 8 matrices per iteration with AVX2, 4 with SSE and finishes the remainder one at a time, whichever of them the build targets
+ * @note Rotations must be normalized quaternions
+ */
+void composeTransformMatrices(const TRSColumns& trs, const MatrixColumns& matrices, std::size_t count);
+
+/**
+ * @brief Composes the transforms at @c indices of the columns and writes each matrix straight to where it is used, e.g. a mesh's instance data
+ *
+ * Lets the @ref TransformSystem compose a scattered subset of the @ref SoAComponentManager "SoAComponentManager's" columns without copying them into a batch and the matrices back out
+ * @param indices The index of each transform in the columns, or @c nullptr for the first @c count transforms
+ * @param destinations Where each matrix is written, as 16 column-major floats like @c glm::mat4 and @c daxa_f32mat4x4
+ */
+void composeTransformMatrices(const TRSColumns& trs, const std::uint32_t* indices, float* const* destinations, std::size_t count);
+
+/// @brief The columns of every @ref TransformTRS in the manager, indexed by @ref SoAComponentManager::indexOf
+TRSColumns trsColumnsOf(const SoAComponentManager<TransformTRS>& manager);
+
+/**
+ * @brief Scratch structure-of-arrays storage for composing transforms that aren't in a @ref SoAComponentManager, like interpolated ones
+ *
+ * The columns are only ever grown, so a batch that is cleared and refilled every frame stops allocating once it has seen its largest frame
+ */
+class TransformBatch {
+public:
+    /// @brief Empties the batch, keeping its storage
+    void clear() { count = 0; }
+
+    /// @brief Appends a transform to the batch
+    /// @return The index of its matrix once the batch is composed
+    std::size_t push(const TransformTRS& trs);
+
+    /// @brief Composes the matrix of every transform pushed since the last @c clear, see @ref composeTransformMatrices
+    /// @param destinations Where each matrix is written, in the order they were pushed
+    void compose(float* const* destinations) const;
+
+    std::size_t size() const { return count; }
+
+private:
+    static constexpr std::size_t TRS_FIELD_COUNT = 10;
+
+    SoAColumn<float> inputs[TRS_FIELD_COUNT];
+    std::size_t count = 0;
+    std::size_t capacity = 0;
+};
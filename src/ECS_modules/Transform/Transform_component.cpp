@@ -2,59 +2,51 @@
 #include "core/ECS/ECS_Entity.h"
 
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
 
-TransformComponent::TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::vec3 eulerRotation, glm::vec3 scale)
-        :entityManager(std::ref(entityManager)),
-         transformSystem(std::ref(entityManager.getSystem<TransformSystem>())),
-         transformComponentManager(std::ref(entityManager.getComponentManager<TransformComponent>())),
+#include <iostream>
+
+TransformComponent::TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::vec3 eulerRotation, glm::vec3 scale, bool isStatic)
+        :transformComponentManager(&entityManager.getComponentManager<TransformComponent>()),
+         staticTransform(isStatic),
          position(position),
          eulerRotation(eulerRotation),
          scale(scale) {
     quaternionRotation  = glm::yawPitchRoll(eulerRotation.y, eulerRotation.x, eulerRotation.z);
-    glm::mat4 rotMat = glm::toMat4(quaternionRotation);
-    glm::mat4 transMat = glm::translate(glm::mat4(1.0f), position);
-    glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
-
-    modelMatrix = transMat * rotMat * scaleMat;
 }
 
-TransformComponent::TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::quat quaternionRotation, glm::vec3 scale)
-        :entityManager(std::ref(entityManager)),
-         transformSystem(std::ref(entityManager.getSystem<TransformSystem>())),
-         transformComponentManager(std::ref(entityManager.getComponentManager<TransformComponent>())),
-         position(),
+TransformComponent::TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::quat quaternionRotation, glm::vec3 scale, bool isStatic)
+        :transformComponentManager(&entityManager.getComponentManager<TransformComponent>()),
+         staticTransform(isStatic),
+         position(position),
          quaternionRotation(quaternionRotation),
          scale(scale) {
     eulerRotation = glm::eulerAngles(quaternionRotation);
-    glm::mat4 rotMat = glm::toMat4(quaternionRotation);
-    glm::mat4 transMat = glm::translate(glm::mat4(1.0f), position);
-    glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
-
-    modelMatrix = transMat * rotMat * scaleMat;
 }
 
-void TransformComponent::initialize(Entity initializedEntity) {
-    thisEntity = initializedEntity;
-    transformSystem.get().enqueueMessage(TransformUpdatedMessage{
-        .entity_id = thisEntity,
-        .model_matrix = modelMatrix,
-    });
+void TransformComponent::setModelMatrix(const glm::mat4& newModelMatrix) {
+    glm::vec3 skew;
+    glm::vec4 perspective;
+    glm::decompose(newModelMatrix, scale, quaternionRotation, position, skew, perspective);
+    quaternionDirty = false;
+    eulerDirty = true;
+    markChanged();
 }
 
-void TransformComponent::updateModelMatrix() {
-    if (quaternionDirty) {
-        quaternionRotation  = glm::yawPitchRoll(eulerRotation.y, eulerRotation.x, eulerRotation.z);
-        quaternionDirty = false;
-    }
-
-    glm::mat4 rotMat = glm::toMat4(quaternionRotation);
+glm::mat4 TransformComponent::getModelMatrix() const {
+    glm::mat4 rotMat = glm::toMat4(getQuaternionRotation());
     glm::mat4 transMat = glm::translate(glm::mat4(1.0f), position);
     glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
 
-    modelMatrix = transMat * rotMat * scaleMat;
+    return transMat * rotMat * scaleMat;
+}
+
+void TransformComponent::markChanged() {
+    if (staticTransform) {
+        std::cerr << "Warning: static transforms can't be moved, the change won't be rendered\n";
+        return;
+    }
 
-    transformSystem.get().enqueueMessage(TransformUpdatedMessage{
-        .entity_id = thisEntity,
-        .model_matrix = modelMatrix,
-    });
+    // The transform system finds the changed transforms through the change tick and composes their matrices in one batch
+    transformComponentManager->markChanged(*this);
 }
@@ -5,39 +5,43 @@
 
 #include <glm/gtx/euler_angles.hpp>
 
-class TransformComponent : public IComponent {
+/**
+ * @brief The position, rotation and scale of an entity
+ *
+ * Setters only store the new value and mark the component as changed, the @ref TransformSystem composes the model matrices of every changed transform in one batch per update
+ * so setting several properties in a frame costs nothing extra
+ *
+ * A static transform never moves after it is added, its matrix is baked once into the static region of its mesh's @ref DrawGroup and it is skipped by all per-frame transform work
+ * Static transforms have to be added, and the systems updated once, before @ref DrawGroup::uploadBuffers for the bake to end up in the static region, otherwise (or if they are part of a hierarchy) they are treated as dynamic
+ */
+class TransformComponent {
 public:
-    TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::vec3 eulerRotation, glm::vec3 scale);
-    TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::quat quaternionRotation, glm::vec3 scale);
-    void initialize(Entity initializedEntity) override;
+    TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::vec3 eulerRotation, glm::vec3 scale, bool isStatic = false);
+    TransformComponent(EntityManager& entityManager, glm::vec3 position, glm::quat quaternionRotation, glm::vec3 scale, bool isStatic = false);
 
     inline void setRotation(glm::vec3 newEulerRotation) {
         eulerRotation = newEulerRotation;
         quaternionDirty = true;
-        updateModelMatrix();
+        markChanged();
     }
 
     inline void setRotation(glm::quat newQuaternionRotation) {
         quaternionRotation = newQuaternionRotation;
         eulerDirty = true;
-        updateModelMatrix();
+        markChanged();
     }
 
-    inline void setModelMatrix(glm::mat4 newModelMatrix) {
-        modelMatrix = newModelMatrix;
-		quaternionDirty = true;
-		eulerDirty = true;
-        updateModelMatrix();
-    }
+    /// @brief Decomposes the matrix into a position, rotation and scale, any shear or perspective in it is lost
+    void setModelMatrix(const glm::mat4& newModelMatrix);
 
     inline void setPosition(glm::vec3 newPosition) {
         position = newPosition;
-        updateModelMatrix();
+        markChanged();
     }
 
     inline void setScale(glm::vec3 newSscale) {
         scale = newSscale;
-        updateModelMatrix();
+        markChanged();
     }
 
     inline glm::vec3 getEulerRotation() {
@@ -59,22 +63,32 @@ public:
         }
     }
 
+    /// @brief Read only version of @c getQuaternionRotation that doesn't cache the conversion
+    inline glm::quat getQuaternionRotation() const {
+        return quaternionDirty ? glm::quat(glm::yawPitchRoll(eulerRotation.y, eulerRotation.x, eulerRotation.z)) : quaternionRotation;
+    }
+
     inline glm::vec3 getPosition() const {return position;}
     inline glm::vec3 getScale() const {return scale;}
 
+    /// @brief Static transforms can't be moved, see the class description
+    inline bool isStatic() const {return staticTransform;}
+
+    /// @brief Composes the model matrix on the spot, the @ref TransformSystem composes the ones it uploads in batches instead
+    glm::mat4 getModelMatrix() const;
+
 private:
-    std::reference_wrapper<EntityManager> entityManager;
-    std::reference_wrapper<TransformSystem> transformSystem;
-    std::reference_wrapper<ComponentManager<TransformComponent>> transformComponentManager;
+    /// @brief Used to mark the component as changed, it finds its own entity from its address inside the manager
+    ComponentManager<TransformComponent>* transformComponentManager;
 
     bool eulerDirty = false;
     bool quaternionDirty = false;
+    bool staticTransform = false;
 
     glm::vec3 position;
     glm::vec3 eulerRotation;
     glm::quat quaternionRotation;
     glm::vec3 scale;
-    glm::mat4 modelMatrix;
 
-    void updateModelMatrix();
+    void markChanged();
 };
\ No newline at end of file
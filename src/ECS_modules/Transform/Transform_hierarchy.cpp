@@ -0,0 +1,143 @@
+#include "Transform_hierarchy.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+void TransformHierarchy::rebuild(std::span<const Link> links) {
+    for (Entity entity : nodeEntities)
+        nodeOfEntity[entityIndex(entity)] = NO_NODE;
+
+    // Number every entity that takes part in a link, children first so a child's id doesn't depend on its parent's
+    std::vector<Entity> entities;
+    entities.reserve(links.size() * 2);
+    auto idOf = [&](Entity entity) {
+        const std::uint32_t index = entityIndex(entity);
+        if (index >= nodeOfEntity.size())
+            nodeOfEntity.resize(std::max<std::size_t>(index + 1, nodeOfEntity.size() * 2), NO_NODE);
+        if (nodeOfEntity[index] == NO_NODE) {
+            nodeOfEntity[index] = static_cast<std::uint32_t>(entities.size());
+            entities.push_back(entity);
+        }
+        return nodeOfEntity[index];
+    };
+
+    std::vector<std::uint32_t> parents;
+    for (const Link& link : links) {
+        const std::uint32_t child = idOf(link.child);
+        const std::uint32_t parent = idOf(link.parent);
+        parents.resize(entities.size(), NO_NODE);
+        parents[child] = parent;
+    }
+    parents.resize(entities.size(), NO_NODE);
+
+    // Walk up from every entity until reaching one whose depth is known, then fill in the depths on the way back down
+    constexpr std::uint32_t UNKNOWN = UINT32_MAX;
+    std::vector<std::uint32_t> depths(entities.size(), UNKNOWN);
+    std::vector<std::uint32_t> rootIds(entities.size(), UNKNOWN);
+    std::vector<std::uint32_t> path;
+    // The walk that last visited each entity, reaching an entity the current walk already visited means the links loop
+    std::vector<std::uint32_t> visitedBy(entities.size(), UNKNOWN);
+    for (std::uint32_t start = 0; start < entities.size(); start++) {
+        path.clear();
+        std::uint32_t current = start;
+        while (depths[current] == UNKNOWN && parents[current] != NO_NODE) {
+            if (visitedBy[current] == start) {
+                // The first entity seen twice is on the loop even if the walk started outside it, so cutting its link breaks the loop
+                std::cerr << "Error: TransformParent links form a cycle, entity " << entities[current] << " is treated as a root\n";
+                parents[current] = NO_NODE;
+                path.erase(std::find(path.begin(), path.end(), current));
+                break;
+            }
+            visitedBy[current] = start;
+            path.push_back(current);
+            current = parents[current];
+        }
+
+        if (depths[current] == UNKNOWN) {
+            depths[current] = 0;
+            rootIds[current] = current;
+        }
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            depths[*it] = depths[parents[*it]] + 1;
+            rootIds[*it] = rootIds[parents[*it]];
+        }
+    }
+
+    std::vector<std::uint32_t> order(entities.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+        if (rootIds[a] != rootIds[b])
+            return rootIds[a] < rootIds[b];
+        if (depths[a] != depths[b])
+            return depths[a] < depths[b];
+        return a < b;
+    });
+
+    const std::size_t nodeCount = entities.size();
+    nodeEntities.resize(nodeCount);
+    parentNodes.resize(nodeCount);
+    rootOfNode.resize(nodeCount);
+    localMatrices.assign(nodeCount, glm::mat4(1.0f));
+    worldMatrices.assign(nodeCount, glm::mat4(1.0f));
+    dirtyNodes.assign(nodeCount, true);
+    roots.clear();
+
+    for (std::uint32_t node = 0; node < nodeCount; node++) {
+        const std::uint32_t id = order[node];
+        nodeEntities[node] = entities[id];
+        nodeOfEntity[entityIndex(entities[id])] = node;
+
+        if (roots.empty() || rootIds[order[roots.back().begin]] != rootIds[id])
+            roots.push_back({ node, node });
+        roots.back().end = node + 1;
+        rootOfNode[node] = static_cast<std::uint32_t>(roots.size() - 1);
+    }
+    // Parents are remapped once every entity has its final node
+    for (std::uint32_t node = 0; node < nodeCount; node++) {
+        const std::uint32_t parent = parents[order[node]];
+        parentNodes[node] = parent == NO_NODE ? NO_NODE : nodeOfEntity[entityIndex(entities[parent])];
+    }
+
+    rootIsDirty.assign(roots.size(), true);
+    dirtyRoots.resize(roots.size());
+    std::iota(dirtyRoots.begin(), dirtyRoots.end(), 0);
+}
+
+bool TransformHierarchy::setLocalMatrix(Entity entity, const glm::mat4& localMatrix) {
+    const std::uint32_t node = findNode(entity);
+    if (node == NO_NODE)
+        return false;
+
+    localMatrices[node] = localMatrix;
+    dirtyNodes[node] = true;
+
+    const std::uint32_t root = rootOfNode[node];
+    if (!rootIsDirty[root]) {
+        rootIsDirty[root] = true;
+        dirtyRoots.push_back(root);
+    }
+    return true;
+}
+
+void TransformHierarchy::sweepDirtyRoots() {
+    jobs::parallel_for(0, dirtyRoots.size(), ROOTS_PER_JOB, [this](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const RootRange range = roots[dirtyRoots[i]];
+            // Parents come before their children, so by the time a node is reached its parent's world matrix and dirty flag are final
+            for (std::uint32_t node = range.begin; node < range.end; node++) {
+                const std::uint32_t parent = parentNodes[node];
+                if (parent == NO_NODE) {
+                    if (dirtyNodes[node])
+                        worldMatrices[node] = localMatrices[node];
+                    continue;
+                }
+
+                if (dirtyNodes[parent])
+                    dirtyNodes[node] = true;
+                if (dirtyNodes[node])
+                    worldMatrices[node] = worldMatrices[parent] * localMatrices[node];
+            }
+        }
+    });
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Core/ECS/ECS_Types.h"
+#include "Core/JobSystem.h"
+
+/**
+ * @brief Makes an entity's @ref TransformComponent relative to the transform of @c parent
+ *
+ * Both entities need a @ref TransformComponent, an entity whose parent is destroyed or has no @ref TransformComponent is treated as a root
+ * @note The @ref TransformSystem rebuilds its @ref TransformHierarchy whenever any of these are added, changed or removed, so reparenting is meant to be occasional
+ */
+struct TransformParent {
+    Entity parent = INVALID_ENTITY;
+};
+
+/**
+ * @brief The entities that are part of a transform hierarchy flattened into arrays sorted by root and then by depth
+ *
+ * Each root's subtree is one contiguous range in which a parent always comes before its children, so world matrices are computed in one linear sweep without recursion or pointer chasing
+ * Only the subtrees that have a changed local matrix are swept, and separate roots are swept in parallel on the @ref jobs::JobSystem
+ * Entities that aren't in a hierarchy shouldn't be added, their local matrix already is their world matrix
+ */
+class TransformHierarchy {
+public:
+    /// @brief A child and its parent, the input of @c rebuild
+    struct Link {
+        Entity child;
+        Entity parent;
+    };
+
+    /**
+     * @brief Rebuilds the hierarchy from every parent link, the local matrices of every entity need setting again afterwards
+     *
+     * Links that form a cycle are broken at one entity on the cycle, whose link is ignored so it becomes a root, entities that only lead into the cycle keep their links
+     */
+    void rebuild(std::span<const Link> links);
+
+    /// @brief Checks if the entity is part of the hierarchy
+    bool contains(Entity entity) const {
+        return findNode(entity) != NO_NODE;
+    }
+
+    /// @brief Sets the entity's matrix relative to its parent and marks its subtree for the next @c propagate
+    /// @return @c false if the entity isn't part of the hierarchy
+    bool setLocalMatrix(Entity entity, const glm::mat4& localMatrix);
+
+    /**
+     * @brief Recomputes the world matrices of every subtree with a changed local matrix
+     * @param function Callable taking @c (Entity, const glm::mat4& worldMatrix), called on the calling thread for every entity whose world matrix was recomputed
+     */
+    template <typename Function>
+    void propagate(Function&& function) {
+        if (dirtyRoots.empty())
+            return;
+
+        sweepDirtyRoots();
+        for (std::uint32_t root : dirtyRoots) {
+            for (std::uint32_t node = roots[root].begin; node < roots[root].end; node++) {
+                if (!dirtyNodes[node])
+                    continue;
+                dirtyNodes[node] = false;
+                function(nodeEntities[node], worldMatrices[node]);
+            }
+            rootIsDirty[root] = false;
+        }
+        dirtyRoots.clear();
+    }
+
+    /// @brief Every entity in the hierarchy, roots first within each subtree
+    std::span<const Entity> entities() const {
+        return nodeEntities;
+    }
+
+private:
+    static constexpr std::uint32_t NO_NODE = UINT32_MAX;
+    /// @brief Roots swept per job, subtrees are usually small so one job per root would mostly be overhead
+    static constexpr std::size_t ROOTS_PER_JOB = 16;
+
+    /// @brief A root's subtree, the nodes @c [begin, end)
+    struct RootRange {
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    // One entry per node, in sweep order
+    std::vector<Entity> nodeEntities;
+    std::vector<std::uint32_t> parentNodes;
+    std::vector<std::uint32_t> rootOfNode;
+    std::vector<glm::mat4> localMatrices;
+    std::vector<glm::mat4> worldMatrices;
+    /// @brief @c char rather than @c bool so roots swept on different threads never share a byte
+    std::vector<char> dirtyNodes;
+
+    std::vector<RootRange> roots;
+    std::vector<char> rootIsDirty;
+    std::vector<std::uint32_t> dirtyRoots;
+
+    /// @brief The node of each entity, indexed by entity index
+    std::vector<std::uint32_t> nodeOfEntity;
+
+    std::uint32_t findNode(Entity entity) const {
+        const std::uint32_t index = entityIndex(entity);
+        if (index >= nodeOfEntity.size())
+            return NO_NODE;
+        const std::uint32_t node = nodeOfEntity[index];
+        return node != NO_NODE && nodeEntities[node] == entity ? node : NO_NODE;
+    }
+
+    void sweepDirtyRoots();
+};
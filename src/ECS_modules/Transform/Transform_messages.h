@@ -8,6 +8,8 @@
 #include <glm/gtx/quaternion.hpp>
 #include <variant>
 
+/// @brief Overrides the model matrix of an entity's mesh instance, for producers that don't own a @ref TransformComponent
+/// @note Changes made through a @ref TransformComponent don't need a message, the @ref TransformSystem picks them up from its change ticks
 struct TransformUpdatedMessage {
     Entity entity_id;
     glm::mat4 model_matrix;
@@ -0,0 +1,230 @@
+#include "Transform_system.h"
+#include "Transform_component.h"
+
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/gtc/type_ptr.hpp>
+
+void TransformSystem::syncChangedTransforms() {
+    const ChangeTick syncTick = advanceChangeTick();
+
+    updateHierarchy();
+
+    // What was current at the last tick is what this tick interpolates from
+    for (InterpolatedTransform& interpolated : interpolatedTransforms)
+        interpolated.previous = interpolated.current;
+
+    if (std::as_const(ecs::getComponentManager<TransformComponent>()).changedSince(lastSyncTick)) {
+        auto& trsManager = ecs::getComponentManager<TransformTRS>();
+        gatheredTransforms.clear();
+        composeIndices.clear();
+        transformBatch.clear();
+        batchedTransforms.clear();
+
+        for (auto [entity, transform] : ecs::view<const TransformComponent>().changedSince<TransformComponent>(lastSyncTick)) {
+            const glm::vec3 position = transform.getPosition();
+            const glm::quat rotation = transform.getQuaternionRotation();
+            const glm::vec3 scale = transform.getScale();
+            const TransformTRS trs{
+                .positionX = position.x, .positionY = position.y, .positionZ = position.z,
+                .rotationX = rotation.x, .rotationY = rotation.y, .rotationZ = rotation.z, .rotationW = rotation.w,
+                .scaleX = scale.x, .scaleY = scale.y, .scaleZ = scale.z,
+            };
+
+            // Static transforms are baked and hierarchy members need their local matrix straight away, everything else is composed per rendered frame by interpolateTransforms
+            const bool composeNow = transform.isStatic() || hierarchy.contains(entity);
+            if (!composeNow) {
+                const std::optional<TransformTRS> previous = trsManager.getComponent(entity);
+                setInterpolationTarget(entity, previous.value_or(trs), trs);
+            }
+
+            // Adding a component mid-update is a structural change, only transforms seen for the first time wait for the command buffer's playback
+            if (trsManager.setComponent(entity, trs)) {
+                if (composeNow) {
+                    gatheredTransforms.push_back({ entity, transform.isStatic() });
+                    composeIndices.push_back(trsManager.indexOf(entity));
+                }
+            } else {
+                ecs::commandBuffer.addComponent(entity, TransformTRS(trs));
+                if (composeNow) {
+                    transformBatch.push(trs);
+                    batchedTransforms.push_back({ entity, transform.isStatic() });
+                }
+            }
+        }
+
+        const std::size_t gatheredCount = gatheredTransforms.size();
+        composedMatrices.resize(gatheredCount + batchedTransforms.size());
+        matrixDestinations.clear();
+        for (glm::mat4& matrix : composedMatrices)
+            matrixDestinations.push_back(glm::value_ptr(matrix));
+        composeTransformMatrices(trsColumnsOf(trsManager), composeIndices.data(), matrixDestinations.data(), gatheredCount);
+        transformBatch.compose(matrixDestinations.data() + gatheredCount);
+
+        // Queued after the messages so a changed component wins over a message sent in the same update
+        auto applyMatrix = [&](const ComposedTransform& composed, const glm::mat4& modelMatrix) {
+            if (!hierarchy.setLocalMatrix(composed.entity, modelMatrix))
+                queueModelMatrix(composed.entity, to_daxa(modelMatrix), composed.isStatic);
+        };
+        for (std::size_t i = 0; i < gatheredCount; i++)
+            applyMatrix(gatheredTransforms[i], composedMatrices[i]);
+        for (std::size_t i = 0; i < batchedTransforms.size(); i++)
+            applyMatrix(batchedTransforms[i], composedMatrices[gatheredCount + i]);
+    }
+
+    hierarchy.propagate([&](Entity entity, const glm::mat4& worldMatrix) {
+        queueModelMatrix(entity, to_daxa(worldMatrix));
+    });
+
+    lastSyncTick = syncTick;
+}
+
+void TransformSystem::setInterpolationTarget(Entity entity, const TransformTRS& previous, const TransformTRS& current) {
+    const std::uint32_t index = entityIndex(entity);
+    if (index >= interpolationSlots.size())
+        interpolationSlots.resize(std::max<std::size_t>(index + 1, interpolationSlots.size() * 2), NO_INTERPOLATION_SLOT);
+
+    std::uint32_t& slot = interpolationSlots[index];
+    if (slot == NO_INTERPOLATION_SLOT) {
+        slot = static_cast<std::uint32_t>(interpolatedTransforms.size());
+        interpolatedTransforms.push_back({ entity, previous, current });
+    } else if (interpolatedTransforms[slot].entity == entity) {
+        // Already moving, it keeps interpolating from where the last tick left it
+        interpolatedTransforms[slot].current = current;
+    } else {
+        // The slot belongs to a destroyed entity that had the same index
+        interpolatedTransforms[slot] = { entity, previous, current };
+    }
+}
+
+void TransformSystem::stopInterpolating(Entity entity) {
+    const std::uint32_t index = entityIndex(entity);
+    if (index >= interpolationSlots.size() || interpolationSlots[index] == NO_INTERPOLATION_SLOT)
+        return;
+
+    const std::uint32_t slot = interpolationSlots[index];
+    if (interpolatedTransforms[slot].entity != entity)
+        return;
+
+    interpolatedTransforms[slot] = interpolatedTransforms.back();
+    interpolationSlots[entityIndex(interpolatedTransforms[slot].entity)] = slot;
+    interpolatedTransforms.pop_back();
+    interpolationSlots[index] = NO_INTERPOLATION_SLOT;
+}
+
+void TransformSystem::interpolateTransforms(float alpha) {
+    if (interpolatedTransforms.empty())
+        return;
+
+    // Messages and the last tick's matrices go first so the interpolated matrices written over them below win
+    applyPendingMatrices();
+
+    // The destinations are found before composing so the kernel writes every matrix straight into its mesh's instance data
+    transformBatch.clear();
+    matrixDestinations.clear();
+    interpolatedInstances.clear();
+    for (const InterpolatedTransform& interpolated : interpolatedTransforms) {
+        ManagedMesh* meshComponent = meshComponentManager.getComponent(interpolated.entity);
+        if (!meshComponent)
+            continue;
+
+        // No systems run during interpolation so the meshes stay alive until the end of it without holding a reference
+        auto sharedMesh = meshComponent->mesh.lock();
+        if (!sharedMesh)
+            continue;
+
+        transformBatch.push(interpolateTRS(interpolated.previous, interpolated.current, alpha));
+        matrixDestinations.push_back(reinterpret_cast<float*>(&meshComponent->getInstanceData(*sharedMesh).model_matrix));
+        interpolatedInstances.push_back({ sharedMesh.get(), static_cast<std::uint32_t>(meshComponent->getInstanceNo()) });
+    }
+    transformBatch.compose(matrixDestinations.data());
+
+    for (const InstanceRef& instance : interpolatedInstances)
+        renderer.drawGroups[instance.mesh->drawGroupIndex].update_instances(*instance.mesh, instance.instanceNo, 1);
+
+    // Transforms that didn't move last tick have just been drawn at rest, they don't need interpolating again until they move
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < interpolatedTransforms.size(); i++) {
+        const InterpolatedTransform& interpolated = interpolatedTransforms[i];
+        const std::uint32_t index = entityIndex(interpolated.entity);
+        if (std::memcmp(&interpolated.previous, &interpolated.current, sizeof(TransformTRS)) == 0) {
+            interpolationSlots[index] = NO_INTERPOLATION_SLOT;
+            continue;
+        }
+        interpolationSlots[index] = static_cast<std::uint32_t>(kept);
+        interpolatedTransforms[kept++] = interpolated;
+    }
+    interpolatedTransforms.resize(kept);
+}
+
+void TransformSystem::updateHierarchy() {
+    const auto& parentManager = std::as_const(ecs::getComponentManager<TransformParent>());
+    const auto& transformManager = std::as_const(ecs::getComponentManager<TransformComponent>());
+
+    // Additions and changes stamp a tick, removals only show up in the counts
+    const bool structureChanged = parentManager.changedSince(lastSyncTick)
+        || parentManager.size() != hierarchyParentCount
+        || (hierarchyParentCount > 0 && transformManager.size() != hierarchyTransformCount);
+    if (!structureChanged)
+        return;
+
+    std::vector<TransformHierarchy::Link> links;
+    links.reserve(parentManager.size());
+    for (auto [entity, transformParent] : ecs::view<const TransformParent>()) {
+        if (transformManager.contains(entity) && ecs::isAlive(transformParent.parent) && transformManager.contains(transformParent.parent))
+            links.push_back({ entity, transformParent.parent });
+    }
+    const std::vector<Entity> previousEntities(hierarchy.entities().begin(), hierarchy.entities().end());
+    hierarchy.rebuild(links);
+
+    // Every node starts out dirty, its local matrix is the one its component has now
+    for (Entity entity : hierarchy.entities()) {
+        hierarchy.setLocalMatrix(entity, transformManager.getComponent(entity)->getModelMatrix());
+        // Its world matrix comes from the hierarchy now
+        stopInterpolating(entity);
+    }
+
+    // Entities that left the hierarchy still have their old world matrix, their local matrix is their world matrix now
+    for (Entity entity : previousEntities) {
+        if (!hierarchy.contains(entity) && transformManager.contains(entity))
+            queueModelMatrix(entity, to_daxa(transformManager.getComponent(entity)->getModelMatrix()));
+    }
+
+    hierarchyParentCount = parentManager.size();
+    hierarchyTransformCount = transformManager.size();
+}
+
+void TransformSystem::applyPendingMatrices() {
+    if (pendingMatrices.empty())
+        return;
+
+    // Entity order walks the mesh manager's sparse pages in order and groups instances of the same mesh
+    std::sort(pendingMatrices.begin(), pendingMatrices.end(), [](const PendingMatrix& a, const PendingMatrix& b) { return a.entity < b.entity; });
+
+    for (const PendingMatrix& pending : pendingMatrices) {
+        const std::uint32_t index = entityIndex(pending.entity);
+        pendingBits[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+
+        ManagedMesh* meshComponent = meshComponentManager.getComponent(pending.entity);
+        if (!meshComponent)
+            continue;
+
+        auto sharedMesh = meshComponent->mesh.lock();
+        if (!sharedMesh)
+            continue;
+
+        const auto instanceNo = static_cast<std::uint32_t>(meshComponent->getInstanceNo());
+        meshComponent->getInstanceData(*sharedMesh).model_matrix = pending.modelMatrix;
+
+        // Instances can only join the static region before their draw group is uploaded, after that it is baked
+        if (pending.isStatic && instanceNo >= sharedMesh->instance_data_offsets.size()) {
+            sharedMesh->set_instance_static(instanceNo, true);
+            continue;
+        }
+        renderer.drawGroups[sharedMesh->drawGroupIndex].update_instances(*sharedMesh, instanceNo, 1);
+    }
+    pendingMatrices.clear();
+}
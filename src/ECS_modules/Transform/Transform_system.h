@@ -1,61 +1,183 @@
 #pragma once
 
-#include <queue>
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
 #include <variant>
+#include <vector>
 
+#include "ECS_modules/Transform/Transform_batch.h"
+#include "ECS_modules/Transform/Transform_hierarchy.h"
 #include "ECS_modules/Transform/Transform_messages.h"
+#include "ECS_modules/Transform/Transform_trs.h"
 
 #include "ECS_modules/Managed_mesh/ManagedMesh.h"
 
+class TransformComponent;
+
 class TransformSystem : public ISystem {
 public:
-    TransformSystem(daxa::Device& device, Renderer& renderer, ComponentManager<ManagedMesh>& meshComponentManager)
-        : device(device), renderer(renderer), meshComponentManager(meshComponentManager) {}
+    TransformSystem(Renderer& renderer, ComponentManager<ManagedMesh>& meshComponentManager)
+        : renderer(renderer), meshComponentManager(meshComponentManager) {}
 
     inline void update() {
         processMessages();
-        updatePerInstanceData();
+        syncChangedTransforms();
+        applyPendingMatrices();
+    }
+
+    /// @brief Changed @ref TransformComponent "TransformComponents" and transform messages are written into the @ref ManagedMesh instance data and the @ref TransformTRS mirror
+    SystemAccess getAccess() const override {
+        return SystemAccess().read<TransformComponent, TransformParent>().write<ManagedMesh, TransformTRS>();
     }
 
-   inline void enqueueMessage(const TransformMessage& message) {
-        unprocessedMessages = true;
-        transformMessages.push(message);
+    /// @brief Sends a message to the system, safe to call from any thread
+    /// @return @c false if more than @ref MESSAGE_CAPACITY messages were sent since the last update, the message is dropped and reported then
+    inline bool enqueueMessage(const TransformMessage& message) {
+        if (transformMessages.push(message))
+            return true;
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
 
-    void processMessages() {;
-        while (!transformMessages.empty()) {
-            const auto& message = transformMessages.front();
+    /// @brief Drains the message channel, only the last matrix sent to each entity is kept
+    void processMessages() {
+        if (const std::size_t dropped = droppedMessages.exchange(0, std::memory_order_relaxed))
+            std::cerr << "Error: Dropped " << dropped << " transform messages, the channel filled up before the update\n";
+
+        transformMessages.drain([&](const TransformMessage& message) {
             std::visit(
-                [&](auto&& TransformUpdatedMessage) {
-                    auto meshComponent = meshComponentManager.getComponent(TransformUpdatedMessage.entity_id);
-                    auto sharedMeshPointer = meshComponent->mesh.lock();
-
-                    meshComponent->getInstanceData().model_matrix = to_daxa(TransformUpdatedMessage.model_matrix);
-                    if (meshComponent && !meshesToUpdate.contains(sharedMeshPointer)) {
-                        meshesToUpdate.insert(sharedMeshPointer);
-                    }
+                [&](auto&& transformMessage) {
+                    using MessageType = std::decay_t<decltype(transformMessage)>;
+                    if constexpr (std::is_same_v<MessageType, TransformUpdatedMessage>)
+                        queueModelMatrix(transformMessage.entity_id, to_daxa(transformMessage.model_matrix));
                 }
             , message);
-            transformMessages.pop();
-        }
+        });
     }
 
-    inline void updatePerInstanceData() {
-        for (auto& mesh : meshesToUpdate) {
-            auto* ptr = device.buffer_host_address_as<meshRenderer::PerInstanceData>(renderer.drawGroups[mesh->drawGroupIndex].instance_buffer_id).value();
-            memcpy(ptr + mesh->instance_offset, mesh->instance_data.data(), mesh->instance_data.size() * sizeof(meshRenderer::PerInstanceData));
+    /**
+     * @brief Copies every @ref TransformComponent that changed since the last update into its @ref TransformTRS and composes the matrices of the static and hierarchy ones in one SIMD pass
+     *
+     * The pass reads the @ref TransformTRS columns at the changed entities' indices, only transforms seen for the first time are composed from a @ref TransformBatch
+     *
+     * The matrices of entities in a hierarchy are local, they are handed to the @ref TransformHierarchy which recomputes the world matrices of their subtrees
+     * @note Costs a few comparisons when no transform or parent has changed, so static scenes are free
+     * @note The @ref TransformTRS of a transform seen for the first time is recorded into @ref ecs::commandBuffer, it exists after the playback at the end of the update
+     */
+    void syncChangedTransforms();
+
+    /**
+     * @brief Composes the matrices of every moving transform between the state of the last two simulation ticks and writes them straight into their meshes' instance data
+     *
+     * Call once per rendered frame after the simulation ticks for it have run, @c alpha is how far the frame is between the previous tick (0) and the latest one (1)
+     * Only transforms that moved during the last tick are interpolated, static transforms, hierarchy members and transform messages snap to their latest value on each tick
+     * @warning Must only be called while no systems are running, like @ref ecs::CommandBuffer::playback
+     */
+    void interpolateTransforms(float alpha);
+
+    /// @brief Writes the one pending model matrix of every entity that moved this update into its mesh's instance data and marks the instance for upload in its @ref DrawGroup
+    void applyPendingMatrices();
+private:
+    /// @brief The tick of the last @ref syncChangedTransforms, transforms stamped after it still need copying
+    ChangeTick lastSyncTick = 0;
+    /// @brief A static or hierarchy transform composed by @ref syncChangedTransforms
+    struct ComposedTransform {
+        Entity entity;
+        bool isStatic;
+    };
+
+    // Scratch storage for composing, kept between updates so it doesn't reallocate
+    /// @brief Transforms whose @ref TransformTRS exists, composed straight from its columns at @c composeIndices
+    std::vector<ComposedTransform> gatheredTransforms;
+    std::vector<std::uint32_t> composeIndices;
+    /// @brief Transforms seen for the first time and interpolated ones, which aren't in the @ref TransformTRS columns
+    TransformBatch transformBatch;
+    std::vector<ComposedTransform> batchedTransforms;
+    std::vector<glm::mat4> composedMatrices;
+    std::vector<float*> matrixDestinations;
+
+    /// @brief The mesh instance each interpolated matrix was written into, marked for upload once they are all composed
+    struct InstanceRef {
+        DrawableMesh* mesh;
+        std::uint32_t instanceNo;
+    };
+    std::vector<InstanceRef> interpolatedInstances;
+
+    static constexpr std::uint32_t NO_INTERPOLATION_SLOT = UINT32_MAX;
+
+    /// @brief A transform that moved during the last simulation tick, drawn between where it was and where it is now
+    struct InterpolatedTransform {
+        Entity entity;
+        TransformTRS previous;
+        TransformTRS current;
+    };
+
+    std::vector<InterpolatedTransform> interpolatedTransforms;
+    /// @brief The entity's position in @c interpolatedTransforms, indexed by entity index
+    std::vector<std::uint32_t> interpolationSlots;
+
+    /// @brief Starts interpolating the entity from @c previous or, if it is already moving, retargets it to @c current
+    void setInterpolationTarget(Entity entity, const TransformTRS& previous, const TransformTRS& current);
+    void stopInterpolating(Entity entity);
+
+    TransformHierarchy hierarchy;
+    /// @brief Component counts the hierarchy was built from, removing components doesn't stamp a change tick so a count going down is how removals are noticed
+    std::size_t hierarchyParentCount = 0;
+    std::size_t hierarchyTransformCount = 0;
+
+    /// @brief Rebuilds @c hierarchy if any @ref TransformParent or @ref TransformComponent was added, changed or removed since the last update
+    void updateHierarchy();
+
+    struct PendingMatrix {
+        Entity entity;
+        daxa_f32mat4x4 modelMatrix;
+        /// @brief Bake the matrix into the static region of the mesh's @ref DrawGroup
+        bool isStatic;
+    };
+
+    /// @brief The latest model matrix of every entity that moved this update, each entity appears once
+    std::vector<PendingMatrix> pendingMatrices;
+    /// @brief One bit per entity index, set while the entity has an entry in @c pendingMatrices
+    std::vector<std::uint64_t> pendingBits;
+    /// @brief The entity's position in @c pendingMatrices, indexed by entity index and only valid while its bit is set
+    std::vector<std::uint32_t> pendingSlots;
+
+    /// @brief Records the entity's new model matrix, replacing the one recorded earlier in the same update if there is one
+    inline void queueModelMatrix(Entity entity, const daxa_f32mat4x4& modelMatrix, bool isStatic = false) {
+        const std::uint32_t index = entityIndex(entity);
+        if (index >= pendingSlots.size()) {
+            pendingSlots.resize(std::max<std::size_t>(index + 1, pendingSlots.size() * 2));
+            pendingBits.resize((pendingSlots.size() + 63) / 64);
+        }
+
+        std::uint64_t& bits = pendingBits[index / 64];
+        const std::uint64_t bit = std::uint64_t(1) << (index % 64);
+        if (bits & bit) {
+            pendingMatrices[pendingSlots[index]] = { entity, modelMatrix, isStatic };
+            return;
         }
-        meshesToUpdate.clear();
+
+        bits |= bit;
+        pendingSlots[index] = static_cast<std::uint32_t>(pendingMatrices.size());
+        pendingMatrices.push_back({ entity, modelMatrix, isStatic });
     }
-private:
-    bool unprocessedMessages = false;
 
-    daxa::Device& device;
     Renderer& renderer;
 
     ComponentManager<ManagedMesh>& meshComponentManager;
 
-    std::queue<TransformMessage> transformMessages;
-    std::unordered_set<std::shared_ptr<DrawableMesh>> meshesToUpdate;
+    /**
+     * @brief The most transform messages that can be sent between two updates
+     *
+     * Messages override whole mesh instances, so this is sized for every instance a large scene could override in one frame,
+     * dropping is safer than waiting because producers may be systems the @ref TransformSystem runs after
+     */
+    static constexpr std::size_t MESSAGE_CAPACITY = 16384;
+
+    MessageChannel<TransformMessage, MESSAGE_CAPACITY> transformMessages;
+    std::atomic<std::size_t> droppedMessages = 0;
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+
+#include "Core/ECS/ECS_SoA.h"
+
+/**
+ * @brief The translation, rotation and scale of an entity as plain floats, stored structure-of-arrays so transforms can be processed in SIMD batches
+ *
+ * The @ref TransformSystem keeps one for every entity with a @ref TransformComponent, updated whenever the @ref TransformComponent changes
+ * Systems that only need positions (culling, physics broadphase, etc.) should read the columns of the @ref SoAComponentManager rather than walking the @ref TransformComponent "TransformComponents"
+ * @note The rotation is a quaternion
+ */
+struct TransformTRS {
+    float positionX, positionY, positionZ;
+    float rotationX, rotationY, rotationZ, rotationW;
+    float scaleX, scaleY, scaleZ;
+};
+
+template <>
+struct ComponentFields<TransformTRS> {
+    static constexpr auto fields = std::make_tuple(
+        &TransformTRS::positionX, &TransformTRS::positionY, &TransformTRS::positionZ,
+        &TransformTRS::rotationX, &TransformTRS::rotationY, &TransformTRS::rotationZ, &TransformTRS::rotationW,
+        &TransformTRS::scaleX, &TransformTRS::scaleY, &TransformTRS::scaleZ
+    );
+};
+
+/// @brief Blends two transforms, @c t = 0 gives @c a and @c t = 1 gives @c b, the rotation is normalized-lerped along the shortest arc
+inline TransformTRS interpolateTRS(const TransformTRS& a, const TransformTRS& b, float t) {
+    auto lerp = [t](float from, float to) { return from + (to - from) * t; };
+
+    // q and -q are the same rotation, flip b onto a's hemisphere so the blend doesn't go the long way round
+    const float dot = a.rotationX * b.rotationX + a.rotationY * b.rotationY + a.rotationZ * b.rotationZ + a.rotationW * b.rotationW;
+    const float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+    float x = lerp(a.rotationX, b.rotationX * sign);
+    float y = lerp(a.rotationY, b.rotationY * sign);
+    float z = lerp(a.rotationZ, b.rotationZ * sign);
+    float w = lerp(a.rotationW, b.rotationW * sign);
+    const float length = std::sqrt(x * x + y * y + z * z + w * w);
+    if (length > 0.0f) {
+        x /= length;
+        y /= length;
+        z /= length;
+        w /= length;
+    }
+
+    return TransformTRS{
+        .positionX = lerp(a.positionX, b.positionX), .positionY = lerp(a.positionY, b.positionY), .positionZ = lerp(a.positionZ, b.positionZ),
+        .rotationX = x, .rotationY = y, .rotationZ = z, .rotationW = w,
+        .scaleX = lerp(a.scaleX, b.scaleX), .scaleY = lerp(a.scaleY, b.scaleY), .scaleZ = lerp(a.scaleZ, b.scaleZ),
+    };
+}
@@ -0,0 +1,112 @@
+#include "FrustumCulling.h"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+    /// @brief For every 8 bit outside mask, the 8 visibility bytes it stands for so a whole group is stored at once
+    constexpr std::array<std::uint64_t, 256> make_visibility_table() {
+        std::array<std::uint64_t, 256> table{};
+        for (std::size_t mask = 0; mask < 256; mask++) {
+            for (std::size_t lane = 0; lane < 8; lane++) {
+                if (((mask >> lane) & 1) == 0)
+                    table[mask] |= std::uint64_t{ 1 } << (lane * 8);
+            }
+        }
+        return table;
+    }
+    constexpr std::array<std::uint64_t, 256> VISIBILITY_TABLE = make_visibility_table();
+
+    /// @brief For each plane the columns of the box corner furthest along its normal, the box is outside if even that corner is behind the plane
+    struct PlaneCorners {
+        const float* x;
+        const float* y;
+        const float* z;
+    };
+
+    std::array<PlaneCorners, 6> furthest_corners(const Frustum& frustum, const WorldAABBs& boxes) {
+        std::array<PlaneCorners, 6> corners;
+        for (std::size_t p = 0; p < frustum.planes.size(); p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            corners[p] = {
+                plane.x >= 0.0f ? boxes.max_x.data() : boxes.min_x.data(),
+                plane.y >= 0.0f ? boxes.max_y.data() : boxes.min_y.data(),
+                plane.z >= 0.0f ? boxes.max_z.data() : boxes.min_z.data(),
+            };
+        }
+        return corners;
+    }
+
+    std::size_t cull_scalar(const Frustum& frustum, const std::array<PlaneCorners, 6>& corners, std::size_t first, std::size_t count, std::uint8_t* visible) {
+        for (std::size_t i = first; i < count; i++) {
+            bool inside = true;
+            for (std::size_t p = 0; p < frustum.planes.size() && inside; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                inside = plane.x * corners[p].x[i] + plane.y * corners[p].y[i] + plane.z * corners[p].z[i] + plane.w >= 0.0f;
+            }
+            visible[i] = inside;
+        }
+        return count;
+    }
+
+#ifdef FRUSTUM_CULLING_SSE
+    std::size_t cull_sse(const Frustum& frustum, const std::array<PlaneCorners, 6>& corners, std::size_t first, std::size_t count, std::uint8_t* visible) {
+        std::size_t i = first;
+        for (; i + 4 <= count; i += 4) {
+            __m128 outside = _mm_setzero_ps();
+            for (std::size_t p = 0; p < frustum.planes.size(); p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                __m128 distance = _mm_set1_ps(plane.w);
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(corners[p].x + i)));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(corners[p].y + i)));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(corners[p].z + i)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+            }
+
+            const auto bytes = static_cast<std::uint32_t>(VISIBILITY_TABLE[_mm_movemask_ps(outside)]);
+            std::memcpy(visible + i, &bytes, sizeof(bytes));
+        }
+        return i;
+    }
+#endif
+
+#ifdef __AVX2__
+    std::size_t cull_avx2(const Frustum& frustum, const std::array<PlaneCorners, 6>& corners, std::size_t first, std::size_t count, std::uint8_t* visible) {
+        std::size_t i = first;
+        for (; i + 8 <= count; i += 8) {
+            __m256 outside = _mm256_setzero_ps();
+            for (std::size_t p = 0; p < frustum.planes.size(); p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                __m256 distance = _mm256_set1_ps(plane.w);
+                distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(corners[p].x + i), distance);
+                distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(corners[p].y + i), distance);
+                distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(corners[p].z + i), distance);
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+
+            // One bit per box, spread into one byte per box
+            const std::uint64_t bytes = VISIBILITY_TABLE[_mm256_movemask_ps(outside)];
+            std::memcpy(visible + i, &bytes, sizeof(bytes));
+        }
+        return i;
+    }
+#endif
+}
+
+void cull_aabbs(const Frustum& frustum, const WorldAABBs& boxes, std::uint8_t* visible) {
+    const std::size_t count = boxes.size();
+    const std::array<PlaneCorners, 6> corners = furthest_corners(frustum, boxes);
+
+    std::size_t i = 0;
+#ifdef __AVX2__
+    i = cull_avx2(frustum, corners, i, count, visible);
+#endif
+#ifdef FRUSTUM_CULLING_SSE
+    i = cull_sse(frustum, corners, i, count, visible);
+#endif
+    cull_scalar(frustum, corners, i, count, visible);
+}
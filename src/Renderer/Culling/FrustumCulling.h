@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Core/Camera.h"
+
+/// @brief The six planes of a view frustum, @c xyz is the inward facing normal and @c w the distance so a point @c p is inside a plane if @c dot(xyz,p)+w>=0
+struct Frustum {
+    /// @brief Left, right, bottom, top, near, far, the same order as @c meshRenderer::UniformBufferObject::frustum_planes
+    std::array<glm::vec4, 6> planes;
+
+    /// @brief Extracts the planes from a projection times view matrix, for an OpenGL style -1 to 1 clip space depth like @ref Camera::get_projection
+    static Frustum from_view_proj(const glm::mat4& view_proj) {
+        // Rows of the matrix, glm is column major
+        const glm::vec4 row0{ view_proj[0][0], view_proj[1][0], view_proj[2][0], view_proj[3][0] };
+        const glm::vec4 row1{ view_proj[0][1], view_proj[1][1], view_proj[2][1], view_proj[3][1] };
+        const glm::vec4 row2{ view_proj[0][2], view_proj[1][2], view_proj[2][2], view_proj[3][2] };
+        const glm::vec4 row3{ view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3] };
+
+        Frustum frustum{ { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 } };
+        for (glm::vec4& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    /// @brief The frustum the camera sees with the projection of @ref Camera::get_projection
+    static Frustum from_camera(const Camera& camera, float aspect_ratio) {
+        return from_view_proj(camera.get_projection(aspect_ratio) * camera.get_view_matrix());
+    }
+};
+
+/**
+ * @brief Checks if a mesh's local bounds transformed by @c model are at least partially inside the frustum
+ *
+ * The bounds are turned into the world space box that encloses them, so this is conservative and never culls something visible
+ * @note This is the CPU version of the test in @c frustum_culling.comp.glsl, they have to stay the same
+ */
+inline bool is_aabb_visible(const Frustum& frustum, const glm::mat4& model, const glm::vec3& aabb_min, const glm::vec3& aabb_max) {
+    const glm::vec3 local_center = (aabb_min + aabb_max) * 0.5f;
+    const glm::vec3 local_extent = (aabb_max - aabb_min) * 0.5f;
+
+    const glm::vec3 center = glm::vec3(model * glm::vec4(local_center, 1.0f));
+    const glm::mat3 abs_model{ glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])) };
+    const glm::vec3 extent = abs_model * local_extent;
+
+    for (const glm::vec4& plane : frustum.planes) {
+        const glm::vec3 normal{ plane };
+        if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief World space boxes stored one array per component, so @ref cull_aabbs can test 8 of them with a single load per component
+ *
+ * Each box is the world space box around a mesh's local bounds transformed by an instance's model matrix, the same box the GPU culling pass tests
+ */
+struct WorldAABBs {
+    std::vector<float> min_x, min_y, min_z;
+    std::vector<float> max_x, max_y, max_z;
+
+    std::size_t size() const {
+        return min_x.size();
+    }
+
+    void resize(std::size_t count) {
+        for (std::vector<float>* column : { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z })
+            column->resize(count, 0.0f);
+    }
+
+    /// @brief Sets box @c index to the world space box around @c local_min and @c local_max transformed by @c model
+    void set(std::size_t index, const glm::mat4& model, const glm::vec3& local_min, const glm::vec3& local_max) {
+        const glm::vec3 local_center = (local_min + local_max) * 0.5f;
+        const glm::vec3 local_extent = (local_max - local_min) * 0.5f;
+
+        const glm::vec3 center = glm::vec3(model * glm::vec4(local_center, 1.0f));
+        const glm::mat3 abs_model{ glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])) };
+        const glm::vec3 extent = abs_model * local_extent;
+
+        min_x[index] = center.x - extent.x;
+        min_y[index] = center.y - extent.y;
+        min_z[index] = center.z - extent.z;
+        max_x[index] = center.x + extent.x;
+        max_y[index] = center.y + extent.y;
+        max_z[index] = center.z + extent.z;
+    }
+};
+
+/**
+ * @brief Tests every box against the frustum, 8 at a time with AVX2 when the engine is built with it (@c ENABLE_AVX2), 4 at a time with SSE otherwise
+ * @param visible Written with 1 for every box that is at least partially inside and 0 for the rest, @c boxes.size() entries
+ */
+void cull_aabbs(const Frustum& frustum, const WorldAABBs& boxes, std::uint8_t* visible);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "mesh_rendering_shared.inl"
+#include "Core/Camera.h"
+
+/// @brief How much of the screen's height a level's error may cover before a finer level is drawn, about a pixel at 1080p
+constexpr float LOD_ERROR_THRESHOLD = 0.001f;
+
+/// @brief @c meshRenderer::UniformBufferObject::lod_error_scale, a world space error this many times smaller than its distance covers @c LOD_ERROR_THRESHOLD of the screen
+inline float lod_error_scale(const Camera& camera) {
+    return 1.0f / (2.0f * std::tan(glm::radians(camera.fov) * 0.5f) * LOD_ERROR_THRESHOLD);
+}
+
+/**
+ * @brief Picks the coarsest level of @c info whose error, scaled by @c model and projected at the instance's distance, stays under @c LOD_ERROR_THRESHOLD of the screen
+ * @param center The center of the instance's world space bounds
+ * @param radius The radius of the sphere around the instance's world space bounds, from inside it the full mesh is drawn
+ * @note This is the CPU version of the selection in @c frustum_culling.comp.glsl, they have to stay the same
+ */
+inline std::uint32_t select_lod(const meshRenderer::CullDrawInfo& info, const glm::mat4& model, const glm::vec3& center, float radius,
+                                const glm::vec3& camera_position, float error_scale) {
+    const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+    const float distance = glm::length(center - camera_position) - radius;
+    if (distance <= 0.0f)
+        return 0;
+
+    std::uint32_t lod = 0;
+    for (std::uint32_t level = 1; level < info.lod_count; level++) {
+        if (info.lods[level].error * scale * error_scale > distance)
+            break;
+        lod = level;
+    }
+    return lod;
+}
@@ -0,0 +1,61 @@
+#include "OccluderProxy.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+
+OccluderProxy build_occluder_proxy(std::span<const glm::vec3> positions, std::span<const std::uint32_t> indices, std::uint32_t max_triangles) {
+    OccluderProxy proxy;
+    if (positions.empty() || indices.size() < 3 || max_triangles == 0)
+        return proxy;
+
+    // Each vertex becomes the first vertex at its position
+    std::map<std::array<float, 3>, std::uint32_t> first_vertex_at;
+    std::vector<std::uint32_t> welded(positions.size());
+    for (std::size_t vertex = 0; vertex < positions.size(); vertex++) {
+        const glm::vec3& position = positions[vertex];
+        welded[vertex] = first_vertex_at.try_emplace({ position.x, position.y, position.z }, static_cast<std::uint32_t>(vertex)).first->second;
+    }
+
+    struct Triangle {
+        std::array<std::uint32_t, 3> corners;
+        float area;
+    };
+
+    // The proxy is drawn without back face culling so the winding doesn't matter, sorting the corners makes a triangle and its flipped copy equal
+    std::vector<Triangle> triangles;
+    triangles.reserve(indices.size() / 3);
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        if (indices[i] >= positions.size() || indices[i + 1] >= positions.size() || indices[i + 2] >= positions.size())
+            continue;
+
+        std::array<std::uint32_t, 3> corners{ welded[indices[i]], welded[indices[i + 1]], welded[indices[i + 2]] };
+        std::sort(corners.begin(), corners.end());
+        const float area = glm::length(glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]));
+        if (!(area > 0.0f))
+            continue;
+        triangles.push_back({ corners, area });
+    }
+    std::sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) { return a.corners < b.corners; });
+    triangles.erase(std::unique(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) { return a.corners == b.corners; }), triangles.end());
+
+    // Largest first, ties keep the order above so the proxy doesn't depend on the sort's implementation
+    std::stable_sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) { return a.area > b.area; });
+    if (triangles.size() > max_triangles)
+        triangles.resize(max_triangles);
+
+    // Only the vertices a kept triangle uses are copied
+    constexpr std::uint32_t UNUSED = UINT32_MAX;
+    std::vector<std::uint32_t> proxy_vertex_of(positions.size(), UNUSED);
+    proxy.indices.reserve(triangles.size() * 3);
+    for (const Triangle& triangle : triangles) {
+        for (std::uint32_t vertex : triangle.corners) {
+            if (proxy_vertex_of[vertex] == UNUSED) {
+                proxy_vertex_of[vertex] = static_cast<std::uint32_t>(proxy.positions.size());
+                proxy.positions.push_back(positions[vertex]);
+            }
+            proxy.indices.push_back(proxy_vertex_of[vertex]);
+        }
+    }
+    return proxy;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// @brief How many of a mesh's triangles its proxy keeps by default, walls and floors are covered by far fewer large ones
+constexpr std::uint32_t OCCLUDER_PROXY_MAX_TRIANGLES = 1024;
+
+/**
+ * @brief A low poly copy of a mesh that is drawn into the @ref SoftwareOcclusionBuffer instead of the mesh itself
+ *
+ * Only positions are kept, the proxy is never shaded
+ */
+struct OccluderProxy {
+    std::vector<glm::vec3> positions;
+    /// @brief Three per triangle, indexing @c positions
+    std::vector<std::uint32_t> indices;
+
+    std::size_t triangle_count() const {
+        return indices.size() / 3;
+    }
+};
+
+/**
+ * @brief Builds a proxy out of the mesh's largest triangles
+ *
+ * The triangles are kept as they are, so the proxy only ever covers a part of what the mesh covers and can't hide anything the mesh doesn't,
+ * the small triangles that are left out hardly fill a pixel of the @ref SoftwareOcclusionBuffer anyway
+ * Vertices at the same position are merged first so a triangle repeated with other normals or texture coordinates is only kept once
+ * @param positions The mesh's vertex positions
+ * @param indices Three per triangle, indexing @c positions
+ * @param max_triangles How many triangles the proxy keeps at most
+ */
+OccluderProxy build_occluder_proxy(std::span<const glm::vec3> positions, std::span<const std::uint32_t> indices, std::uint32_t max_triangles = OCCLUDER_PROXY_MAX_TRIANGLES);
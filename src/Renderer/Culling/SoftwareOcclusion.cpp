@@ -0,0 +1,324 @@
+#include "SoftwareOcclusion.h"
+
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_OCCLUSION_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+    /// @brief Tile rows per rasterizing job, each job goes over every triangle so fewer and larger bands keep that cheap
+    constexpr std::uint32_t TILE_ROWS_PER_JOB = 2;
+    constexpr std::size_t BOXES_PER_JOB = 256;
+    /// @brief Triangles whose doubled area (in pixels squared) is below this can't cover a whole pixel and their depth slope blows up, they are dropped
+    constexpr float MIN_TRIANGLE_AREA = 2.0f;
+    /// @brief How much the float rounding of a plane equation is allowed for, relative to the largest value its terms take inside the buffer
+    constexpr float PLANE_ROUNDING = 1e-5f;
+    /// @brief How far the depth of every occluder is moved back on top of @c PLANE_ROUNDING, for the rounding of projecting its corners
+    constexpr float DEPTH_MARGIN = 4e-6f;
+    /// @brief How far (in pixels) a box's projection is grown so rounding never leaves out a pixel it touches
+    constexpr float BOX_MARGIN = 1.0f / 64.0f;
+
+    /// @brief @c a*b+c, fused whenever the SIMD path is so the reference and the tiled buffer round exactly the same
+    inline float multiply_add(float a, float b, float c) {
+#ifdef __FMA__
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    /// @brief Behind the eye or in front of the near plane, where the projection isn't usable
+    inline bool crosses_near_plane(const glm::vec4& clip) {
+        return clip.w <= 0.0f || clip.z < -clip.w;
+    }
+
+    inline glm::vec3 to_screen(const glm::vec4& clip) {
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return {
+            (ndc.x * 0.5f + 0.5f) * static_cast<float>(SoftwareOcclusionBuffer::WIDTH),
+            (ndc.y * 0.5f + 0.5f) * static_cast<float>(SoftwareOcclusionBuffer::HEIGHT),
+            ndc.z,
+        };
+    }
+
+    /// @brief The pixels a box touches on screen and the depth of its nearest point
+    struct ScreenRect {
+        std::int32_t min_x, min_y, max_x, max_y;
+        float nearest_depth;
+    };
+
+    /// @return @c false if the box crosses the near plane or is off screen, either way it can't be occluded
+    bool project_box(const glm::mat4& view_proj, const glm::vec3& world_min, const glm::vec3& world_max, ScreenRect& rect) {
+        // The box's edges are along the axes, so each corner is the first one plus some of the projected edges
+        const glm::vec4 first_corner = view_proj * glm::vec4(world_min, 1.0f);
+        const glm::vec4 edge_x = view_proj[0] * (world_max.x - world_min.x);
+        const glm::vec4 edge_y = view_proj[1] * (world_max.y - world_min.y);
+        const glm::vec4 edge_z = view_proj[2] * (world_max.z - world_min.z);
+
+        glm::vec3 screen_min{ INFINITY };
+        glm::vec3 screen_max{ -INFINITY };
+        for (std::uint32_t corner = 0; corner < 8; corner++) {
+            glm::vec4 clip = first_corner;
+            if (corner & 1)
+                clip += edge_x;
+            if (corner & 2)
+                clip += edge_y;
+            if (corner & 4)
+                clip += edge_z;
+            if (crosses_near_plane(clip))
+                return false;
+
+            const glm::vec3 screen = to_screen(clip);
+            screen_min = glm::min(screen_min, screen);
+            screen_max = glm::max(screen_max, screen);
+        }
+
+        // Every pixel whose square overlaps the box's bounds, not only the ones whose center is inside
+        rect.min_x = std::max(static_cast<std::int32_t>(std::floor(screen_min.x - BOX_MARGIN)), 0);
+        rect.min_y = std::max(static_cast<std::int32_t>(std::floor(screen_min.y - BOX_MARGIN)), 0);
+        rect.max_x = std::min(static_cast<std::int32_t>(std::floor(screen_max.x + BOX_MARGIN)), static_cast<std::int32_t>(SoftwareOcclusionBuffer::WIDTH) - 1);
+        rect.max_y = std::min(static_cast<std::int32_t>(std::floor(screen_max.y + BOX_MARGIN)), static_cast<std::int32_t>(SoftwareOcclusionBuffer::HEIGHT) - 1);
+        rect.nearest_depth = screen_min.z;
+        return rect.min_x <= rect.max_x && rect.min_y <= rect.max_y;
+    }
+
+    /// @brief Rasterizes one 8 pixel row of a tile
+    /// @param row The row's 8 depths
+    /// @param x The center of the row's first pixel
+    /// @param y The center of the row's pixels
+    inline void rasterize_row(const SoftwareOcclusionBuffer::ScreenTriangle& triangle, float* row, float x, float y) {
+        // The parts of the plane equations that are the same along the row
+        const float edge0 = multiply_add(triangle.edge_b[0], y, triangle.edge_c[0]);
+        const float edge1 = multiply_add(triangle.edge_b[1], y, triangle.edge_c[1]);
+        const float edge2 = multiply_add(triangle.edge_b[2], y, triangle.edge_c[2]);
+        const float depth = multiply_add(triangle.depth_b, y, triangle.depth_c);
+
+#if defined(__AVX2__) && defined(__FMA__)
+        const __m256 xs = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(
+                _mm256_cmp_ps(_mm256_fmadd_ps(_mm256_set1_ps(triangle.edge_a[0]), xs, _mm256_set1_ps(edge0)), zero, _CMP_GT_OQ),
+                _mm256_cmp_ps(_mm256_fmadd_ps(_mm256_set1_ps(triangle.edge_a[1]), xs, _mm256_set1_ps(edge1)), zero, _CMP_GT_OQ)),
+            _mm256_cmp_ps(_mm256_fmadd_ps(_mm256_set1_ps(triangle.edge_a[2]), xs, _mm256_set1_ps(edge2)), zero, _CMP_GT_OQ));
+        if (_mm256_movemask_ps(inside) == 0)
+            return;
+
+        const __m256 old_depth = _mm256_loadu_ps(row);
+        const __m256 new_depth = _mm256_min_ps(old_depth, _mm256_fmadd_ps(_mm256_set1_ps(triangle.depth_a), xs, _mm256_set1_ps(depth)));
+        _mm256_storeu_ps(row, _mm256_blendv_ps(old_depth, new_depth, inside));
+#elif defined(SOFTWARE_OCCLUSION_SSE) && !defined(__FMA__)
+        const __m128 zero = _mm_setzero_ps();
+        for (std::uint32_t half = 0; half < SoftwareOcclusionBuffer::TILE_WIDTH; half += 4) {
+            const __m128 xs = _mm_add_ps(_mm_set1_ps(x + static_cast<float>(half)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+            const __m128 inside = _mm_and_ps(
+                _mm_and_ps(
+                    _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[0]), xs), _mm_set1_ps(edge0)), zero),
+                    _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[1]), xs), _mm_set1_ps(edge1)), zero)),
+                _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[2]), xs), _mm_set1_ps(edge2)), zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            const __m128 old_depth = _mm_loadu_ps(row + half);
+            const __m128 new_depth = _mm_min_ps(old_depth, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth_a), xs), _mm_set1_ps(depth)));
+            // No blendv before SSE4.1
+            _mm_storeu_ps(row + half, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+        }
+#else
+        for (std::uint32_t lane = 0; lane < SoftwareOcclusionBuffer::TILE_WIDTH; lane++) {
+            const float lane_x = x + static_cast<float>(lane);
+            if (multiply_add(triangle.edge_a[0], lane_x, edge0) > 0.0f && multiply_add(triangle.edge_a[1], lane_x, edge1) > 0.0f && multiply_add(triangle.edge_a[2], lane_x, edge2) > 0.0f)
+                row[lane] = std::min(row[lane], multiply_add(triangle.depth_a, lane_x, depth));
+        }
+#endif
+    }
+}
+
+SoftwareOcclusionBuffer::SoftwareOcclusionBuffer()
+    : depth(WIDTH * HEIGHT, CLEAR_DEPTH), tile_max_depth(TILES_X * TILES_Y, CLEAR_DEPTH) {}
+
+void SoftwareOcclusionBuffer::begin_frame(const glm::mat4& new_view_proj) {
+    view_proj = new_view_proj;
+    triangles.clear();
+    std::fill(depth.begin(), depth.end(), CLEAR_DEPTH);
+    std::fill(tile_max_depth.begin(), tile_max_depth.end(), CLEAR_DEPTH);
+}
+
+void SoftwareOcclusionBuffer::add_occluder(const OccluderProxy& proxy, const glm::mat4& model) {
+    const glm::mat4 model_view_proj = view_proj * model;
+    clip_positions.resize(proxy.positions.size());
+    for (std::size_t i = 0; i < proxy.positions.size(); i++)
+        clip_positions[i] = model_view_proj * glm::vec4(proxy.positions[i], 1.0f);
+
+    for (std::size_t i = 0; i + 2 < proxy.indices.size(); i += 3) {
+        const glm::vec4& clip0 = clip_positions[proxy.indices[i]];
+        const glm::vec4& clip1 = clip_positions[proxy.indices[i + 1]];
+        const glm::vec4& clip2 = clip_positions[proxy.indices[i + 2]];
+        if (crosses_near_plane(clip0) || crosses_near_plane(clip1) || crosses_near_plane(clip2))
+            continue;
+
+        glm::vec3 v0 = to_screen(clip0);
+        glm::vec3 v1 = to_screen(clip1);
+        glm::vec3 v2 = to_screen(clip2);
+
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (!(std::abs(area) > MIN_TRIANGLE_AREA))
+            continue;
+        // Occluders are drawn from both sides, flipping the back facing ones keeps the inside of every edge positive
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Only pixels completely inside the bounds can be completely inside the triangle
+        ScreenTriangle triangle;
+        triangle.min_x = std::max(static_cast<std::int32_t>(std::ceil(std::min({ v0.x, v1.x, v2.x }))), 0);
+        triangle.min_y = std::max(static_cast<std::int32_t>(std::ceil(std::min({ v0.y, v1.y, v2.y }))), 0);
+        triangle.max_x = std::min(static_cast<std::int32_t>(std::floor(std::max({ v0.x, v1.x, v2.x }))) - 1, static_cast<std::int32_t>(WIDTH) - 1);
+        triangle.max_y = std::min(static_cast<std::int32_t>(std::floor(std::max({ v0.y, v1.y, v2.y }))) - 1, static_cast<std::int32_t>(HEIGHT) - 1);
+        if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+            continue;
+
+        const std::array<glm::vec3, 3> corners{ v0, v1, v2 };
+        for (std::size_t edge = 0; edge < 3; edge++) {
+            const glm::vec3& from = corners[edge];
+            const glm::vec3& to = corners[(edge + 1) % 3];
+            triangle.edge_a[edge] = from.y - to.y;
+            triangle.edge_b[edge] = to.x - from.x;
+            triangle.edge_c[edge] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+
+            // The smallest an edge equation gets over a pixel is at the corner half a pixel along -(a,b), so moving it by that much tests the whole pixel at its center
+            const float half_pixel = 0.5f * (std::abs(triangle.edge_a[edge]) + std::abs(triangle.edge_b[edge]));
+            const float largest_term = std::abs(triangle.edge_a[edge]) * WIDTH + std::abs(triangle.edge_b[edge]) * HEIGHT + std::abs(triangle.edge_c[edge]);
+            triangle.edge_c[edge] -= half_pixel + largest_term * PLANE_ROUNDING;
+        }
+
+        triangle.depth_a = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        triangle.depth_b = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        triangle.depth_c = v0.z - triangle.depth_a * v0.x - triangle.depth_b * v0.y;
+
+        // Likewise the furthest depth over a pixel, a box behind that is behind the whole pixel of the triangle
+        const float half_pixel = 0.5f * (std::abs(triangle.depth_a) + std::abs(triangle.depth_b));
+        const float largest_term = std::abs(triangle.depth_a) * WIDTH + std::abs(triangle.depth_b) * HEIGHT + std::abs(triangle.depth_c);
+        triangle.depth_c += half_pixel + largest_term * PLANE_ROUNDING + DEPTH_MARGIN;
+
+        triangles.push_back(triangle);
+    }
+}
+
+void SoftwareOcclusionBuffer::rasterize() {
+    jobs::parallel_for(0, TILES_Y, TILE_ROWS_PER_JOB, [this](std::size_t begin, std::size_t end) {
+        rasterize_tile_rows(static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end));
+    });
+}
+
+void SoftwareOcclusionBuffer::rasterize_tile_rows(std::uint32_t first_tile_row, std::uint32_t end_tile_row) {
+    const auto band_min_y = static_cast<std::int32_t>(first_tile_row * TILE_HEIGHT);
+    const auto band_max_y = static_cast<std::int32_t>(end_tile_row * TILE_HEIGHT) - 1;
+
+    for (const ScreenTriangle& triangle : triangles) {
+        if (triangle.max_y < band_min_y || triangle.min_y > band_max_y)
+            continue;
+
+        const std::int32_t min_y = std::max(triangle.min_y, band_min_y);
+        const std::int32_t max_y = std::min(triangle.max_y, band_max_y);
+        const std::uint32_t first_tile_x = static_cast<std::uint32_t>(triangle.min_x) / TILE_WIDTH;
+        const std::uint32_t last_tile_x = static_cast<std::uint32_t>(triangle.max_x) / TILE_WIDTH;
+
+        for (std::int32_t y = min_y; y <= max_y; y++) {
+            const float center_y = static_cast<float>(y) + 0.5f;
+            for (std::uint32_t tile_x = first_tile_x; tile_x <= last_tile_x; tile_x++) {
+                const std::uint32_t x = tile_x * TILE_WIDTH;
+                rasterize_row(triangle, &depth[pixel_index(x, static_cast<std::uint32_t>(y))], static_cast<float>(x) + 0.5f, center_y);
+            }
+        }
+    }
+
+    for (std::uint32_t tile = first_tile_row * TILES_X; tile < end_tile_row * TILES_X; tile++) {
+        const float* tile_depth = &depth[tile * TILE_WIDTH * TILE_HEIGHT];
+        tile_max_depth[tile] = *std::max_element(tile_depth, tile_depth + TILE_WIDTH * TILE_HEIGHT);
+    }
+}
+
+bool SoftwareOcclusionBuffer::is_occluded(const glm::vec3& world_min, const glm::vec3& world_max) const {
+    auto rect_is_occluded = [this](const ScreenRect& rect) {
+        for (std::int32_t tile_y = rect.min_y / TILE_HEIGHT; tile_y <= rect.max_y / static_cast<std::int32_t>(TILE_HEIGHT); tile_y++) {
+            for (std::int32_t tile_x = rect.min_x / TILE_WIDTH; tile_x <= rect.max_x / static_cast<std::int32_t>(TILE_WIDTH); tile_x++) {
+                // A tile whose furthest occluder is nearer than the box hides the box wherever it overlaps it
+                if (tile_max_depth[tile_y * TILES_X + tile_x] < rect.nearest_depth)
+                    continue;
+
+                const std::int32_t min_x = std::max(rect.min_x, tile_x * static_cast<std::int32_t>(TILE_WIDTH));
+                const std::int32_t max_x = std::min(rect.max_x, (tile_x + 1) * static_cast<std::int32_t>(TILE_WIDTH) - 1);
+                const std::int32_t min_y = std::max(rect.min_y, tile_y * static_cast<std::int32_t>(TILE_HEIGHT));
+                const std::int32_t max_y = std::min(rect.max_y, (tile_y + 1) * static_cast<std::int32_t>(TILE_HEIGHT) - 1);
+                for (std::int32_t y = min_y; y <= max_y; y++) {
+                    for (std::int32_t x = min_x; x <= max_x; x++) {
+                        if (depth_at(x, y) >= rect.nearest_depth)
+                            return false;
+                    }
+                }
+            }
+        }
+        return true;
+    };
+
+    ScreenRect rect;
+    return project_box(view_proj, world_min, world_max, rect) && rect_is_occluded(rect);
+}
+
+void SoftwareOcclusionBuffer::cull_occluded(const WorldAABBs& boxes, std::uint8_t* visible) const {
+    jobs::parallel_for(0, boxes.size(), BOXES_PER_JOB, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            if (visible[i] && is_occluded({ boxes.min_x[i], boxes.min_y[i], boxes.min_z[i] }, { boxes.max_x[i], boxes.max_y[i], boxes.max_z[i] }))
+                visible[i] = 0;
+        }
+    });
+}
+
+std::size_t SoftwareOcclusionBuffer::validate_depth() const {
+    std::vector<float> reference(WIDTH * HEIGHT, CLEAR_DEPTH);
+    for (const ScreenTriangle& triangle : triangles) {
+        for (std::uint32_t y = 0; y < HEIGHT; y++) {
+            const float center_y = static_cast<float>(y) + 0.5f;
+            for (std::uint32_t x = 0; x < WIDTH; x++) {
+                const float center_x = static_cast<float>(x) + 0.5f;
+                bool inside = true;
+                for (std::size_t edge = 0; edge < 3; edge++)
+                    inside = inside && multiply_add(triangle.edge_a[edge], center_x, multiply_add(triangle.edge_b[edge], center_y, triangle.edge_c[edge])) > 0.0f;
+                if (inside) {
+                    float& pixel = reference[y * WIDTH + x];
+                    pixel = std::min(pixel, multiply_add(triangle.depth_a, center_x, multiply_add(triangle.depth_b, center_y, triangle.depth_c)));
+                }
+            }
+        }
+    }
+
+    std::size_t mismatches = 0;
+    for (std::uint32_t y = 0; y < HEIGHT; y++) {
+        for (std::uint32_t x = 0; x < WIDTH; x++) {
+            if (reference[y * WIDTH + x] != depth_at(x, y))
+                mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+bool SoftwareOcclusionBuffer::is_occluded_reference(const glm::vec3& world_min, const glm::vec3& world_max) const {
+    ScreenRect rect;
+    if (!project_box(view_proj, world_min, world_max, rect))
+        return false;
+
+    for (std::int32_t y = rect.min_y; y <= rect.max_y; y++) {
+        for (std::int32_t x = rect.min_x; x <= rect.max_x; x++) {
+            if (depth_at(x, y) >= rect.nearest_depth)
+                return false;
+        }
+    }
+    return true;
+}
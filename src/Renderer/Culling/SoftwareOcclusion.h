@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "OccluderProxy.h"
+#include "FrustumCulling.h"
+
+/**
+ * @brief A low resolution depth buffer the occluders are rasterized into on the CPU, boxes hidden behind them can then be culled without a GPU depth pyramid
+ *
+ * The buffer is split into 8x4 pixel tiles stored one after another, a row of a tile is one 8 wide AVX2 vector (two SSE ones)
+ * Each frame:
+ * - @c begin_frame clears the buffer and takes the camera
+ * - @c add_occluder transforms the triangles of each occluder instance to screen space
+ * - @c rasterize draws them on the job threads, each job owns a band of tile rows so no two jobs write the same pixel
+ * - @c is_occluded / @c cull_occluded test boxes against the buffer
+ *
+ * The buffer stores the nearest occluder depth of each pixel (NDC depth of @ref Camera::get_projection) and the furthest of those per tile,
+ * a box is occluded if every pixel it touches holds an occluder nearer than the nearest point of the box, whole tiles are accepted with their furthest depth alone
+ *
+ * The culling is conservative, a box that is visible anywhere is never occluded:
+ * - an occluder only writes to the pixels one of its triangles covers completely, with the furthest depth the triangle has inside the pixel
+ * - a box is tested against every pixel its projection touches, with the depth of its nearest corner
+ * @note Pixels along an edge two triangles share are covered by neither, triangles crossing the near plane are dropped instead of clipped
+ * and boxes crossing it are never occluded, all three only lose culling
+ * @note Nothing here needs a GPU, @c tests/software_occlusion_test.cpp checks the tiles against @c validate_depth and @c is_occluded_reference on random scenes
+ */
+class SoftwareOcclusionBuffer {
+public:
+    static constexpr std::uint32_t WIDTH = 256;
+    static constexpr std::uint32_t HEIGHT = 128;
+    static constexpr std::uint32_t TILE_WIDTH = 8;
+    static constexpr std::uint32_t TILE_HEIGHT = 4;
+    static constexpr std::uint32_t TILES_X = WIDTH / TILE_WIDTH;
+    static constexpr std::uint32_t TILES_Y = HEIGHT / TILE_HEIGHT;
+    /// @brief The depth of a pixel nothing was drawn to
+    static constexpr float CLEAR_DEPTH = 1.0f;
+
+    /// @brief A triangle set up for rasterizing, in pixels with pixel @c (x,y) centered at @c (x+0.5,y+0.5)
+    struct ScreenTriangle {
+        /// @brief Edge @c i is @c edge_a[i]*x+edge_b[i]*y+edge_c[i], moved inwards by half a pixel so all three are above zero at a pixel's center only if the triangle covers the whole pixel
+        std::array<float, 3> edge_a, edge_b, edge_c;
+        /// @brief The depth at a pixel's center is @c depth_a*x+depth_b*y+depth_c, moved back to the furthest depth of the triangle's plane inside the pixel
+        float depth_a, depth_b, depth_c;
+        /// @brief The pixels inside the triangle's bounds, inclusive and inside the buffer
+        std::int32_t min_x, min_y, max_x, max_y;
+    };
+
+    SoftwareOcclusionBuffer();
+
+    /// @brief Clears the depth and the triangles of the last frame
+    /// @param view_proj The camera's projection times view matrix, occluders and boxes are projected with it
+    void begin_frame(const glm::mat4& view_proj);
+
+    /// @brief Queues the triangles of @c proxy placed by @c model for the next @c rasterize
+    void add_occluder(const OccluderProxy& proxy, const glm::mat4& model);
+
+    /// @brief Draws every queued triangle into the depth buffer across the job threads
+    void rasterize();
+
+    /// @brief Checks if the world space box is completely hidden behind what was rasterized
+    bool is_occluded(const glm::vec3& world_min, const glm::vec3& world_max) const;
+
+    /// @brief Sets @c visible to 0 for every box that was visible before but is occluded, across the job threads
+    /// @param visible One entry per box in @c boxes, as written by @ref cull_aabbs
+    void cull_occluded(const WorldAABBs& boxes, std::uint8_t* visible) const;
+
+    /// @brief The depth of pixel @c (x,y), @c y grows downwards like the framebuffer's
+    float depth_at(std::uint32_t x, std::uint32_t y) const {
+        return depth[pixel_index(x, y)];
+    }
+
+    std::size_t triangle_count() const {
+        return triangles.size();
+    }
+
+    /// @brief Rasterizes every queued triangle again one pixel at a time over the whole buffer
+    /// @return The number of pixels whose depth differs from the tiled buffer's
+    std::size_t validate_depth() const;
+
+    /// @brief @c is_occluded checking every pixel the box touches against the per pixel depth, without the tiles
+    bool is_occluded_reference(const glm::vec3& world_min, const glm::vec3& world_max) const;
+
+private:
+    std::vector<float> depth;
+    /// @brief The furthest depth in each tile, one per tile in the same order as the tiles in @c depth
+    std::vector<float> tile_max_depth;
+
+    std::vector<ScreenTriangle> triangles;
+    /// @brief Scratch for @c add_occluder, the proxy's vertices in clip space
+    std::vector<glm::vec4> clip_positions;
+
+    glm::mat4 view_proj{ 1.0f };
+
+    static constexpr std::size_t pixel_index(std::uint32_t x, std::uint32_t y) {
+        const std::size_t tile = (y / TILE_HEIGHT) * TILES_X + x / TILE_WIDTH;
+        return tile * TILE_WIDTH * TILE_HEIGHT + (y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH;
+    }
+
+    /// @brief Rasterizes the triangles over tile rows @c [first_tile_row, end_tile_row) and updates their tiles' furthest depth
+    void rasterize_tile_rows(std::uint32_t first_tile_row, std::uint32_t end_tile_row);
+};
@@ -1,11 +1,18 @@
 #include "DrawGroup.h"
 
+#include <algorithm>
+
 
 void DrawGroup::cleanup() {
      device.destroy(vertex_buffer_id);
      device.destroy(index_buffer_id);
 	 device.destroy(command_buffer_id);
      device.destroy(instance_buffer_id);
+     device.destroy(draw_info_buffer_id);
+     device.destroy(instance_draw_buffer_id);
+     device.destroy(visible_instance_buffer_id);
+     device.destroy(cull_counter_buffer_id);
+     device.destroy(visibility_history_buffer_id);
 }
 
 void DrawGroup::allocBuffers() {
@@ -30,7 +37,7 @@ void DrawGroup::allocBuffers() {
 		});
 
 	command_buffer_id = device.create_buffer({
-		.size = MAX_DRAWGROUP_MESH_COUNT * sizeof(VkDrawIndexedIndirectCommand),
+		.size = CULL_PHASE_COUNT * MAX_DRAWGROUP_COMMAND_COUNT * sizeof(VkDrawIndexedIndirectCommand),
 		.name = name + " command buffer"
 		});
 
@@ -41,7 +48,6 @@ void DrawGroup::allocBuffers() {
 
 	instance_buffer_id = device.create_buffer({
 		.size = MAX_DRAWGROUP_INSTANCE_COUNT * sizeof(meshRenderer::PerInstanceData),
-		.allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
 		.name = name + " instance SSBO"
 		});
 
@@ -49,6 +55,57 @@ void DrawGroup::allocBuffers() {
 		.initial_buffers = {.buffers = std::span{&instance_buffer_id, 1}},
 		.name = name + " task instance SSBO"
 		});
+
+	draw_info_buffer_id = device.create_buffer({
+		.size = MAX_DRAWGROUP_MESH_COUNT * sizeof(meshRenderer::CullDrawInfo),
+		.name = name + " draw info buffer"
+		});
+
+	task_draw_info_buffer = daxa::TaskBuffer({
+		.initial_buffers = {.buffers = std::span{&draw_info_buffer_id, 1}},
+		.name = name + " task draw info buffer"
+		});
+
+	instance_draw_buffer_id = device.create_buffer({
+		.size = MAX_DRAWGROUP_INSTANCE_COUNT * sizeof(uint32_t),
+		.name = name + " instance draw buffer"
+		});
+
+	task_instance_draw_buffer = daxa::TaskBuffer({
+		.initial_buffers = {.buffers = std::span{&instance_draw_buffer_id, 1}},
+		.name = name + " task instance draw buffer"
+		});
+
+	visible_instance_buffer_id = device.create_buffer({
+		.size = visible_instance_phase_offset(CULL_PHASE_COUNT),
+		.name = name + " visible instance buffer"
+		});
+
+	task_visible_instance_buffer = daxa::TaskBuffer({
+		.initial_buffers = {.buffers = std::span{&visible_instance_buffer_id, 1}},
+		.name = name + " task visible instance buffer"
+		});
+
+	// For each phase the draw count followed by the visible instance count of each level of each draw
+	cull_counter_buffer_id = device.create_buffer({
+		.size = counter_phase_offset(CULL_PHASE_COUNT),
+		.name = name + " cull counter buffer"
+		});
+
+	task_cull_counter_buffer = daxa::TaskBuffer({
+		.initial_buffers = {.buffers = std::span{&cull_counter_buffer_id, 1}},
+		.name = name + " task cull counter buffer"
+		});
+
+	visibility_history_buffer_id = device.create_buffer({
+		.size = MAX_DRAWGROUP_INSTANCE_COUNT * sizeof(uint32_t),
+		.name = name + " visibility history buffer"
+		});
+
+	task_visibility_history_buffer = daxa::TaskBuffer({
+		.initial_buffers = {.buffers = std::span{&visibility_history_buffer_id, 1}},
+		.name = name + " task visibility history buffer"
+		});
 }
 
 void DrawGroup::loadBufferInfo(
@@ -70,43 +127,106 @@ void DrawGroup::loadBufferInfo(
 
 	vertexStagingArr.reserve(total_vertex_count);
 	indexStagingArr.reserve(total_index_count);
-	instanceStagingArr.reserve(MAX_DRAWGROUP_INSTANCE_COUNT);
 
 	for (auto& mesh : meshes) {
 		std::shared_ptr<DrawableMesh> meshPtr = mesh.lock();
 
 		meshPtr->vertex_offset = currentVertexCount;
 		meshPtr->index_offset = currentIndexCount;
-		meshPtr->instance_offset = currentInstanceCount;
 
 	    currentVertexCount += meshPtr->vertex_count;
 	    currentIndexCount += meshPtr->index_count;
 
-		meshPtr->instance_data_offsets.reserve(meshPtr->instance_data.size());
-		for (int i = 0; i < meshPtr->instance_data.size(); i++) {
-			meshPtr->instance_data_offsets.push_back(currentInstanceCount);
-			currentInstanceCount++;
-		}
-
 		vertexStagingArr.insert(vertexStagingArr.end(), meshPtr->verticies.begin(), meshPtr->verticies.end());
 		indexStagingArr.insert(indexStagingArr.end(), meshPtr->indicies.begin(), meshPtr->indicies.end());
-		instanceStagingArr.insert(instanceStagingArr.end(), meshPtr->instance_data.begin(), meshPtr->instance_data.end());
+	}
+
+	// Static instances of every mesh go first so the part of the buffer that is never written again is one block at the front
+	for (auto& mesh : meshes) {
+		std::shared_ptr<DrawableMesh> meshPtr = mesh.lock();
+
+		meshPtr->instance_data_offsets.assign(meshPtr->instance_data.size(), 0);
+		meshPtr->static_instance_offset = currentInstanceCount;
+		for (std::uint32_t i = 0; i < meshPtr->instance_data.size(); i++) {
+			if (meshPtr->is_instance_static(i))
+				meshPtr->instance_data_offsets[i] = currentInstanceCount++;
+		}
+		meshPtr->static_instance_count = currentInstanceCount - meshPtr->static_instance_offset;
+	}
+	static_instance_count = currentInstanceCount;
+
+	for (auto& mesh : meshes) {
+		std::shared_ptr<DrawableMesh> meshPtr = mesh.lock();
+
+		meshPtr->instance_offset = currentInstanceCount;
+		for (std::uint32_t i = 0; i < meshPtr->instance_data.size(); i++) {
+			if (!meshPtr->is_instance_static(i))
+				meshPtr->instance_data_offsets[i] = currentInstanceCount++;
+		}
 	}
 
 	if (currentInstanceCount > MAX_DRAWGROUP_INSTANCE_COUNT)
 	   throw std::runtime_error("Error: DrawGroup instance count exceeded, either bind less instances to the drawgroup or increase MAX_DRAWGROUP_INSTANCE_COUNT");
-	
-	indirectCommands.reserve(meshes.size());
+
+	instanceStagingArr.resize(currentInstanceCount);
+	world_aabbs.resize(currentInstanceCount);
+	for (auto& mesh : meshes) {
+		std::shared_ptr<DrawableMesh> meshPtr = mesh.lock();
+		for (std::size_t i = 0; i < meshPtr->instance_data.size(); i++) {
+			const std::uint32_t offset = meshPtr->instance_data_offsets[i];
+			instanceStagingArr[offset] = meshPtr->instance_data[i];
+			world_aabbs.set(offset, to_glm(meshPtr->instance_data[i].model_matrix), to_glm(meshPtr->aabb_min), to_glm(meshPtr->aabb_max));
+		}
+	}
+
+	// Up to two draws per mesh, one for its static instances and one for its dynamic ones
+	indirectCommands.clear();
+	indirectCommands.reserve(meshes.size() * 2);
+	cullDrawInfos.clear();
+	cullDrawInfos.reserve(meshes.size() * 2);
+	instanceDraws.assign(currentInstanceCount, 0);
 
 	for (auto& drawableMesh : meshes) {
-		indirectCommands.push_back(VkDrawIndexedIndirectCommand{
-			.indexCount = drawableMesh.lock()->index_count,
-			.instanceCount = static_cast<std::uint32_t>(drawableMesh.lock()->instance_data.size()),
-			.firstIndex = drawableMesh.lock()->index_offset,
-			.vertexOffset = static_cast<std::int32_t>(drawableMesh.lock()->vertex_offset),
-			.firstInstance = drawableMesh.lock()->instance_offset
-		});
+		std::shared_ptr<DrawableMesh> meshPtr = drawableMesh.lock();
+		const auto dynamic_instance_count = static_cast<std::uint32_t>(meshPtr->instance_data.size()) - meshPtr->static_instance_count;
+
+		auto add_draw = [&](std::uint32_t first_instance, std::uint32_t instance_count) {
+			const auto draw = static_cast<uint32_t>(indirectCommands.size());
+			indirectCommands.push_back(VkDrawIndexedIndirectCommand{
+				.indexCount = meshPtr->lods[0].indexCount,
+				.instanceCount = instance_count,
+				.firstIndex = meshPtr->index_offset + meshPtr->lods[0].firstIndex,
+				.vertexOffset = static_cast<std::int32_t>(meshPtr->vertex_offset),
+				.firstInstance = first_instance
+			});
+
+			meshRenderer::CullDrawInfo info{
+				.aabb_min = meshPtr->aabb_min,
+				.lod_count = static_cast<std::uint32_t>(std::min<std::size_t>(meshPtr->lods.size(), MAX_LOD_COUNT)),
+				.aabb_max = meshPtr->aabb_max,
+				.vertex_offset = static_cast<std::int32_t>(meshPtr->vertex_offset),
+				.first_instance = first_instance,
+				.instance_count = instance_count,
+			};
+			for (std::uint32_t lod = 0; lod < info.lod_count; lod++) {
+				info.lods[lod] = {
+					.first_index = meshPtr->index_offset + meshPtr->lods[lod].firstIndex,
+					.index_count = meshPtr->lods[lod].indexCount,
+					.error = meshPtr->lods[lod].error,
+				};
+			}
+			cullDrawInfos.push_back(info);
+			std::fill_n(instanceDraws.begin() + first_instance, instance_count, draw);
+		};
+
+		if (meshPtr->static_instance_count > 0)
+			add_draw(meshPtr->static_instance_offset, meshPtr->static_instance_count);
+		if (dynamic_instance_count > 0)
+			add_draw(meshPtr->instance_offset, dynamic_instance_count);
 	}
+
+	if (indirectCommands.size() > MAX_DRAWGROUP_MESH_COUNT)
+	   throw std::runtime_error("Error: DrawGroup draw count exceeded, either bind less meshes to the drawgroup or increase MAX_DRAWGROUP_MESH_COUNT");
 }
 
 void DrawGroup::uploadBufferData(
@@ -119,7 +239,10 @@ void DrawGroup::uploadBufferData(
 		.attachments = {
 			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_vertex_buffer),
 			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_index_buffer),
-			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_command_buffer)
+			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_instance_buffer),
+			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_draw_info_buffer),
+			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_instance_draw_buffer),
+			daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, this->task_visibility_history_buffer)
 		},
 		.task = [=, this](daxa::TaskInterface ti) {
 			auto vertex_staging = ti.device.create_buffer({
@@ -152,21 +275,200 @@ void DrawGroup::uploadBufferData(
 				.size = indexStagingArr.size() * sizeof(uint32_t),
 			});
 
-			auto command_staging = ti.device.create_buffer({
-				.size = indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+			// Nothing was visible before the first frame, so its early phase draws nothing and the late phase tests everything
+			ti.recorder.clear_buffer({
+				.buffer = ti.get(this->task_visibility_history_buffer).ids[0],
+				.offset = 0,
+				.size = MAX_DRAWGROUP_INSTANCE_COUNT * sizeof(uint32_t),
+				.clear_value = 0,
+			});
+
+			// The command buffer is written by the culling pass every frame, only its inputs are uploaded
+			auto draw_info_staging = ti.device.create_buffer({
+				.size = cullDrawInfos.size() * sizeof(meshRenderer::CullDrawInfo),
 				.allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
-				.name = this->name + ">" + name + "command staging buffer",
+				.name = this->name + ">" + name + " draw info staging buffer",
 			});
-			ti.recorder.destroy_buffer_deferred(command_staging);
-			auto* command_ptr = ti.device.buffer_host_address_as<VkDrawIndexedIndirectCommand>(command_staging).value();
-			std::memcpy(command_ptr, indirectCommands.data(), indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+			ti.recorder.destroy_buffer_deferred(draw_info_staging);
+			auto* draw_info_ptr = ti.device.buffer_host_address_as<meshRenderer::CullDrawInfo>(draw_info_staging).value();
+			std::memcpy(draw_info_ptr, cullDrawInfos.data(), cullDrawInfos.size() * sizeof(meshRenderer::CullDrawInfo));
 
 			ti.recorder.copy_buffer_to_buffer({
-				.src_buffer = command_staging,
-				.dst_buffer = ti.get(this->task_command_buffer).ids[0],
-				.size = indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand)
+				.src_buffer = draw_info_staging,
+				.dst_buffer = ti.get(this->task_draw_info_buffer).ids[0],
+				.size = cullDrawInfos.size() * sizeof(meshRenderer::CullDrawInfo)
+			});
+
+			if (instanceStagingArr.empty())
+				return;
+
+			auto instance_draw_staging = ti.device.create_buffer({
+				.size = instanceDraws.size() * sizeof(uint32_t),
+				.allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+				.name = this->name + ">" + name + " instance draw staging buffer",
+			});
+			ti.recorder.destroy_buffer_deferred(instance_draw_staging);
+			auto* instance_draw_ptr = ti.device.buffer_host_address_as<uint32_t>(instance_draw_staging).value();
+			std::memcpy(instance_draw_ptr, instanceDraws.data(), instanceDraws.size() * sizeof(uint32_t));
+
+			ti.recorder.copy_buffer_to_buffer({
+				.src_buffer = instance_draw_staging,
+				.dst_buffer = ti.get(this->task_instance_draw_buffer).ids[0],
+				.size = instanceDraws.size() * sizeof(uint32_t)
+			});
+
+			auto instance_staging = ti.device.create_buffer({
+				.size = instanceStagingArr.size() * sizeof(meshRenderer::PerInstanceData),
+				.allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+				.name = this->name + ">" + name + " instance staging buffer",
+			});
+			ti.recorder.destroy_buffer_deferred(instance_staging);
+			auto* instance_ptr = ti.device.buffer_host_address_as<meshRenderer::PerInstanceData>(instance_staging).value();
+			std::memcpy(instance_ptr, instanceStagingArr.data(), instanceStagingArr.size() * sizeof(meshRenderer::PerInstanceData));
+
+			ti.recorder.copy_buffer_to_buffer({
+				.src_buffer = instance_staging,
+				.dst_buffer = ti.get(this->task_instance_buffer).ids[0],
+				.size = instanceStagingArr.size() * sizeof(meshRenderer::PerInstanceData)
 			});
 		},
 		.name = this->name + ">" + name + " upload mesh data",
 	});
-}
\ No newline at end of file
+}
+
+void DrawGroup::update_instances(const DrawableMesh& mesh, std::uint32_t first_instance, std::uint32_t count) {
+	const auto placed_instances = static_cast<std::uint32_t>(mesh.instance_data_offsets.size());
+	if (first_instance >= placed_instances)
+		return;
+	count = std::min(count, placed_instances - first_instance);
+
+	for (std::uint32_t i = first_instance; i < first_instance + count; i++) {
+		// The static region was baked by uploadBuffers and is never written again
+		if (mesh.is_instance_static(i))
+			continue;
+
+		const std::uint32_t offset = mesh.instance_data_offsets[i];
+		cpu_instance_data[offset] = mesh.instance_data[i];
+		world_aabbs.set(offset, to_glm(mesh.instance_data[i].model_matrix), to_glm(mesh.aabb_min), to_glm(mesh.aabb_max));
+
+		// Neighbouring instances are usually updated one after another, so grow the last range instead of adding one
+		if (!dirty_instance_ranges.empty() && dirty_instance_ranges.back().first + dirty_instance_ranges.back().count == offset)
+			dirty_instance_ranges.back().count++;
+		else
+			dirty_instance_ranges.push_back({ offset, 1 });
+	}
+}
+
+void DrawGroup::extract_frame(DrawGroupSnapshot& snapshot) {
+	snapshot.instance_ranges.clear();
+	snapshot.instance_data.clear();
+	snapshot.draw_count = static_cast<uint32_t>(indirectCommands.size());
+	snapshot.instance_count = static_cast<uint32_t>(instanceDraws.size());
+
+	if (dirty_instance_ranges.empty())
+		return;
+
+	std::sort(dirty_instance_ranges.begin(), dirty_instance_ranges.end(), [](const InstanceRange& a, const InstanceRange& b) { return a.first < b.first; });
+
+	// Ranges that touch or overlap become one
+	for (const InstanceRange& range : dirty_instance_ranges) {
+		if (!snapshot.instance_ranges.empty()) {
+			InstanceRange& last = snapshot.instance_ranges.back();
+			if (range.first <= last.first + last.count) {
+				last.count = std::max(last.first + last.count, range.first + range.count) - last.first;
+				continue;
+			}
+		}
+		snapshot.instance_ranges.push_back(range);
+	}
+	dirty_instance_ranges.clear();
+
+	for (const InstanceRange& range : snapshot.instance_ranges)
+		snapshot.instance_data.insert(snapshot.instance_data.end(), cpu_instance_data.begin() + range.first, cpu_instance_data.begin() + range.first + range.count);
+}
+
+void DrawGroup::add_occluders(SoftwareOcclusionBuffer& occlusion_buffer) const {
+	for (const auto& mesh : meshes) {
+		std::shared_ptr<DrawableMesh> meshPtr = mesh.lock();
+		if (!meshPtr->occluder_proxy.has_value())
+			continue;
+
+		// Instances added after uploadBuffers have no place in the instance buffer and aren't drawn yet
+		for (const std::uint32_t offset : meshPtr->instance_data_offsets)
+			occlusion_buffer.add_occluder(*meshPtr->occluder_proxy, to_glm(cpu_instance_data[offset].model_matrix));
+	}
+}
+
+void DrawGroup::cull_frame(const Frustum& frustum, const Camera& camera, const SoftwareOcclusionBuffer& occlusion_buffer, DrawGroupSnapshot& snapshot) {
+	snapshot.visible_instances.clear();
+	snapshot.visible_commands.clear();
+
+	instance_visibility.resize(world_aabbs.size());
+	cull_aabbs(frustum, world_aabbs, instance_visibility.data());
+	// Only what is left after the cheaper frustum test is projected against the occluders
+	occlusion_buffer.cull_occluded(world_aabbs, instance_visibility.data());
+
+	const float error_scale = lod_error_scale(camera);
+	instance_lods.resize(world_aabbs.size());
+
+	// Each draw's instances are one range of the instance buffer, the visible ones drawn at each level become one range of the visible list
+	for (std::size_t draw = 0; draw < indirectCommands.size(); draw++) {
+		const VkDrawIndexedIndirectCommand& command = indirectCommands[draw];
+		const meshRenderer::CullDrawInfo& info = cullDrawInfos[draw];
+		const uint32_t end_instance = command.firstInstance + command.instanceCount;
+
+		for (uint32_t instance = command.firstInstance; instance < end_instance; instance++) {
+			if (!instance_visibility[instance])
+				continue;
+			const glm::vec3 world_min{ world_aabbs.min_x[instance], world_aabbs.min_y[instance], world_aabbs.min_z[instance] };
+			const glm::vec3 world_max{ world_aabbs.max_x[instance], world_aabbs.max_y[instance], world_aabbs.max_z[instance] };
+			instance_lods[instance] = static_cast<std::uint8_t>(select_lod(info, to_glm(cpu_instance_data[instance].model_matrix),
+				(world_min + world_max) * 0.5f, glm::length(world_max - world_min) * 0.5f, camera.position, error_scale));
+		}
+
+		for (uint32_t lod = 0; lod < info.lod_count; lod++) {
+			const auto first_visible = static_cast<uint32_t>(snapshot.visible_instances.size());
+			for (uint32_t instance = command.firstInstance; instance < end_instance; instance++) {
+				if (instance_visibility[instance] && instance_lods[instance] == lod)
+					snapshot.visible_instances.push_back(instance);
+			}
+
+			const auto visible_count = static_cast<uint32_t>(snapshot.visible_instances.size()) - first_visible;
+			if (visible_count == 0)
+				continue;
+
+			VkDrawIndexedIndirectCommand visible_command = command;
+			visible_command.indexCount = info.lods[lod].index_count;
+			visible_command.firstIndex = info.lods[lod].first_index;
+			visible_command.instanceCount = visible_count;
+			visible_command.firstInstance = first_visible;
+			snapshot.visible_commands.push_back(visible_command);
+		}
+	}
+}
+
+void DrawGroup::record_instance_uploads(const daxa::TaskInterface& ti, const DrawGroupSnapshot& snapshot) const {
+	if (snapshot.instance_data.empty())
+		return;
+
+	auto instance_staging = ti.device.create_buffer({
+		.size = snapshot.instance_data.size() * sizeof(meshRenderer::PerInstanceData),
+		.allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+		.name = name + " instance staging buffer",
+	});
+	ti.recorder.destroy_buffer_deferred(instance_staging);
+	auto* instance_ptr = ti.device.buffer_host_address_as<meshRenderer::PerInstanceData>(instance_staging).value();
+	std::memcpy(instance_ptr, snapshot.instance_data.data(), snapshot.instance_data.size() * sizeof(meshRenderer::PerInstanceData));
+
+	std::size_t staging_offset = 0;
+	for (const InstanceRange& range : snapshot.instance_ranges) {
+		ti.recorder.copy_buffer_to_buffer({
+			.src_buffer = instance_staging,
+			.dst_buffer = ti.get(task_instance_buffer).ids[0],
+			.src_offset = staging_offset * sizeof(meshRenderer::PerInstanceData),
+			.dst_offset = range.first * sizeof(meshRenderer::PerInstanceData),
+			.size = range.count * sizeof(meshRenderer::PerInstanceData),
+		});
+		staging_offset += range.count;
+	}
+}
@@ -2,6 +2,9 @@
 
 #include "mesh_rendering_shared.inl"
 #include "DrawableMesh.h"
+#include "Renderer/Culling/FrustumCulling.h"
+#include "Renderer/Culling/SoftwareOcclusion.h"
+#include "Renderer/Culling/LodSelection.h"
 
 #include <daxa/daxa.hpp>
 #include <daxa/utils/pipeline_manager.hpp>
@@ -12,6 +15,38 @@
 /// @note @c MAX_DRAWGROUP_INSTANCE_COUNT and @c MAX_DRAWGROUP_MESH_COUNT determine the size of the @c task_instance_buffer and the @c task_command_buffer respectively
 constexpr size_t MAX_DRAWGROUP_INSTANCE_COUNT = 1024;
 constexpr size_t MAX_DRAWGROUP_MESH_COUNT = 1024;
+/// @brief Each draw becomes up to one command per level of detail
+constexpr size_t MAX_DRAWGROUP_COMMAND_COUNT = MAX_DRAWGROUP_MESH_COUNT * MAX_LOD_COUNT;
+
+/// @brief Where a culling phase's part of the command buffer starts, in bytes
+constexpr size_t command_phase_offset(uint32_t phase) { return phase * MAX_DRAWGROUP_COMMAND_COUNT * sizeof(VkDrawIndexedIndirectCommand); }
+/// @brief Where a culling phase's part of the cull counter buffer starts, in bytes
+constexpr size_t counter_phase_offset(uint32_t phase) { return phase * (1 + MAX_DRAWGROUP_COMMAND_COUNT) * sizeof(uint32_t); }
+/// @brief Where a culling phase's part of the visible instance buffer starts, in bytes, every level of a draw has room for all of its instances
+constexpr size_t visible_instance_phase_offset(uint32_t phase) { return phase * MAX_DRAWGROUP_INSTANCE_COUNT * MAX_LOD_COUNT * sizeof(uint32_t); }
+
+/// @brief A run of consecutive instances in a @ref DrawGroup instance buffer, in instances rather than bytes
+struct InstanceRange {
+	std::uint32_t first;
+	std::uint32_t count;
+};
+
+/// @brief What the render thread needs of a @ref DrawGroup for one frame, filled in by @ref DrawGroup::extract_frame on the simulation thread
+struct DrawGroupSnapshot {
+	/// @brief The merged dirty ranges of the instance buffer, sorted and not overlapping
+	std::vector<InstanceRange> instance_ranges;
+	/// @brief The data of every range in @c instance_ranges, packed one after another
+	std::vector<meshRenderer::PerInstanceData> instance_data;
+	/// @brief The number of draws before culling, at most this many times @c MAX_LOD_COUNT commands are drawn
+	uint32_t draw_count = 0;
+	/// @brief The number of placed instances in the instance buffer, the culling pass tests each of them
+	uint32_t instance_count = 0;
+
+	/// @brief Only filled in with @c CullingMode::CPU, the visible instances of every draw packed one draw after another
+	std::vector<uint32_t> visible_instances;
+	/// @brief Only filled in with @c CullingMode::CPU, one command per level of each draw with any visible instances, indexing @c visible_instances
+	std::vector<VkDrawIndexedIndirectCommand> visible_commands;
+};
 
 /**
  * @brief DrawGroups act as low-level abstractions to help with aggrgating buffers and indirect rendering
@@ -19,6 +54,11 @@ constexpr size_t MAX_DRAWGROUP_MESH_COUNT = 1024;
  * Each buffer owns a @c daxa::RasterPipeline this is the main determiner in whether to put a mesh into a @c DrawGroup
  * DrawGroups also store references to the aggrgate task buffers and buffer ids for the verticies, indicies, instances and indirect draw commands, the actual offsets are stored in @DrawableMesh
  * The buffers except for the instance and command buffers have a fixed size so to load data after you already called @c uploadBuffers you need to call @c reuploadBuffers
+ * The instance buffer is device-local, changed instances are passed to @c update_instances and uploaded once per frame as merged ranges by @ref Renderer::upload_instance_data_task
+ * The command buffer is written on the GPU each frame by @ref Renderer::cull_task from @c cullDrawInfos, only the visible instances of each draw are drawn and draws with none are left out
+ * The command, cull counter and visible instance buffers are split into one part per culling phase (@c CULL_PHASE_COUNT), see @c command_phase_offset and the others
+ * Every mesh's levels of detail (@ref DrawableMesh::lods) are stored one after another in the index buffer, culling picks one per instance and each level of a draw gets its own command
+ * Static instances (see @ref DrawableMesh::set_instance_static) are packed into a region at the front of the instance buffer that is only written by @c uploadBuffers, each mesh gets one indirect draw for its static instances and one for its dynamic ones
  * 
  * @note reuploadBuffers, reallocBuffers (an internal function) have not been implemented yet and the ability to add more instances on the go as well as defragment the instance buffers also need to be added
  * 
@@ -38,17 +78,50 @@ struct DrawGroup {
 	daxa::BufferId instance_buffer_id;
 	daxa::BufferId command_buffer_id;
 
+	// Culling buffers, see Renderer::cull_task
+	daxa::BufferId draw_info_buffer_id;
+	daxa::BufferId instance_draw_buffer_id;
+	daxa::BufferId visible_instance_buffer_id;
+	daxa::BufferId cull_counter_buffer_id;
+	daxa::BufferId visibility_history_buffer_id;
+
 	daxa::TaskBuffer task_vertex_buffer;
 	daxa::TaskBuffer task_index_buffer;
 	daxa::TaskBuffer task_instance_buffer;
 	daxa::TaskBuffer task_command_buffer;
 
+	daxa::TaskBuffer task_draw_info_buffer;
+	daxa::TaskBuffer task_instance_draw_buffer;
+	daxa::TaskBuffer task_visible_instance_buffer;
+	daxa::TaskBuffer task_cull_counter_buffer;
+	daxa::TaskBuffer task_visibility_history_buffer;
+
 	/// @brief @c indirectCommands is stored in @c DrawGroup and not the other buffers because @c indirectCommands is the actual @c VkDrawIndexedIndirectCommands
+	/// @note These are every draw before culling at its finest level, the command buffer itself only holds the ones that survived it at the levels they were picked at
 	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
+	/// @brief @c indirectCommands with the bounds of their mesh, the input of the culling pass
+	std::vector<meshRenderer::CullDrawInfo> cullDrawInfos;
+	/// @brief The index in @c indirectCommands of the draw each instance in the instance buffer belongs to
+	std::vector<uint32_t> instanceDraws;
+
+	/// @brief The world space box of each instance in the instance buffer, kept up to date by @c update_instances for @c cull_frame
+	WorldAABBs world_aabbs;
+	/// @brief The result of the last @c cull_frame, one entry per instance
+	std::vector<std::uint8_t> instance_visibility;
+	/// @brief The level each visible instance was drawn at by the last @c cull_frame
+	std::vector<std::uint8_t> instance_lods;
 
 	uint32_t total_vertex_count = 0;
 	uint32_t total_index_count = 0;
 
+	/// @brief The instance buffer's static region is @c [0, static_instance_count)
+	uint32_t static_instance_count = 0;
+
+	/// @brief CPU copy of the instance buffer, the dirty ranges are uploaded from here so they always hold the latest data even if the mesh changed again
+	std::vector<meshRenderer::PerInstanceData> cpu_instance_data;
+	/// @brief Ranges of @c cpu_instance_data that changed since the last upload, they can overlap and are only merged when uploading
+	std::vector<InstanceRange> dirty_instance_ranges;
+
 	DrawGroup(daxa::Device& device, const std::shared_ptr<daxa::RasterPipeline> &pipeline, std::string name) 
 		:device(device), pipeline(pipeline), name(name) {};
 	void cleanup();
@@ -77,21 +150,44 @@ struct DrawGroup {
 	inline void uploadBuffers(daxa::TaskGraph& tg) {
  		std::vector<meshRenderer::Vertex> vertexStagingArr;
 		std::vector<uint32_t> indexStagingArr;
-		std::vector<meshRenderer::PerInstanceData> instanceStagingArr;
 
-		loadBufferInfo(vertexStagingArr, indexStagingArr, instanceStagingArr);
+		loadBufferInfo(vertexStagingArr, indexStagingArr, cpu_instance_data);
 		allocBuffers();
 
 		tg.use_persistent_buffer(task_vertex_buffer);
 		tg.use_persistent_buffer(task_index_buffer);
-		tg.use_persistent_buffer(task_command_buffer);
 		tg.use_persistent_buffer(task_instance_buffer);
+		tg.use_persistent_buffer(task_draw_info_buffer);
+		tg.use_persistent_buffer(task_instance_draw_buffer);
+		tg.use_persistent_buffer(task_visibility_history_buffer);
 
-		uploadBufferData(tg, vertexStagingArr, indexStagingArr, instanceStagingArr);
+		uploadBufferData(tg, vertexStagingArr, indexStagingArr, cpu_instance_data);
 	}
 
 	inline void register_mesh(std::weak_ptr<DrawableMesh> drawableMesh, daxa::TaskGraph loop_task_graph);
 
+	/// @brief Copies @c count instances of @c mesh from its @c instance_data and marks them for upload next frame
+	/// @param first_instance The index of the first instance inside the mesh, not the instance buffer
+	/// @note Static instances and instances added to the mesh after @c uploadBuffers (which don't have a place in the instance buffer yet) are ignored
+	void update_instances(const DrawableMesh& mesh, std::uint32_t first_instance, std::uint32_t count);
+
+	/// @brief Moves the dirty instance ranges and their data into @c snapshot, adjacent and overlapping ranges are merged so each becomes a single copy
+	/// @note Called on the simulation thread, after it the snapshot is all the render thread reads so the simulation can keep changing @c cpu_instance_data
+	void extract_frame(DrawGroupSnapshot& snapshot);
+
+	/// @brief Queues every placed instance of the meshes with an occluder proxy (see @ref DrawableMesh::make_occluder) for @c occlusion_buffer's next rasterization
+	void add_occluders(SoftwareOcclusionBuffer& occlusion_buffer) const;
+
+	/// @brief Frustum and occlusion culls every instance on the CPU, picks the visible ones' levels of detail and writes their commands into @c snapshot, the CPU alternative to @ref Renderer::cull_task
+	/// @param frustum The frustum of @c camera
+	/// @param occlusion_buffer Already rasterized with the occluders of every @ref DrawGroup for @c camera
+	/// @note Called on the simulation thread after @c extract_frame
+	void cull_frame(const Frustum& frustum, const Camera& camera, const SoftwareOcclusionBuffer& occlusion_buffer, DrawGroupSnapshot& snapshot);
+
+	/// @brief Records the copies of every instance range of @c snapshot into the instance buffer through one staging buffer
+	/// @param ti The interface of a task with @c task_instance_buffer attached as @c TRANSFER_WRITE, see @ref Renderer::upload_instance_data_task
+	void record_instance_uploads(const daxa::TaskInterface& ti, const DrawGroupSnapshot& snapshot) const;
+
 private:
 
 };
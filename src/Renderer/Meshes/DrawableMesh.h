@@ -6,6 +6,9 @@
 #include <daxa/utils/task_graph.hpp>
 
 #include "Tools/Model_loader.h"
+#include "Renderer/Culling/OccluderProxy.h"
+
+#include <optional>
 
 constexpr size_t MAX_INSTANCE_COUNT = 1024;
 
@@ -27,22 +30,66 @@ struct DrawableMesh {
 
     std::uint32_t vertex_offset;
     std::uint32_t index_offset;
+    /// @brief Where the mesh's dynamic instances start in the @ref DrawGroup instance buffer
     std::uint32_t instance_offset;
+    /// @brief Where the mesh's static instances start in the @ref DrawGroup instance buffer, inside its static region
+    std::uint32_t static_instance_offset = 0;
+    std::uint32_t static_instance_count = 0;
 
     std::vector<meshRenderer::Vertex> verticies;
+    /// @brief The indices of every level in @c lods, @c index_count is their total
     std::vector<uint32_t> indicies;
+    /// @brief The mesh's levels of detail as ranges of @c indicies, the first is the full mesh, see @ref build_lod_chain
+    std::vector<MeshLodRange> lods;
 
+    /// @brief The position of each instance in the @ref DrawGroup instance buffer, static and dynamic instances are stored in separate regions so these aren't contiguous
     std::vector<std::uint32_t> instance_data_offsets;
+    /// @brief Instances marked with @c set_instance_static, missing entries are dynamic
+    std::vector<bool> static_instances;
 
     size_t drawGroupIndex;
 
     std::uint32_t vertex_count;
     std::uint32_t index_count;
 
+    /// @brief The mesh's bounds in its local space, used to frustum cull its instances
+    daxa_f32vec3 aabb_min = { 0.0f, 0.0f, 0.0f };
+    daxa_f32vec3 aabb_max = { 0.0f, 0.0f, 0.0f };
+
     std::vector<meshRenderer::PerInstanceData> instance_data;
 
+    /// @brief Set by @c make_occluder, every instance of an occluder is drawn into the @ref SoftwareOcclusionBuffer with @c CullingMode::CPU
+    std::optional<OccluderProxy> occluder_proxy;
+
     std::string name;
 
+    /// @brief Marks an instance as never moving, it has to be marked before @ref DrawGroup::uploadBuffers to be placed in the static region
+    void set_instance_static(std::uint32_t instance, bool is_static) {
+        if (instance >= static_instances.size())
+            static_instances.resize(instance + 1, false);
+        static_instances[instance] = is_static;
+    }
+
+    bool is_instance_static(std::uint32_t instance) const {
+        return instance < static_instances.size() && static_instances[instance];
+    }
+
+    /**
+     * @brief Designates the mesh as an occluder by building its low poly proxy (see @ref build_occluder_proxy)
+     *
+     * Only large, solid meshes such as walls and floors make good occluders, each one adds its proxy's triangles to every frame's rasterization
+     * @param max_triangles How many of the mesh's largest triangles the proxy keeps
+     */
+    void make_occluder(std::uint32_t max_triangles = OCCLUDER_PROXY_MAX_TRIANGLES) {
+        std::vector<glm::vec3> positions;
+        positions.reserve(verticies.size());
+        for (const meshRenderer::Vertex& vertex : verticies)
+            positions.push_back(to_glm(vertex.position));
+
+        const std::span<const uint32_t> full_mesh = std::span<const uint32_t>(indicies).subspan(lods[0].firstIndex, lods[0].indexCount);
+        occluder_proxy = build_occluder_proxy(positions, full_mesh, max_triangles);
+    }
+
     /// @brief moves the vertex and index data of @c parsedPrimitive using @c std::move into the atual @c DrawableMesh
     /// @param parsedPrimitive The @ref ParsedPrimitive that comes from the model loader
     /// @param name The debug name that will be used to create the names for the tasks and buffers for daxa
@@ -53,5 +100,11 @@ struct DrawableMesh {
 
         verticies = std::move(parsedPrimitive.vertices);
         indicies = std::move(parsedPrimitive.indices);
+        lods = std::move(parsedPrimitive.lods);
+        if (lods.empty())
+            lods.push_back({ 0, index_count, 0.0f });
+
+        aabb_min = parsedPrimitive.aabbMin;
+        aabb_max = parsedPrimitive.aabbMax;
     }
 };
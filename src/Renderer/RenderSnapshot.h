@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Renderer/Meshes/DrawGroup.h"
+#include "Core/Camera.h"
+
+#include <imgui.h>
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Everything the render thread reads to draw a frame, extracted from the simulation state at the end of the simulation's frame
+ *
+ * Once published the simulation doesn't touch it until the render thread is done with it, so the simulation of the next frame never races the recording of this one
+ */
+struct RenderSnapshot {
+    Camera camera;
+    float aspect_ratio = 1.0f;
+    /// @brief Set when the window was resized since the last snapshot
+    bool swapchain_out_of_date = false;
+
+    /// @brief One per @ref DrawGroup, indexed by @ref DrawGroup::drawGroupIndex
+    std::vector<DrawGroupSnapshot> draw_groups;
+
+    /// @brief A copy of the ImGui draw data, ImGui's own is overwritten by the next @c ImGui::Render
+    ImDrawData imgui_draw_data;
+
+    RenderSnapshot() = default;
+    RenderSnapshot(const RenderSnapshot&) = delete;
+    RenderSnapshot& operator=(const RenderSnapshot&) = delete;
+    ~RenderSnapshot() { clear_imgui_draw_data(); }
+
+    /// @brief Deep copies @c draw_data, @c nullptr (no ImGui frame) leaves an empty draw data
+    void copy_imgui_draw_data(const ImDrawData* draw_data) {
+        clear_imgui_draw_data();
+        if (draw_data == nullptr || !draw_data->Valid)
+            return;
+
+        imgui_draw_data = *draw_data;
+        imgui_draw_data.CmdLists.clear();
+        for (ImDrawList* draw_list : draw_data->CmdLists)
+            imgui_draw_data.CmdLists.push_back(draw_list->CloneOutput());
+    }
+
+private:
+    void clear_imgui_draw_data() {
+        for (ImDrawList* draw_list : imgui_draw_data.CmdLists)
+            IM_DELETE(draw_list);
+        imgui_draw_data.Clear();
+    }
+};
+
+/**
+ * @brief Two @ref RenderSnapshot "RenderSnapshots" handed back and forth between the simulation thread and the render thread
+ *
+ * The simulation fills one while the render thread draws the other, every snapshot is drawn exactly once and in order since the instance data in them only holds what changed
+ * If either thread gets a frame ahead it waits for the other, so the simulation is never more than one frame ahead of what is being recorded
+ */
+class RenderSnapshotQueue {
+public:
+    /// @brief Waits until the render thread is done with the next snapshot and returns it for filling
+    RenderSnapshot& begin_write() {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this] { return !ready[write_index]; });
+        return snapshots[write_index];
+    }
+
+    /// @brief Hands the snapshot returned by @c begin_write to the render thread
+    void publish() {
+        {
+            std::lock_guard lock(mutex);
+            ready[write_index] = true;
+            write_index ^= 1;
+        }
+        condition.notify_all();
+    }
+
+    /// @brief Waits for the next published snapshot
+    /// @return @c nullptr once the queue is closed and every published snapshot has been drawn
+    const RenderSnapshot* acquire() {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this] { return ready[read_index] || closed; });
+        return ready[read_index] ? &snapshots[read_index] : nullptr;
+    }
+
+    /// @brief Gives the snapshot returned by @c acquire back to the simulation thread
+    void release() {
+        {
+            std::lock_guard lock(mutex);
+            ready[read_index] = false;
+            read_index ^= 1;
+        }
+        condition.notify_all();
+    }
+
+    /// @brief Makes @c acquire return @c nullptr once the render thread has caught up
+    void close() {
+        {
+            std::lock_guard lock(mutex);
+            closed = true;
+        }
+        condition.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    std::array<RenderSnapshot, 2> snapshots;
+    /// @brief A snapshot is ready from when it is published until the render thread releases it
+    std::array<bool, 2> ready{};
+    std::size_t write_index = 0;
+    std::size_t read_index = 0;
+    bool closed = false;
+};
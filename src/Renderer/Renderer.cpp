@@ -1,5 +1,11 @@
 #include "Renderer.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
 meshRenderer::UniformBufferObject ubo{
         .view = to_daxa(glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f),
                                     glm::vec3(0.0f, 0.0f, 0.0f),
@@ -80,25 +86,255 @@ void Renderer::draw_skybox_task() {
 
             ti.recorder = std::move(render_recorder).end_renderpass();
 
-            imguiRenderer.record_commands(ImGui::GetDrawData(), ti.recorder, ti.get(task_swapchain_image).ids[0], size.x, size.y);
+            imguiRenderer.record_commands(&current_snapshot->imgui_draw_data, ti.recorder, ti.get(task_swapchain_image).ids[0], size.x, size.y);
         },
         .name = "draw skybox",
     });
 }
 
-void Renderer::draw_mesh_task() {
+void Renderer::upload_instance_data_task() {
     std::vector<daxa::TaskAttachmentInfo> attachments;
 
     for (auto& drawGroup : drawGroups) {
-        loop_task_graph.use_persistent_buffer(drawGroup.task_vertex_buffer);
-        loop_task_graph.use_persistent_buffer(drawGroup.task_index_buffer);
-        loop_task_graph.use_persistent_buffer(drawGroup.task_command_buffer);
         loop_task_graph.use_persistent_buffer(drawGroup.task_instance_buffer);
+        attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, drawGroup.task_instance_buffer));
+    }
+
+    loop_task_graph.add_task({
+        .attachments = attachments,
+        .task = [&](const daxa::TaskInterface& ti) {
+            for (auto& drawGroup : drawGroups)
+                drawGroup.record_instance_uploads(ti, current_snapshot->draw_groups[drawGroup.drawGroupIndex]);
+        },
+        .name = "upload instance data",
+    });
+}
+
+void Renderer::cull_task(daxa::u32 phase) {
+    if constexpr (CULLING_MODE == CullingMode::CPU) {
+        // publish_snapshot already culled against this frame's occluders, rasterized in software, so nothing was culled against last frame's depth for a late phase to retest
+        if (phase != CULL_PHASE_EARLY)
+            return;
+
+        std::vector<daxa::TaskAttachmentInfo> attachments;
+        for (auto& drawGroup : drawGroups) {
+            loop_task_graph.use_persistent_buffer(drawGroup.task_visible_instance_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_cull_counter_buffer);
+
+            attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, drawGroup.task_visible_instance_buffer));
+            attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, drawGroup.task_command_buffer));
+            attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, drawGroup.task_cull_counter_buffer));
+        }
+
+        loop_task_graph.add_task({
+            .attachments = attachments,
+            .task = [&](const daxa::TaskInterface& ti) {
+                for (auto& drawGroup : drawGroups) {
+                    const DrawGroupSnapshot& snapshot = current_snapshot->draw_groups[drawGroup.drawGroupIndex];
+                    const std::size_t instances_size = snapshot.visible_instances.size() * sizeof(uint32_t);
+                    const std::size_t commands_size = snapshot.visible_commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+                    // The draw count, the commands and the visible list one after another in one staging buffer
+                    auto cull_staging = ti.device.create_buffer({
+                        .size = sizeof(uint32_t) + commands_size + instances_size,
+                        .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+                        .name = drawGroup.name + " cull staging buffer",
+                    });
+                    ti.recorder.destroy_buffer_deferred(cull_staging);
+                    auto* staging_ptr = ti.device.buffer_host_address_as<std::byte>(cull_staging).value();
+
+                    const auto draw_count = static_cast<uint32_t>(snapshot.visible_commands.size());
+                    std::memcpy(staging_ptr, &draw_count, sizeof(uint32_t));
+                    std::memcpy(staging_ptr + sizeof(uint32_t), snapshot.visible_commands.data(), commands_size);
+                    std::memcpy(staging_ptr + sizeof(uint32_t) + commands_size, snapshot.visible_instances.data(), instances_size);
+
+                    ti.recorder.copy_buffer_to_buffer({
+                        .src_buffer = cull_staging,
+                        .dst_buffer = ti.get(drawGroup.task_cull_counter_buffer).ids[0],
+                        .size = sizeof(uint32_t),
+                    });
+                    if (commands_size > 0) {
+                        ti.recorder.copy_buffer_to_buffer({
+                            .src_buffer = cull_staging,
+                            .dst_buffer = ti.get(drawGroup.task_command_buffer).ids[0],
+                            .src_offset = sizeof(uint32_t),
+                            .size = commands_size,
+                        });
+                        ti.recorder.copy_buffer_to_buffer({
+                            .src_buffer = cull_staging,
+                            .dst_buffer = ti.get(drawGroup.task_visible_instance_buffer).ids[0],
+                            .src_offset = sizeof(uint32_t) + commands_size,
+                            .size = instances_size,
+                        });
+                    }
+                }
+            },
+            .name = "upload culled draws",
+        });
+        return;
+    }
+
+    std::vector<daxa::TaskAttachmentInfo> counter_attachments;
+    std::vector<daxa::TaskAttachmentInfo> instance_attachments;
+    std::vector<daxa::TaskAttachmentInfo> command_attachments;
+
+    for (auto& drawGroup : drawGroups) {
+        if (phase == CULL_PHASE_EARLY) {
+            loop_task_graph.use_persistent_buffer(drawGroup.task_draw_info_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_instance_draw_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_visible_instance_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_cull_counter_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_visibility_history_buffer);
+        }
+
+        counter_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::TRANSFER_WRITE, drawGroup.task_cull_counter_buffer));
+
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ, drawGroup.task_instance_buffer));
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ, drawGroup.task_draw_info_buffer));
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ, drawGroup.task_instance_draw_buffer));
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE, drawGroup.task_cull_counter_buffer));
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_WRITE, drawGroup.task_visible_instance_buffer));
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE, drawGroup.task_visibility_history_buffer));
+
+        command_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ, drawGroup.task_draw_info_buffer));
+        command_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE, drawGroup.task_cull_counter_buffer));
+        command_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_WRITE, drawGroup.task_command_buffer));
+    }
+    instance_attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::COMPUTE_SHADER_READ, task_mesh_uniform_buffer));
+    if (phase == CULL_PHASE_LATE)
+        instance_attachments.push_back(daxa::inl_attachment(daxa::TaskImageAccess::COMPUTE_SHADER_SAMPLED, daxa::ImageViewType::REGULAR_2D, task_depth_pyramid.view().mips(0, DEPTH_PYRAMID_MIP_COUNT)));
+
+    // Builds the push constant of either dispatch for a draw group, pointing at this phase's part of the buffers
+    auto cull_push_constant = [this, phase](const daxa::TaskInterface& ti, const DrawGroup& drawGroup, daxa::u32 pass, daxa::u32 count) {
+        return meshRenderer::CullPushConstant{
+            .ubo_ptr = ti.device.device_address(mesh_uniform_buffer_id).value(),
+            .instance_buffer_ptr = ti.device.device_address(drawGroup.instance_buffer_id).value(),
+            .draw_info_ptr = ti.device.device_address(drawGroup.draw_info_buffer_id).value(),
+            .instance_draw_ptr = ti.device.device_address(drawGroup.instance_draw_buffer_id).value(),
+            .counter_ptr = ti.device.device_address(drawGroup.cull_counter_buffer_id).value() + counter_phase_offset(phase),
+            .visible_instance_ptr = ti.device.device_address(drawGroup.visible_instance_buffer_id).value() + visible_instance_phase_offset(phase),
+            .command_ptr = ti.device.device_address(drawGroup.command_buffer_id).value() + command_phase_offset(phase),
+            .visibility_history_ptr = ti.device.device_address(drawGroup.visibility_history_buffer_id).value(),
+            .count = count,
+            .pass = pass,
+            .phase = phase,
+            .depth_pyramid = depth_pyramid_id.default_view(),
+            .depth_sampler = depth_sampler,
+            .depth_pyramid_size = depth_pyramid_size,
+        };
+    };
+
+    // Both phases' counters are reset at once before the early phase
+    if (phase == CULL_PHASE_EARLY) {
+        loop_task_graph.add_task({
+            .attachments = counter_attachments,
+            .task = [&](const daxa::TaskInterface& ti) {
+                for (auto& drawGroup : drawGroups) {
+                    ti.recorder.clear_buffer({
+                        .buffer = ti.get(drawGroup.task_cull_counter_buffer).ids[0],
+                        .offset = 0,
+                        .size = counter_phase_offset(CULL_PHASE_COUNT),
+                        .clear_value = 0,
+                    });
+                }
+            },
+            .name = "reset cull counters",
+        });
+    }
+
+    const std::string phase_name = phase == CULL_PHASE_EARLY ? "early" : "late";
+
+    loop_task_graph.add_task({
+        .attachments = instance_attachments,
+        .task = [=, this](const daxa::TaskInterface& ti) {
+            ti.recorder.set_pipeline(*cull_pipeline);
+            for (auto& drawGroup : drawGroups) {
+                const daxa::u32 instance_count = current_snapshot->draw_groups[drawGroup.drawGroupIndex].instance_count;
+                if (instance_count == 0)
+                    continue;
+                ti.recorder.push_constant(cull_push_constant(ti, drawGroup, CULL_PASS_INSTANCES, instance_count));
+                ti.recorder.dispatch({ .x = (instance_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE });
+            }
+        },
+        .name = "cull instances " + phase_name,
+    });
+
+    loop_task_graph.add_task({
+        .attachments = command_attachments,
+        .task = [=, this](const daxa::TaskInterface& ti) {
+            ti.recorder.set_pipeline(*cull_pipeline);
+            for (auto& drawGroup : drawGroups) {
+                // One thread per level of each draw
+                const daxa::u32 command_count = current_snapshot->draw_groups[drawGroup.drawGroupIndex].draw_count * MAX_LOD_COUNT;
+                if (command_count == 0)
+                    continue;
+                ti.recorder.push_constant(cull_push_constant(ti, drawGroup, CULL_PASS_COMMANDS, command_count));
+                ti.recorder.dispatch({ .x = (command_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE });
+            }
+        },
+        .name = "write draw commands " + phase_name,
+    });
+}
+
+void Renderer::depth_pyramid_task() {
+    loop_task_graph.use_persistent_image(task_depth_pyramid);
+
+    loop_task_graph.add_task({
+        .attachments = {
+            daxa::inl_attachment(daxa::TaskImageAccess::COMPUTE_SHADER_SAMPLED, daxa::ImageViewType::REGULAR_2D, task_z_buffer),
+            daxa::inl_attachment(daxa::TaskImageAccess::COMPUTE_SHADER_STORAGE_READ_WRITE, daxa::ImageViewType::REGULAR_2D, task_depth_pyramid.view().mips(0, DEPTH_PYRAMID_MIP_COUNT)),
+        },
+        .task = [&](const daxa::TaskInterface& ti) {
+            const auto z_buffer_size = ti.device.info(ti.get(task_z_buffer).ids[0]).value().size;
+            ti.recorder.set_pipeline(*depth_pyramid_pipeline);
+
+            daxa_u32vec2 src_size = { z_buffer_size.x, z_buffer_size.y };
+            for (daxa::u32 level = 0; level < DEPTH_PYRAMID_MIP_COUNT; level++) {
+                const daxa_u32vec2 dst_size = { std::max(depth_pyramid_size.x >> level, 1u), std::max(depth_pyramid_size.y >> level, 1u) };
+
+                // Each level reads the one written by the dispatch before it
+                if (level > 0) {
+                    ti.recorder.pipeline_barrier({
+                        .src_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                        .dst_access = daxa::AccessConsts::COMPUTE_SHADER_READ,
+                    });
+                }
+
+                ti.recorder.push_constant(meshRenderer::DepthPyramidPushConstant{
+                    .src = level == 0 ? z_buffer_id.default_view() : depth_pyramid_mip_views[level - 1],
+                    .dst = depth_pyramid_mip_views[level],
+                    .depth_sampler = depth_sampler,
+                    .src_size = src_size,
+                    .dst_size = dst_size,
+                    .from_depth = level == 0 ? 1u : 0u,
+                });
+                ti.recorder.dispatch({
+                    .x = (dst_size.x + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+                    .y = (dst_size.y + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+                });
+                src_size = dst_size;
+            }
+        },
+        .name = "build depth pyramid",
+    });
+}
+
+void Renderer::draw_mesh_task(daxa::u32 phase) {
+    std::vector<daxa::TaskAttachmentInfo> attachments;
+
+    for (auto& drawGroup : drawGroups) {
+        // The instance buffer is already used by upload_instance_data_task and the culling buffers by cull_task
+        if (phase == CULL_PHASE_EARLY) {
+            loop_task_graph.use_persistent_buffer(drawGroup.task_vertex_buffer);
+            loop_task_graph.use_persistent_buffer(drawGroup.task_index_buffer);
+        }
 
         // Add each drawable's vertex/index/instance buffers
         attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::VERTEX_SHADER_READ, drawGroup.task_vertex_buffer));
         attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::VERTEX_SHADER_READ, drawGroup.task_instance_buffer));
-        attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::INDEX_READ, drawGroup.task_command_buffer));
+        attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::VERTEX_SHADER_READ, drawGroup.task_visible_instance_buffer));
+        attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::DRAW_INDIRECT_INFO_READ, drawGroup.task_command_buffer));
+        attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::DRAW_INDIRECT_INFO_READ, drawGroup.task_cull_counter_buffer));
         attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::INDEX_READ, drawGroup.task_index_buffer));
     }
 
@@ -106,10 +342,13 @@ void Renderer::draw_mesh_task() {
     attachments.push_back(daxa::inl_attachment(daxa::TaskBufferAccess::VERTEX_SHADER_READ, task_mesh_uniform_buffer));
     attachments.push_back(daxa::inl_attachment(daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageViewType::REGULAR_2D, task_swapchain_image));
     attachments.push_back(daxa::inl_attachment(daxa::TaskImageAccess::DEPTH_ATTACHMENT, daxa::ImageViewType::REGULAR_2D, task_z_buffer));
-    
+
+    // ImGui goes on top of the last draw of the frame
+    const bool is_last_phase = CULLING_MODE == CullingMode::CPU || phase == CULL_PHASE_LATE;
+
     loop_task_graph.add_task({
         .attachments = attachments,
-        .task = [&](const daxa::TaskInterface& ti) {
+        .task = [=, this](const daxa::TaskInterface& ti) {
             auto const size = ti.device.info(ti.get(task_swapchain_image).ids[0]).value().size;
             daxa::RenderCommandRecorder render_recorder = std::move(ti.recorder).begin_renderpass({
                 .color_attachments = std::array{
@@ -140,12 +379,16 @@ void Renderer::draw_mesh_task() {
                     .vertex_ptr = ti.device.device_address(ti.get(drawGroup.task_vertex_buffer).ids[0]).value(),
                     .ubo_ptr = ti.device.device_address(ti.get(task_mesh_uniform_buffer).ids[0]).value(),
                     .instance_buffer_ptr = ti.device.device_address(ti.get(drawGroup.task_instance_buffer).ids[0]).value(),
+                    .visible_instance_ptr = ti.device.device_address(ti.get(drawGroup.task_visible_instance_buffer).ids[0]).value() + visible_instance_phase_offset(phase),
                 });
 
-                render_recorder.draw_indirect({
-                    .draw_command_buffer = ti.get(drawGroup.task_command_buffer).ids[0],
-                    .indirect_buffer_offset = 0,
-                    .draw_count = static_cast<uint32_t>(drawGroup.meshes.size()),
+                // The number of commands is the first counter written by the culling pass
+                render_recorder.draw_indirect_count({
+                    .indirect_buffer = ti.get(drawGroup.task_command_buffer).ids[0],
+                    .indirect_buffer_offset = command_phase_offset(phase),
+                    .count_buffer = ti.get(drawGroup.task_cull_counter_buffer).ids[0],
+                    .count_buffer_offset = counter_phase_offset(phase),
+                    .max_draw_count = current_snapshot->draw_groups[drawGroup.drawGroupIndex].draw_count * MAX_LOD_COUNT,
                     .draw_command_stride = sizeof(VkDrawIndexedIndirectCommand),
                     .is_indexed = true
                 });
@@ -153,9 +396,10 @@ void Renderer::draw_mesh_task() {
 
             ti.recorder = std::move(render_recorder).end_renderpass();
 
-            imguiRenderer.record_commands(ImGui::GetDrawData(), ti.recorder, ti.get(task_swapchain_image).ids[0], size.x, size.y);
+            if (is_last_phase)
+                imguiRenderer.record_commands(&current_snapshot->imgui_draw_data, ti.recorder, ti.get(task_swapchain_image).ids[0], size.x, size.y);
         },
-        .name = "draw mesh",
+        .name = phase == CULL_PHASE_EARLY ? "draw mesh early" : "draw mesh late",
     });
 }
 
@@ -164,6 +408,12 @@ void Renderer::update_mesh_uniform_buffer(const daxa::Device& device, const daxa
     ubo.view = to_daxa(camera.get_view_matrix());
     ubo.proj = to_daxa(camera.get_projection(aspect_ratio));
 
+    const Frustum frustum = Frustum::from_camera(camera, aspect_ratio);
+    for (std::size_t i = 0; i < frustum.planes.size(); i++)
+        ubo.frustum_planes[i] = { frustum.planes[i].x, frustum.planes[i].y, frustum.planes[i].z, frustum.planes[i].w };
+    ubo.camera_position = { camera.position.x, camera.position.y, camera.position.z };
+    ubo.lod_error_scale = lod_error_scale(camera);
+
     auto* ptr = device.buffer_host_address_as<meshRenderer::UniformBufferObject>(uniform_buffer_id).value();
     *ptr = ubo;
 }
@@ -229,7 +479,7 @@ void Renderer::init() {
     z_buffer_id = device.create_image({
         .format = daxa::Format::D32_SFLOAT,
         .size = {size.x, size.y, 1},
-        .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT,
+        .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_SAMPLED,
         .name = "z-buffer",
     });
 
@@ -238,6 +488,16 @@ void Renderer::init() {
         .name = "task depth image",
     });
 
+    depth_sampler = device.create_sampler({
+        .magnification_filter = daxa::Filter::NEAREST,
+        .minification_filter = daxa::Filter::NEAREST,
+        .mipmap_filter = daxa::Filter::NEAREST,
+        .name = "depth sampler",
+    });
+
+    task_depth_pyramid = daxa::TaskImage({ .name = "task depth pyramid" });
+    create_depth_pyramid();
+
     task_swapchain_image = daxa::TaskImage{ {.swapchain_image = true, .name = "swapchain image"} };
 
     loop_task_graph.use_persistent_buffer(task_mesh_uniform_buffer);
@@ -245,6 +505,36 @@ void Renderer::init() {
     loop_task_graph.use_persistent_image(task_z_buffer);
     loop_task_graph.use_persistent_image(task_swapchain_image);
 
+    if constexpr (CULLING_MODE == CullingMode::GPU) {
+        auto result = pipeline_manager.add_compute_pipeline2({
+            .source = daxa::ShaderFile{"frustum_culling.comp.glsl"},
+            .defines = { {"DAXA_SHADER", "1"}, {"GLSL", "1"}},
+            .push_constant_size = sizeof(meshRenderer::CullPushConstant),
+            .name = "frustum culling",
+        });
+
+        if (result.is_err()) {
+            std::cerr << result.message() << std::endl;
+            throw std::runtime_error("Error: failed to compile the culling pipeline");
+        }
+        cull_pipeline = result.value();
+    }
+
+    if constexpr (CULLING_MODE == CullingMode::GPU) {
+        auto result = pipeline_manager.add_compute_pipeline2({
+            .source = daxa::ShaderFile{"depth_pyramid.comp.glsl"},
+            .defines = { {"DAXA_SHADER", "1"}, {"GLSL", "1"}},
+            .push_constant_size = sizeof(meshRenderer::DepthPyramidPushConstant),
+            .name = "depth pyramid",
+        });
+
+        if (result.is_err()) {
+            std::cerr << result.message() << std::endl;
+            throw std::runtime_error("Error: failed to compile the depth pyramid pipeline");
+        }
+        depth_pyramid_pipeline = result.value();
+    }
+
     if (DEBUG_WINDOW) {
         daxa::ImGuiRendererInfo imguiRendererInfo;
 
@@ -262,8 +552,16 @@ void Renderer::init() {
 }
 
 void Renderer::submit_task_graph() {
+    upload_instance_data_task();
+    cull_task(CULL_PHASE_EARLY);
     draw_skybox_task();
-    draw_mesh_task();
+    draw_mesh_task(CULL_PHASE_EARLY);
+
+    if constexpr (CULLING_MODE == CullingMode::GPU) {
+        depth_pyramid_task();
+        cull_task(CULL_PHASE_LATE);
+        draw_mesh_task(CULL_PHASE_LATE);
+    }
 
     loop_task_graph.submit({});
     // And tell the task graph to do the present step.
@@ -273,19 +571,107 @@ void Renderer::submit_task_graph() {
     loop_task_graph.complete({});
 }
 
+void Renderer::create_depth_pyramid() {
+    // Half the z-buffer, but never so small that DEPTH_PYRAMID_MIP_COUNT levels wouldn't fit
+    const auto size = swapchain.get_surface_extent();
+    depth_pyramid_size = {
+        std::max((size.x + 1) / 2, 1u << (DEPTH_PYRAMID_MIP_COUNT - 1)),
+        std::max((size.y + 1) / 2, 1u),
+    };
+
+    depth_pyramid_id = device.create_image({
+        .format = daxa::Format::R32_SFLOAT,
+        .size = {depth_pyramid_size.x, depth_pyramid_size.y, 1},
+        .mip_level_count = DEPTH_PYRAMID_MIP_COUNT,
+        .usage = daxa::ImageUsageFlagBits::SHADER_STORAGE | daxa::ImageUsageFlagBits::SHADER_SAMPLED,
+        .name = "depth pyramid",
+    });
+
+    depth_pyramid_mip_views.clear();
+    for (daxa::u32 level = 0; level < DEPTH_PYRAMID_MIP_COUNT; level++) {
+        depth_pyramid_mip_views.push_back(device.create_image_view({
+            .type = daxa::ImageViewType::REGULAR_2D,
+            .format = daxa::Format::R32_SFLOAT,
+            .image = depth_pyramid_id,
+            .slice = {.base_mip_level = level, .level_count = 1},
+            .name = "depth pyramid level " + std::to_string(level),
+        }));
+    }
+
+    task_depth_pyramid.set_images({ .images = std::span{&depth_pyramid_id, 1} });
+}
+
+void Renderer::destroy_depth_pyramid() {
+    for (daxa::ImageViewId view : depth_pyramid_mip_views)
+        device.destroy_image_view(view);
+    depth_pyramid_mip_views.clear();
+    device.destroy_image(depth_pyramid_id);
+}
+
 void Renderer::cleanup() {
     for (auto& drawGroup : drawGroups) {
         drawGroup.cleanup();
     }
     device.destroy_image(z_buffer_id);
+    destroy_depth_pyramid();
+    device.destroy_sampler(depth_sampler);
     device.destroy_buffer(mesh_uniform_buffer_id);
     device.destroy_buffer(skybox_uniform_buffer_id);
 }
 
-void Renderer::startFrame(const Camera& camera) {
-    if (window.swapchain_out_of_date) {
+void Renderer::start_render_thread() {
+    render_thread = std::thread([this] {
+        while (const RenderSnapshot* snapshot = snapshot_queue.acquire()) {
+            startFrame(*snapshot);
+            endFrame();
+            snapshot_queue.release();
+        }
+    });
+}
+
+void Renderer::stop_render_thread() {
+    snapshot_queue.close();
+    if (render_thread.joinable())
+        render_thread.join();
+}
+
+void Renderer::publish_snapshot(const Camera& camera) {
+    RenderSnapshot& snapshot = snapshot_queue.begin_write();
+
+    snapshot.camera = camera;
+    snapshot.aspect_ratio = static_cast<float>(window.width) / static_cast<float>(window.height);
+    // The resize callback runs on the main thread, so the flag is only ever read and reset here
+    snapshot.swapchain_out_of_date = window.swapchain_out_of_date;
+    window.swapchain_out_of_date = false;
+
+    snapshot.draw_groups.resize(drawGroups.size());
+    for (auto& drawGroup : drawGroups)
+        drawGroup.extract_frame(snapshot.draw_groups[drawGroup.drawGroupIndex]);
+
+    if constexpr (CULLING_MODE == CullingMode::CPU) {
+        const glm::mat4 view_proj = camera.get_projection(snapshot.aspect_ratio) * camera.get_view_matrix();
+        const Frustum frustum = Frustum::from_view_proj(view_proj);
+
+        // Every group's occluders can hide every group's instances, so all of them are rasterized before any group is culled
+        occlusion_buffer.begin_frame(view_proj);
+        for (const auto& drawGroup : drawGroups)
+            drawGroup.add_occluders(occlusion_buffer);
+        occlusion_buffer.rasterize();
+
+        for (auto& drawGroup : drawGroups)
+            drawGroup.cull_frame(frustum, camera, occlusion_buffer, snapshot.draw_groups[drawGroup.drawGroupIndex]);
+    }
+
+    snapshot.copy_imgui_draw_data(DEBUG_WINDOW ? ImGui::GetDrawData() : nullptr);
+
+    snapshot_queue.publish();
+}
+
+void Renderer::startFrame(const RenderSnapshot& snapshot) {
+    current_snapshot = &snapshot;
+
+    if (snapshot.swapchain_out_of_date) {
         swapchain.resize();
-        window.swapchain_out_of_date = false;
 
         // Recreate our buffers
         device.destroy_image(z_buffer_id);
@@ -293,15 +679,17 @@ void Renderer::startFrame(const Camera& camera) {
         z_buffer_id = device.create_image({
             .format = daxa::Format::D32_SFLOAT,
             .size = {size.x, size.y, 1},
-            .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT,
+            .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_SAMPLED,
             .name = "z-buffer",
         });
         task_z_buffer.set_images({ .images = std::span{&z_buffer_id, 1} });
+
+        destroy_depth_pyramid();
+        create_depth_pyramid();
     }
 
-    float aspect_ratio = static_cast<float>(window.width) / static_cast<float>(window.height);
-    update_mesh_uniform_buffer(device, mesh_uniform_buffer_id, camera, aspect_ratio);
-    update_skybox_uniform_buffer(device, skybox_uniform_buffer_id, camera, aspect_ratio);
+    update_mesh_uniform_buffer(device, mesh_uniform_buffer_id, snapshot.camera, snapshot.aspect_ratio);
+    update_skybox_uniform_buffer(device, skybox_uniform_buffer_id, snapshot.camera, snapshot.aspect_ratio);
 }
 
 void Renderer::endFrame() {
@@ -311,4 +699,5 @@ void Renderer::endFrame() {
 
     loop_task_graph.execute({});
     device.collect_garbage();
+    current_snapshot = nullptr;
 }
@@ -9,6 +9,10 @@
 #undef Drawable
 #include "Renderer/Meshes/DrawGroup.h"
 
+#include "Renderer/RenderSnapshot.h"
+#include "Renderer/Culling/FrustumCulling.h"
+#include "Renderer/Culling/SoftwareOcclusion.h"
+
 #include "Core/Camera.h"
 
 #include <daxa/daxa.hpp>
@@ -18,11 +22,23 @@
 #include <Daxa/utils/imgui.hpp>
 #include <imgui_impl_glfw.h>
 
+#include <thread>
+
 constexpr const char* GLOBAL_SHADER_PATH = "C:/dev/Engine_project/shaders";
 constexpr float V_FOV = 60.0f;
 
 constexpr bool DEBUG_WINDOW = true;
 
+/// @brief Where instances are frustum and occlusion culled
+enum class CullingMode {
+    /// @brief A compute pass per frame that occlusion culls against a depth pyramid of the z-buffer, see @ref Renderer::cull_task
+    GPU,
+    /// @brief On the simulation thread with SIMD while the snapshot is extracted (see @ref DrawGroup::cull_frame), the visible list and commands are uploaded instead
+    /// @note Occlusion is tested against the occluder meshes (see @ref DrawableMesh::make_occluder) rasterized by @ref SoftwareOcclusionBuffer, for GPUs the culling pass would slow down
+    CPU,
+};
+constexpr CullingMode CULLING_MODE = CullingMode::GPU;
+
 struct Renderer {
     // TODO: implement a name to prevent daxa name conflicts
     GLFW_Window::AppWindow& window;
@@ -44,16 +60,60 @@ struct Renderer {
     
     daxa::ImageId z_buffer_id;
     daxa::TaskImage task_z_buffer;
+
+    /// @brief The farthest depth of every texel of the z-buffer halved @c DEPTH_PYRAMID_MIP_COUNT times, rebuilt between the two culling phases
+    daxa::ImageId depth_pyramid_id;
+    /// @brief One storage view per level for the downsample to write
+    std::vector<daxa::ImageViewId> depth_pyramid_mip_views;
+    daxa::TaskImage task_depth_pyramid;
+    daxa_u32vec2 depth_pyramid_size;
+    daxa::SamplerId depth_sampler;
     daxa::TaskImage task_swapchain_image;
     daxa::TaskGraph loop_task_graph;
 
     daxa::ImGuiRenderer imguiRenderer;
 
+    /// @brief The frustum and occlusion culling compute pipeline, see @c cull_task
+    std::shared_ptr<daxa::ComputePipeline> cull_pipeline;
+    std::shared_ptr<daxa::ComputePipeline> depth_pyramid_pipeline;
+
+    /**
+     * @brief Frames are recorded and submitted on @c render_thread while the main thread simulates the next one
+     *
+     * The main thread hands each frame over with @c publish_snapshot, from then on the render thread only reads that @ref RenderSnapshot and the GPU resources,
+     * so the tasks of @c loop_task_graph read the frame being drawn through @c current_snapshot and never the live ECS or @ref DrawGroup state
+     */
+    RenderSnapshotQueue snapshot_queue;
+    std::thread render_thread;
+    /// @brief The snapshot being drawn, only valid on the render thread while @c loop_task_graph executes
+    const RenderSnapshot* current_snapshot = nullptr;
+
+    /// @brief The occluders of every @ref DrawGroup rasterized for the camera of the snapshot being extracted, only used with @c CullingMode::CPU
+    SoftwareOcclusionBuffer occlusion_buffer;
+
     Renderer(GLFW_Window::AppWindow& window, daxa::Device& device, daxa::Instance& instance);
 
     static void upload_uniform_buffer_task(daxa::TaskGraph& tg, daxa::TaskBufferView uniform_buffer, const meshRenderer::UniformBufferObject &ubo);
 
-    void draw_mesh_task();
+    /// @brief Adds the task that uploads every @ref DrawGroup "DrawGroup's" dirty instance ranges, runs before the draws each frame
+    void upload_instance_data_task();
+    /**
+     * @brief Adds the tasks that cull every instance on the GPU and write one culling phase's part of the command buffers of the @ref DrawGroup "DrawGroups"
+     *
+     * The first dispatch tests each instance's bounds and appends the visible ones to their draw's part of the visible instance buffer,
+     * the second writes one command per draw that has any visible instances and counts them, @c draw_mesh_task draws them with @c draw_indirect_count
+     *
+     * Occlusion culling takes two phases so it never relies on a depth buffer that is a frame old:
+     * the early phase draws what was visible last frame and is in the frustum, @c depth_pyramid_task builds the pyramid from that depth,
+     * then the late phase tests everything in the frustum against it, records what is visible for the next frame and draws what the early phase missed
+     * With @c CullingMode::CPU the culling was already done by @c publish_snapshot, the early phase only uploads its results to the same buffers and there is no late phase
+     * @param phase @c CULL_PHASE_EARLY or @c CULL_PHASE_LATE
+     */
+    void cull_task(daxa::u32 phase);
+    /// @brief Adds the task that builds the depth pyramid from the z-buffer, one dispatch per level
+    void depth_pyramid_task();
+    /// @brief Adds the task that draws the commands @c cull_task wrote for @c phase
+    void draw_mesh_task(daxa::u32 phase);
     void draw_skybox_task();
 
     void registerDrawGroup(DrawGroup&& drawGroup);
@@ -65,6 +125,19 @@ struct Renderer {
     void submit_task_graph();
     void cleanup();
 
-    void startFrame(const Camera& camera);
+    /// @brief Creates the depth pyramid and its views for the current swapchain size
+    void create_depth_pyramid();
+    void destroy_depth_pyramid();
+
+    /// @brief Starts the render thread, the task graph has to be submitted first
+    void start_render_thread();
+    /// @brief Draws every snapshot that was already published and joins the render thread
+    void stop_render_thread();
+
+    /// @brief Extracts the frame the simulation just finished into the next snapshot and hands it to the render thread
+    /// @note Called on the main thread after @c ImGui::Render, blocks while the render thread is still drawing the frame before last
+    void publish_snapshot(const Camera& camera);
+
+    void startFrame(const RenderSnapshot& snapshot);
     void endFrame();
 };
@@ -0,0 +1,289 @@
+#include "Mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+    /**
+     * @brief The sum of the squared distances to a set of planes as a symmetric 4x4 matrix, kept in doubles since the terms of big meshes cancel out
+     *
+     * Each plane is weighted by the area of its triangle, dividing by @c weight turns the sum into the average squared distance
+     */
+    struct Quadric {
+        double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+        double yy = 0.0, yz = 0.0, yw = 0.0;
+        double zz = 0.0, zw = 0.0;
+        double ww = 0.0;
+        double weight = 0.0;
+
+        static Quadric from_plane(double a, double b, double c, double d, double weight) {
+            return {
+                a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+                b * b * weight, b * c * weight, b * d * weight,
+                c * c * weight, c * d * weight,
+                d * d * weight,
+                weight,
+            };
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+            yy += other.yy; yz += other.yz; yw += other.yw;
+            zz += other.zz; zw += other.zw;
+            ww += other.ww;
+            weight += other.weight;
+            return *this;
+        }
+
+        /// @brief The average squared distance from @c p to the planes
+        double error(const glm::vec3& p) const {
+            const double x = p.x, y = p.y, z = p.z;
+            const double sum = xx * x * x + yy * y * y + zz * z * z
+                + 2.0 * (xy * x * y + xz * x * z + yz * y * z)
+                + 2.0 * (xw * x + yw * y + zw * z)
+                + ww;
+            return weight > 0.0 ? std::max(sum / weight, 0.0) : 0.0;
+        }
+    };
+
+    Quadric operator+(Quadric a, const Quadric& b) {
+        return a += b;
+    }
+
+    struct Collapse {
+        std::uint32_t from;
+        std::uint32_t to;
+        double error;
+    };
+
+    /// @brief For every vertex the first vertex with exactly the same position, vertices split for different UVs share it
+    std::vector<std::uint32_t> find_position_groups(std::span<const glm::vec3> positions) {
+        std::vector<std::uint32_t> order(positions.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto less = [&](std::uint32_t a, std::uint32_t b) {
+            if (positions[a].x != positions[b].x)
+                return positions[a].x < positions[b].x;
+            if (positions[a].y != positions[b].y)
+                return positions[a].y < positions[b].y;
+            if (positions[a].z != positions[b].z)
+                return positions[a].z < positions[b].z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<std::uint32_t> group(positions.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            const bool same_as_previous = i > 0 && positions[order[i]] == positions[order[i - 1]];
+            group[order[i]] = same_as_previous ? group[order[i - 1]] : order[i];
+        }
+        return group;
+    }
+
+    /// @brief Vertices that have to stay where they are, on a seam, an open border or a non-manifold edge
+    std::vector<bool> find_locked_vertices(std::span<const std::uint32_t> indices, const std::vector<std::uint32_t>& group) {
+        std::vector<std::uint32_t> wedge_count(group.size(), 0);
+        for (std::uint32_t vertex = 0; vertex < group.size(); vertex++)
+            wedge_count[group[vertex]]++;
+
+        // Edges between positions rather than vertices, so a UV seam inside the surface isn't mistaken for a border
+        std::vector<std::uint64_t> edges;
+        edges.reserve(indices.size());
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            for (std::size_t corner = 0; corner < 3; corner++) {
+                const std::uint32_t a = group[indices[i + corner]];
+                const std::uint32_t b = group[indices[i + (corner + 1) % 3]];
+                if (a != b)
+                    edges.push_back(static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<bool> locked_group(group.size(), false);
+        for (std::size_t begin = 0; begin < edges.size();) {
+            std::size_t end = begin + 1;
+            while (end < edges.size() && edges[end] == edges[begin])
+                end++;
+            // A closed surface has every edge in exactly two triangles
+            if (end - begin != 2) {
+                locked_group[static_cast<std::uint32_t>(edges[begin] >> 32)] = true;
+                locked_group[static_cast<std::uint32_t>(edges[begin])] = true;
+            }
+            begin = end;
+        }
+
+        std::vector<bool> locked(group.size());
+        for (std::uint32_t vertex = 0; vertex < group.size(); vertex++)
+            locked[vertex] = wedge_count[group[vertex]] > 1 || locked_group[group[vertex]];
+        return locked;
+    }
+
+    /// @brief Checks that moving @c from onto @c to doesn't turn any of the triangles around @c from over
+    bool flips_triangle(std::span<const glm::vec3> positions, const std::vector<std::uint32_t>& indices,
+                        std::span<const std::uint32_t> triangles_of_from, std::uint32_t from, std::uint32_t to) {
+        for (const std::uint32_t triangle : triangles_of_from) {
+            const std::uint32_t* corners = &indices[triangle * 3];
+            // The triangles on the collapsed edge disappear
+            if (corners[0] == to || corners[1] == to || corners[2] == to)
+                continue;
+
+            const glm::vec3 p0 = positions[corners[0]];
+            const glm::vec3 p1 = positions[corners[1]];
+            const glm::vec3 p2 = positions[corners[2]];
+            const glm::vec3 q0 = corners[0] == from ? positions[to] : p0;
+            const glm::vec3 q1 = corners[1] == from ? positions[to] : p1;
+            const glm::vec3 q2 = corners[2] == from ? positions[to] : p2;
+
+            const glm::vec3 normal_before = glm::cross(p1 - p0, p2 - p0);
+            const glm::vec3 normal_after = glm::cross(q1 - q0, q2 - q0);
+            if (glm::dot(normal_before, normal_after) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+}
+
+std::vector<std::uint32_t> simplify_mesh(std::span<const glm::vec3> positions, std::span<const std::uint32_t> indices,
+                                         std::size_t target_index_count, float max_error, float* result_error) {
+    std::vector<std::uint32_t> result(indices.begin(), indices.end());
+    if (result_error != nullptr)
+        *result_error = 0.0f;
+    if (positions.empty() || indices.size() <= target_index_count)
+        return result;
+
+    glm::vec3 bounds_min = positions[0];
+    glm::vec3 bounds_max = positions[0];
+    for (const glm::vec3& position : positions) {
+        bounds_min = glm::min(bounds_min, position);
+        bounds_max = glm::max(bounds_max, position);
+    }
+    const double max_error_absolute = static_cast<double>(max_error) * glm::length(bounds_max - bounds_min);
+    const double error_limit = max_error_absolute * max_error_absolute;
+
+    const std::vector<std::uint32_t> group = find_position_groups(positions);
+    const std::vector<bool> locked = find_locked_vertices(indices, group);
+
+    // Quadrics belong to positions, so the wedges of a seam vertex share the planes around all of them
+    std::vector<Quadric> quadrics(positions.size());
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const glm::dvec3 p0{ positions[indices[i]] };
+        const glm::dvec3 p1{ positions[indices[i + 1]] };
+        const glm::dvec3 p2{ positions[indices[i + 2]] };
+        const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+
+        const glm::dvec3 unit_normal = normal / length;
+        const Quadric plane = Quadric::from_plane(unit_normal.x, unit_normal.y, unit_normal.z, -glm::dot(unit_normal, p0), length * 0.5);
+        for (std::size_t corner = 0; corner < 3; corner++)
+            quadrics[group[indices[i + corner]]] += plane;
+    }
+
+    double largest_error = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<std::uint32_t> triangle_offsets;
+    std::vector<std::uint32_t> vertex_triangles;
+    std::vector<std::uint32_t> remap(positions.size());
+    std::vector<bool> touched(positions.size());
+
+    // Each pass makes the cheapest collapses that don't touch each other, then the indices are rebuilt for the next pass
+    while (result.size() > target_index_count) {
+        const std::size_t triangle_count = result.size() / 3;
+
+        triangle_offsets.assign(positions.size() + 1, 0);
+        for (const std::uint32_t vertex : result)
+            triangle_offsets[vertex + 1]++;
+        std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(), triangle_offsets.begin());
+        vertex_triangles.resize(result.size());
+        {
+            std::vector<std::uint32_t> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+            for (std::size_t i = 0; i < result.size(); i++)
+                vertex_triangles[fill[result[i]]++] = static_cast<std::uint32_t>(i / 3);
+        }
+        auto triangles_of = [&](std::uint32_t vertex) {
+            return std::span<const std::uint32_t>(vertex_triangles.data() + triangle_offsets[vertex], triangle_offsets[vertex + 1] - triangle_offsets[vertex]);
+        };
+
+        collapses.clear();
+        for (std::size_t i = 0; i < result.size(); i += 3) {
+            for (std::size_t corner = 0; corner < 3; corner++) {
+                const std::uint32_t a = result[i + corner];
+                const std::uint32_t b = result[i + (corner + 1) % 3];
+                if (!locked[a])
+                    collapses.push_back({ a, b, (quadrics[group[a]] + quadrics[group[b]]).error(positions[b]) });
+                if (!locked[b])
+                    collapses.push_back({ b, a, (quadrics[group[a]] + quadrics[group[b]]).error(positions[a]) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        // Each collapse removes about two triangles
+        const std::size_t collapse_budget = std::max<std::size_t>((triangle_count - target_index_count / 3) / 2, 1);
+        std::size_t collapse_count = 0;
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (const Collapse& collapse : collapses) {
+            if (collapse.error > error_limit || collapse_count >= collapse_budget)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            if (flips_triangle(positions, result, triangles_of(collapse.from), collapse.from, collapse.to))
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[group[collapse.to]] += quadrics[group[collapse.from]];
+            largest_error = std::max(largest_error, collapse.error);
+            collapse_count++;
+
+            // The triangles around the collapsed vertex changed, their vertices wait for the next pass so every check above sees current triangles
+            for (const std::uint32_t triangle : triangles_of(collapse.from)) {
+                for (std::size_t corner = 0; corner < 3; corner++)
+                    touched[result[triangle * 3 + corner]] = true;
+            }
+        }
+
+        if (collapse_count == 0)
+            break;
+
+        std::size_t write = 0;
+        for (std::size_t i = 0; i < result.size(); i += 3) {
+            const std::uint32_t a = remap[result[i]];
+            const std::uint32_t b = remap[result[i + 1]];
+            const std::uint32_t c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (result_error != nullptr)
+        *result_error = static_cast<float>(std::sqrt(largest_error));
+    return result;
+}
+
+std::vector<MeshLodRange> build_lod_chain(std::span<const glm::vec3> positions, std::vector<std::uint32_t>& indices, std::size_t max_lod_count) {
+    std::vector<MeshLodRange> lods{ { 0, static_cast<std::uint32_t>(indices.size()), 0.0f } };
+    std::vector<std::uint32_t> previous = indices;
+
+    while (lods.size() < max_lod_count) {
+        const std::size_t target_index_count = previous.size() / 6 * 3;
+        if (target_index_count < LOD_MIN_TRIANGLE_COUNT * 3)
+            break;
+
+        float error = 0.0f;
+        std::vector<std::uint32_t> lod = simplify_mesh(positions, previous, target_index_count, LOD_MAX_RELATIVE_ERROR, &error);
+        if (static_cast<float>(lod.size()) > static_cast<float>(previous.size()) * LOD_MIN_REDUCTION)
+            break;
+
+        // Each level is simplified from the one before, so its distance from the full mesh is at most the sum of the steps
+        lods.push_back({ static_cast<std::uint32_t>(indices.size()), static_cast<std::uint32_t>(lod.size()), lods.back().error + error });
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previous = std::move(lod);
+    }
+    return lods;
+}
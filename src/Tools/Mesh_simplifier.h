@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// @brief How far (relative to the diagonal of the mesh's bounds) a LOD may move from the level before it, past that the chain stops
+constexpr float LOD_MAX_RELATIVE_ERROR = 0.05f;
+/// @brief A level is only kept if it has at most this fraction of the previous level's triangles, meshes that barely simplify end their chain there
+constexpr float LOD_MIN_REDUCTION = 0.8f;
+/// @brief Meshes are not simplified below this many triangles
+constexpr std::size_t LOD_MIN_TRIANGLE_COUNT = 32;
+
+/// @brief One level of detail, a range of a mesh's index data drawn with the same vertices as every other level
+struct MeshLodRange {
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    /// @brief How far the level's surface is from the full mesh, in the mesh's local units, 0 for the full mesh
+    float error;
+};
+
+/**
+ * @brief Simplifies a triangle mesh by collapsing edges in the order of the quadric error they add (Garland and Heckbert)
+ *
+ * A collapse moves one vertex onto a neighbour, so the result indexes the same vertices and can be drawn with the same vertex buffer
+ * Vertices on open borders and on attribute seams (several vertices at one position, i.e. different UVs) never move so the outline and the UV layout stay intact,
+ * collapses that would flip a triangle are skipped
+ * @param positions The position of every vertex
+ * @param indices Three per triangle, indexing @c positions
+ * @param target_index_count Stops once there are at most this many indices left
+ * @param max_error Stops before a collapse would move the surface further than this, relative to the diagonal of the mesh's bounds
+ * @param result_error Set to the largest error of a collapse that was made, in the mesh's local units
+ * @return The simplified indices, as many as @c indices if nothing could be collapsed
+ */
+std::vector<std::uint32_t> simplify_mesh(std::span<const glm::vec3> positions, std::span<const std::uint32_t> indices,
+                                         std::size_t target_index_count, float max_error, float* result_error = nullptr);
+
+/**
+ * @brief Builds a chain of up to @c max_lod_count levels, each with about half the triangles of the one before, by simplifying each level into the next
+ *
+ * The levels' indices are appended to @c indices one after another, the first level is the mesh itself
+ * The chain ends early once a level moves the surface more than @c LOD_MAX_RELATIVE_ERROR, barely simplifies (@c LOD_MIN_REDUCTION) or reaches @c LOD_MIN_TRIANGLE_COUNT
+ * @return The range of @c indices and the error of each level, errors include the errors of the levels before
+ */
+std::vector<MeshLodRange> build_lod_chain(std::span<const glm::vec3> positions, std::vector<std::uint32_t>& indices, std::size_t max_lod_count);
@@ -1,5 +1,9 @@
 #include "Model_loader.h"
 
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+
 void GLTF_Loader::OpenFile(const std::string& path) {
     std::string err, warn;
 
@@ -29,94 +33,127 @@ void GLTF_Loader::purgeImages() {
 }
 
 void GLTF_Loader::LoadModel() {
-    for (const auto& mesh : model.meshes) {
-        ParsedMesh parsedMesh;
+    // Meshes are independent of each other so they are parsed in parallel, each one writes only to its own slot in modelData
+    const std::size_t firstMesh = modelData.size();
+    modelData.resize(firstMesh + model.meshes.size());
+
+    jobs::parallel_for(0, model.meshes.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t meshIndex = begin; meshIndex < end; meshIndex++)
+            modelData[firstMesh + meshIndex] = parseMesh(model.meshes[meshIndex]);
+    });
+}
 
-        int texture_index = -1;
+ParsedMesh GLTF_Loader::parseMesh(const tinygltf::Mesh& mesh) const {
+    ParsedMesh parsedMesh;
 
+    int texture_index = -1;
 
-        for (const auto& primitive : mesh.primitives) {
-            ParsedPrimitive parsedPirimitive;
 
-            // Check if model contains multiple textures
-            if (primitive.material >= 0) {
-                const auto& material = model.materials[primitive.material];
-                if (material.values.contains("baseColorTexture")) {
-                    texture_index = material.values.at("baseColorTexture").TextureIndex();
-                    const auto& image = model.images[model.textures[texture_index].source];
-                    parsedPirimitive.albedo = image;
-                }
-            }
+    for (const auto& primitive : mesh.primitives) {
+        ParsedPrimitive parsedPirimitive;
 
-            // === POSITION ===
-            const auto& posAccessor = model.accessors[primitive.attributes.at("POSITION")];
-            const auto& posView = model.bufferViews[posAccessor.bufferView];
-            const auto& posBuffer = model.buffers[posView.buffer];
-            const float* positions = reinterpret_cast<const float*>(
-                &posBuffer.data[posView.byteOffset + posAccessor.byteOffset]);
-
-            // === UV ===
-            const float* uvs = nullptr;
-            size_t uvCount = 0;
-            if (primitive.attributes.contains("TEXCOORD_0")) {
-                const auto& uvAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
-                const auto& uvView = model.bufferViews[uvAccessor.bufferView];
-                const auto& uvBuffer = model.buffers[uvView.buffer];
-                uvs = reinterpret_cast<const float*>(
-                    &uvBuffer.data[uvView.byteOffset + uvAccessor.byteOffset]);
-                uvCount = uvAccessor.count;
+        // Check if model contains multiple textures
+        if (primitive.material >= 0) {
+            const auto& material = model.materials[primitive.material];
+            if (material.values.contains("baseColorTexture")) {
+                texture_index = material.values.at("baseColorTexture").TextureIndex();
+                const auto& image = model.images[model.textures[texture_index].source];
+                parsedPirimitive.albedo = image;
             }
+        }
+
+        // === POSITION ===
+        const auto& posAccessor = model.accessors[primitive.attributes.at("POSITION")];
+        const auto& posView = model.bufferViews[posAccessor.bufferView];
+        const auto& posBuffer = model.buffers[posView.buffer];
+        const float* positions = reinterpret_cast<const float*>(
+            &posBuffer.data[posView.byteOffset + posAccessor.byteOffset]);
+
+        // === UV ===
+        const float* uvs = nullptr;
+        size_t uvCount = 0;
+        if (primitive.attributes.contains("TEXCOORD_0")) {
+            const auto& uvAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
+            const auto& uvView = model.bufferViews[uvAccessor.bufferView];
+            const auto& uvBuffer = model.buffers[uvView.buffer];
+            uvs = reinterpret_cast<const float*>(
+                &uvBuffer.data[uvView.byteOffset + uvAccessor.byteOffset]);
+            uvCount = uvAccessor.count;
+        }
 
-            size_t vertexCount = posAccessor.count;
-            for (size_t i = 0; i < vertexCount; ++i) {
-                meshRenderer::Vertex v;
-                v.position = {
-                    positions[i * 3 + 0],
-                    positions[i * 3 + 1],
-                    positions[i * 3 + 2],
+        size_t vertexCount = posAccessor.count;
+        parsedPirimitive.vertices.reserve(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            meshRenderer::Vertex v;
+            v.position = {
+                positions[i * 3 + 0],
+                positions[i * 3 + 1],
+                positions[i * 3 + 2],
+            };
+
+            if (uvs && i < uvCount) {
+                v.uv = {
+                    uvs[i * 2 + 0],
+                    uvs[i * 2 + 1]
                 };
+            } else {
+                v.uv = {0.0f, 0.0f};
+            }
 
-                if (uvs && i < uvCount) {
-                    v.uv = {
-                        uvs[i * 2 + 0],
-                        uvs[i * 2 + 1]
-                    };
-                } else {
-                    v.uv = {0.0f, 0.0f};
-                }
+            parsedPirimitive.vertices.push_back(v);
+        }
 
-                parsedPirimitive.vertices.push_back(v);
+        // glTF requires POSITION accessors to have a min and max, but they're computed from the vertices if a file leaves them out
+        if (posAccessor.minValues.size() == 3 && posAccessor.maxValues.size() == 3) {
+            parsedPirimitive.aabbMin = { static_cast<float>(posAccessor.minValues[0]), static_cast<float>(posAccessor.minValues[1]), static_cast<float>(posAccessor.minValues[2]) };
+            parsedPirimitive.aabbMax = { static_cast<float>(posAccessor.maxValues[0]), static_cast<float>(posAccessor.maxValues[1]), static_cast<float>(posAccessor.maxValues[2]) };
+        } else if (!parsedPirimitive.vertices.empty()) {
+            parsedPirimitive.aabbMin = parsedPirimitive.aabbMax = parsedPirimitive.vertices[0].position;
+            for (const meshRenderer::Vertex& vertex : parsedPirimitive.vertices) {
+                parsedPirimitive.aabbMin = { std::min(parsedPirimitive.aabbMin.x, vertex.position.x), std::min(parsedPirimitive.aabbMin.y, vertex.position.y), std::min(parsedPirimitive.aabbMin.z, vertex.position.z) };
+                parsedPirimitive.aabbMax = { std::max(parsedPirimitive.aabbMax.x, vertex.position.x), std::max(parsedPirimitive.aabbMax.y, vertex.position.y), std::max(parsedPirimitive.aabbMax.z, vertex.position.z) };
             }
+        }
 
-            // === INDICES ===
-            size_t indexCount = 0;
-            if (primitive.indices >= 0) {
-                const auto& idxAccessor = model.accessors[primitive.indices];
-                const auto& idxView = model.bufferViews[idxAccessor.bufferView];
-                const auto& idxBuffer = model.buffers[idxView.buffer];
-                const void* dataPtr = &idxBuffer.data[idxView.byteOffset + idxAccessor.byteOffset];
-
-                for (size_t i = 0; i < idxAccessor.count; ++i) {
-                    uint32_t idx = 0;
-                    switch (idxAccessor.componentType) {
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                            idx = reinterpret_cast<const uint8_t*>(dataPtr)[i]; break;
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                            idx = reinterpret_cast<const uint16_t*>(dataPtr)[i]; break;
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                            idx = reinterpret_cast<const uint32_t*>(dataPtr)[i]; break;
-                        default: throw std::runtime_error("Unsupported index component type");
-                    }
-                    parsedPirimitive.indices.push_back(idx);
+        // === INDICES ===
+        size_t indexCount = 0;
+        if (primitive.indices >= 0) {
+            const auto& idxAccessor = model.accessors[primitive.indices];
+            const auto& idxView = model.bufferViews[idxAccessor.bufferView];
+            const auto& idxBuffer = model.buffers[idxView.buffer];
+            const void* dataPtr = &idxBuffer.data[idxView.byteOffset + idxAccessor.byteOffset];
+            parsedPirimitive.indices.reserve(idxAccessor.count);
+
+            for (size_t i = 0; i < idxAccessor.count; ++i) {
+                uint32_t idx = 0;
+                switch (idxAccessor.componentType) {
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                        idx = reinterpret_cast<const uint8_t*>(dataPtr)[i]; break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                        idx = reinterpret_cast<const uint16_t*>(dataPtr)[i]; break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                        idx = reinterpret_cast<const uint32_t*>(dataPtr)[i]; break;
+                    default: throw std::runtime_error("Unsupported index component type");
                 }
-                indexCount = idxAccessor.count;
+                parsedPirimitive.indices.push_back(idx);
             }
-            parsedPirimitive.vertexCount = vertexCount;
-            parsedPirimitive.indexCount = indexCount;
-
-            parsedMesh.primitives.push_back(std::move(parsedPirimitive));
+            indexCount = idxAccessor.count;
         }
 
-        modelData.push_back(parsedMesh);
+        // === LODS ===
+        // Simplified here so the meshes' chains are built in parallel along with the rest of the parsing
+        std::vector<glm::vec3> lodPositions;
+        lodPositions.reserve(parsedPirimitive.vertices.size());
+        for (const meshRenderer::Vertex& vertex : parsedPirimitive.vertices)
+            lodPositions.push_back(to_glm(vertex.position));
+        parsedPirimitive.lods = build_lod_chain(lodPositions, parsedPirimitive.indices, MAX_LOD_COUNT);
+        indexCount = parsedPirimitive.indices.size();
+
+        parsedPirimitive.vertexCount = vertexCount;
+        parsedPirimitive.indexCount = indexCount;
+
+        parsedMesh.primitives.push_back(std::move(parsedPirimitive));
     }
+
+    return parsedMesh;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mesh_rendering_shared.inl"
+#include "Tools/Mesh_simplifier.h"
 
 #include <tiny_gltf.h>
 #include <stb_image.h>
@@ -17,10 +18,19 @@
  */
 struct ParsedPrimitive {
     std::vector<meshRenderer::Vertex> vertices;
+    /// @brief The indices of every level in @c lods one after another
     std::vector<uint32_t> indices;
     std::size_t vertexCount;
+    /// @brief The size of @c indices, so it counts every level
     std::size_t indexCount;
 
+    /// @brief The levels of detail generated by @ref build_lod_chain when the primitive is parsed, the first is the primitive itself
+    std::vector<MeshLodRange> lods;
+
+    /// @brief The bounds of the positions, from the POSITION accessor's min and max
+    daxa_f32vec3 aabbMin = { 0.0f, 0.0f, 0.0f };
+    daxa_f32vec3 aabbMax = { 0.0f, 0.0f, 0.0f };
+
     std::optional<tinygltf::Image> albedo;
 };
 
@@ -57,7 +67,7 @@ public:
     /// @brief Opens the file resource based on the @c path
     /// @param path The path to the file
     void OpenFile(const std::string& path);
-    /// @brief Loads and parses the glTF model data
+    /// @brief Loads and parses the glTF model data, the meshes are parsed in parallel on the @ref jobs::JobSystem
     void LoadModel();
 
     /// @brief Removes the @c tinygltf::Image for all the textures in the @ref ParsedPrimitives that exist
@@ -70,5 +80,7 @@ private:
     tinygltf::TinyGLTF loader;
     tinygltf::Model model;
 
+    /// @brief Parses every primitive of a single mesh, only reads from @c model so it is safe to call for several meshes at once
+    ParsedMesh parseMesh(const tinygltf::Mesh& mesh) const;
 
 };
\ No newline at end of file
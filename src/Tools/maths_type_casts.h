@@ -10,4 +10,13 @@
 /// @return A @c daxa_f32mat4x4 by value
 inline daxa_f32mat4x4 to_daxa(const glm::mat4& m) {
 	return *reinterpret_cast<const daxa_f32mat4x4*>(&m);
-}
\ No newline at end of file
+}
+/// @brief References and @c reinterpret_cast a @c daxa_f32mat4x4 to a @c glm::mat4 before dereferencign it
+inline glm::mat4 to_glm(const daxa_f32mat4x4& m) {
+	return *reinterpret_cast<const glm::mat4*>(&m);
+}
+
+/// @brief Converts a @c daxa_f32vec3 to a @c glm::vec3
+inline glm::vec3 to_glm(const daxa_f32vec3& v) {
+	return glm::vec3(v.x, v.y, v.z);
+}
@@ -0,0 +1,124 @@
+/**
+ * Checks that entity handles from before a slot was recycled can't reach the entity that now lives in it
+ *
+ * Each case creates an entity, destroys it, creates another one in the same slot and then uses the old handle, with every kind of component storage:
+ * - @ref ComponentManager through @c addComponent and @c addComponents
+ * - @ref SoAComponentManager through @c addComponent and @c addComponents
+ * - @ref ArchetypeStorage through @c addComponent
+ *
+ * Usage: ecs_test
+ */
+
+#include "Core/ECS/ECS_Entity.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
+namespace {
+    struct Health {
+        int value = 0;
+    };
+
+    struct Velocity {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+    };
+
+    struct Tag {
+        int value = 0;
+    };
+}
+
+template <>
+struct ComponentFields<Velocity> {
+    static constexpr auto fields = std::make_tuple(&Velocity::x, &Velocity::y, &Velocity::z);
+};
+
+namespace {
+    std::size_t failures = 0;
+
+    void check(bool condition, const char* message) {
+        if (!condition) {
+            std::printf("Error: %s\n", message);
+            failures++;
+        }
+    }
+
+    /// @brief Creates an entity, destroys it and creates another one in the same slot
+    /// @return The stale handle and the live one
+    std::pair<Entity, Entity> recycle(EntityManager& entities) {
+        const Entity stale = entities.createEntity();
+        entities.destroyEntity(stale);
+        const Entity live = entities.createEntity();
+        return { stale, live };
+    }
+
+    void component_manager(EntityManager& entities) {
+        entities.registerComponentManager<Health>();
+        auto& health = entities.getComponentManager<Health>();
+
+        const auto [stale, live] = recycle(entities);
+        check(entityIndex(stale) == entityIndex(live) && stale != live, "the slot was not recycled");
+
+        health.addComponent(live, Health{ 1 });
+        health.addComponent(stale, Health{ 2 });
+        check(health.getComponent(live) && health.getComponent(live)->value == 1, "a stale addComponent replaced the live entity's component");
+        check(health.getEntity(*health.getComponent(live)) == live, "a stale addComponent took over the live entity's slot");
+        check(!health.getComponent(stale), "the stale handle got a component");
+
+        // Without a component in the slot the stale handle must still be rejected
+        const auto [staleEmpty, liveEmpty] = recycle(entities);
+        health.addComponent(staleEmpty, Health{ 3 });
+        check(!health.getComponent(liveEmpty) && !health.getComponent(staleEmpty), "a stale addComponent added a component to an empty slot");
+
+        const auto [staleBatch, liveBatch] = recycle(entities);
+        health.addComponent(liveBatch, Health{ 4 });
+        const std::vector<Entity> batch = { staleBatch };
+        health.addComponents(batch, Health{ 5 });
+        check(health.getComponent(liveBatch)->value == 4, "a stale entity in addComponents replaced the live entity's component");
+        check(health.size() == 2, "addComponents added a component for a stale entity");
+    }
+
+    void soa_component_manager(EntityManager& entities) {
+        entities.registerComponentManager<Velocity>();
+        auto& velocity = entities.getComponentManager<Velocity>();
+
+        const auto [stale, live] = recycle(entities);
+        velocity.addComponent(live, Velocity{ 1.0f, 0.0f, 0.0f });
+        velocity.addComponent(stale, Velocity{ 2.0f, 0.0f, 0.0f });
+        check(velocity.getComponent(live) && velocity.getComponent(live)->x == 1.0f, "a stale SoA addComponent replaced the live entity's component");
+        check(!velocity.getComponent(stale), "the stale handle got a SoA component");
+
+        const std::vector<Entity> batch = { stale };
+        velocity.addComponents(batch, Velocity{ 3.0f, 0.0f, 0.0f });
+        check(velocity.getComponent(live)->x == 1.0f && velocity.size() == 1, "a stale entity in SoA addComponents was added");
+    }
+
+    void archetype_storage(EntityManager& entities) {
+        ArchetypeStorage& storage = entities.getArchetypeStorage();
+
+        const auto [stale, live] = recycle(entities);
+        storage.addComponent(live, Tag{ 1 });
+        storage.addComponent(stale, Tag{ 2 });
+        check(storage.getComponent<Tag>(live) && storage.getComponent<Tag>(live)->value == 1, "a stale archetype addComponent replaced the live entity's row");
+        check(!storage.getComponent<Tag>(stale), "the stale handle got an archetype row");
+
+        std::size_t rows = 0;
+        storage.each<Tag>([&](Entity entity, Tag&) {
+            check(entity == live, "an archetype row belongs to a stale handle");
+            rows++;
+        });
+        check(rows == 1, "a stale archetype addComponent added a row");
+    }
+}
+
+int main() {
+    EntityManager entities;
+    component_manager(entities);
+    soa_component_manager(entities);
+    archetype_storage(entities);
+
+    std::printf("%zu failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+/**
+ * Runs @c frustum_culling.comp.glsl on random draws and checks that every draw's visible instances are the ones @ref cull_aabbs keeps
+ *
+ * The visibility history is all ones so the early phase is pure frustum culling, the shader is compiled at runtime by daxa's pipeline manager
+ * just like in the engine. Any Vulkan 1.3 device works, without a GPU point @c VK_ICD_FILENAMES at lavapipe's ICD
+ * The test is skipped (exit code 77) when no device can be created
+ *
+ * Usage: gpu_culling_test [draw count]
+ */
+
+#include "mesh_rendering_shared.inl"
+
+#include "Core/Camera.h"
+#include "Renderer/Culling/FrustumCulling.h"
+
+#include <daxa/daxa.hpp>
+#include <daxa/utils/pipeline_manager.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int SKIP_RETURN_CODE = 77;
+    constexpr std::uint32_t DEFAULT_DRAW_COUNT = 16;
+    constexpr std::uint32_t MAX_INSTANCES_PER_DRAW = 2000;
+    /// @brief Boxes closer than this to a plane may round either way on the GPU, a mismatch on them is not a failure
+    constexpr double PLANE_TOLERANCE = 1e-3;
+
+    struct HostBuffer {
+        daxa::BufferId id;
+        std::byte* data;
+    };
+
+    /// @brief How far the box is outside the frustum, negative when it is outside a plane and positive when it is inside all of them
+    double plane_margin(const Frustum& frustum, const WorldAABBs& boxes, std::size_t i) {
+        const double center[3] = { 0.5 * (boxes.min_x[i] + boxes.max_x[i]), 0.5 * (boxes.min_y[i] + boxes.max_y[i]), 0.5 * (boxes.min_z[i] + boxes.max_z[i]) };
+        const double extent[3] = { 0.5 * (boxes.max_x[i] - boxes.min_x[i]), 0.5 * (boxes.max_y[i] - boxes.min_y[i]), 0.5 * (boxes.max_z[i] - boxes.min_z[i]) };
+        double margin = INFINITY;
+        for (const glm::vec4& plane : frustum.planes) {
+            double distance = plane.w;
+            for (int axis = 0; axis < 3; axis++)
+                distance += plane[axis] * center[axis] + std::abs(plane[axis]) * extent[axis];
+            margin = std::min(margin, distance);
+        }
+        return margin;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::uint32_t draw_count = argc > 1 ? static_cast<std::uint32_t>(std::atoi(argv[1])) : DEFAULT_DRAW_COUNT;
+
+    daxa::Instance instance;
+    daxa::Device device;
+    try {
+        instance = daxa::create_instance({});
+        device = instance.create_device_2(instance.choose_device({}, {}));
+    } catch (const std::exception& error) {
+        std::printf("Skipped, no Vulkan device could be created: %s\n", error.what());
+        return SKIP_RETURN_CODE;
+    }
+
+    daxa::PipelineManager pipeline_manager({
+        .device = device,
+        .root_paths = {
+            DAXA_SHADER_INCLUDE_DIR,
+            ENGINE_SHADER_DIR,
+        },
+        .default_language = std::optional{daxa::ShaderLanguage::GLSL},
+        .name = "gpu culling test pipeline manager",
+    });
+    auto pipeline_result = pipeline_manager.add_compute_pipeline2({
+        .source = daxa::ShaderFile{"frustum_culling.comp.glsl"},
+        .defines = { {"DAXA_SHADER", "1"}, {"GLSL", "1"}},
+        .push_constant_size = sizeof(meshRenderer::CullPushConstant),
+        .name = "frustum culling",
+    });
+    if (pipeline_result.is_err()) {
+        std::printf("Error: failed to compile the culling pipeline\n%s\n", pipeline_result.message().c_str());
+        return 1;
+    }
+    const std::shared_ptr<daxa::ComputePipeline> cull_pipeline = pipeline_result.value();
+
+    // Random draws with random bounds, their instances scattered around the camera so about half are culled
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto between = [&](float min, float max) { return min + (max - min) * unit(random); };
+
+    std::vector<meshRenderer::CullDrawInfo> draws(draw_count);
+    std::vector<glm::mat4> models;
+    std::vector<std::uint32_t> instance_draws;
+    for (std::uint32_t draw = 0; draw < draw_count; draw++) {
+        const glm::vec3 aabb_min{ between(-2.0f, 0.0f), between(-2.0f, 0.0f), between(-2.0f, 0.0f) };
+        const glm::vec3 aabb_max = aabb_min + glm::vec3(between(0.1f, 3.0f), between(0.1f, 3.0f), between(0.1f, 3.0f));
+        const auto instance_count = static_cast<std::uint32_t>(between(1.0f, static_cast<float>(MAX_INSTANCES_PER_DRAW)));
+
+        draws[draw] = meshRenderer::CullDrawInfo{
+            .aabb_min = { aabb_min.x, aabb_min.y, aabb_min.z },
+            .lod_count = 1,
+            .aabb_max = { aabb_max.x, aabb_max.y, aabb_max.z },
+            .vertex_offset = 0,
+            .first_instance = static_cast<std::uint32_t>(models.size()),
+            .instance_count = instance_count,
+        };
+        draws[draw].lods[0] = meshRenderer::MeshLod{ .first_index = draw * 36, .index_count = 36, .error = 0.0f };
+
+        for (std::uint32_t i = 0; i < instance_count; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(between(-60.0f, 60.0f), between(-30.0f, 30.0f), between(-110.0f, 10.0f)));
+            model = glm::rotate(model, between(0.0f, 6.28f), glm::normalize(glm::vec3(between(-1.0f, 1.0f), 1.0f, between(-1.0f, 1.0f))));
+            model = glm::scale(model, glm::vec3(between(0.2f, 3.0f), between(0.2f, 3.0f), between(0.2f, 3.0f)));
+            models.push_back(model);
+            instance_draws.push_back(draw);
+        }
+    }
+    const auto instance_count = static_cast<std::uint32_t>(models.size());
+    const std::uint32_t command_slot_count = draw_count * MAX_LOD_COUNT;
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f);
+    camera.update_vectors();
+    const float aspect_ratio = 16.0f / 9.0f;
+    const glm::mat4 view = camera.get_view_matrix();
+    const glm::mat4 proj = camera.get_projection(aspect_ratio);
+    const Frustum frustum = Frustum::from_view_proj(proj * view);
+
+    // Everything lives in host visible memory so nothing has to be staged
+    std::vector<daxa::BufferId> buffers;
+    auto create_host_buffer = [&](std::size_t size, const char* name) {
+        const daxa::BufferId id = device.create_buffer({
+            .size = std::max<std::size_t>(size, 4),
+            .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+            .name = name,
+        });
+        buffers.push_back(id);
+        return HostBuffer{ id, device.buffer_host_address_as<std::byte>(id).value() };
+    };
+    const HostBuffer ubo_buffer = create_host_buffer(sizeof(meshRenderer::UniformBufferObject), "ubo");
+    const HostBuffer instance_buffer = create_host_buffer(instance_count * sizeof(meshRenderer::PerInstanceData), "instances");
+    const HostBuffer draw_info_buffer = create_host_buffer(draw_count * sizeof(meshRenderer::CullDrawInfo), "draw infos");
+    const HostBuffer instance_draw_buffer = create_host_buffer(instance_count * sizeof(std::uint32_t), "instance draws");
+    const HostBuffer counter_buffer = create_host_buffer((1 + command_slot_count) * sizeof(std::uint32_t), "counters");
+    const HostBuffer visible_instance_buffer = create_host_buffer(instance_count * MAX_LOD_COUNT * sizeof(std::uint32_t), "visible instances");
+    const HostBuffer command_buffer = create_host_buffer(command_slot_count * sizeof(meshRenderer::DrawCommand), "commands");
+    const HostBuffer visibility_history_buffer = create_host_buffer(instance_count * sizeof(std::uint32_t), "visibility history");
+
+    auto* ubo = reinterpret_cast<meshRenderer::UniformBufferObject*>(ubo_buffer.data);
+    *ubo = {};
+    ubo->view = to_daxa(view);
+    ubo->proj = to_daxa(proj);
+    for (std::size_t plane = 0; plane < 6; plane++)
+        ubo->frustum_planes[plane] = { frustum.planes[plane].x, frustum.planes[plane].y, frustum.planes[plane].z, frustum.planes[plane].w };
+    ubo->camera_position = { camera.position.x, camera.position.y, camera.position.z };
+    ubo->lod_error_scale = 0.0f;
+
+    auto* instances = reinterpret_cast<meshRenderer::PerInstanceData*>(instance_buffer.data);
+    for (std::uint32_t i = 0; i < instance_count; i++)
+        instances[i] = meshRenderer::PerInstanceData{ .model_matrix = to_daxa(models[i]) };
+    std::copy(draws.begin(), draws.end(), reinterpret_cast<meshRenderer::CullDrawInfo*>(draw_info_buffer.data));
+    std::copy(instance_draws.begin(), instance_draws.end(), reinterpret_cast<std::uint32_t*>(instance_draw_buffer.data));
+    std::fill_n(reinterpret_cast<std::uint32_t*>(counter_buffer.data), 1 + command_slot_count, 0u);
+    std::fill_n(reinterpret_cast<std::uint32_t*>(visibility_history_buffer.data), instance_count, 1u);
+
+    auto push_constant = [&](daxa::u32 pass, daxa::u32 count) {
+        return meshRenderer::CullPushConstant{
+            .ubo_ptr = device.device_address(ubo_buffer.id).value(),
+            .instance_buffer_ptr = device.device_address(instance_buffer.id).value(),
+            .draw_info_ptr = device.device_address(draw_info_buffer.id).value(),
+            .instance_draw_ptr = device.device_address(instance_draw_buffer.id).value(),
+            .counter_ptr = device.device_address(counter_buffer.id).value(),
+            .visible_instance_ptr = device.device_address(visible_instance_buffer.id).value(),
+            .command_ptr = device.device_address(command_buffer.id).value(),
+            .visibility_history_ptr = device.device_address(visibility_history_buffer.id).value(),
+            .count = count,
+            .pass = pass,
+            .phase = CULL_PHASE_EARLY,
+        };
+    };
+
+    // The same two dispatches Renderer::cull_task records for a draw group
+    daxa::CommandRecorder recorder = device.create_command_recorder({ .name = "gpu culling test" });
+    recorder.set_pipeline(*cull_pipeline);
+    recorder.push_constant(push_constant(CULL_PASS_INSTANCES, instance_count));
+    recorder.dispatch({ .x = (instance_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE });
+    recorder.pipeline_barrier({
+        .src_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+        .dst_access = daxa::AccessConsts::COMPUTE_SHADER_READ_WRITE,
+    });
+    recorder.push_constant(push_constant(CULL_PASS_COMMANDS, command_slot_count));
+    recorder.dispatch({ .x = (command_slot_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE });
+    recorder.pipeline_barrier({
+        .src_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+        .dst_access = daxa::AccessConsts::HOST_READ,
+    });
+    daxa::ExecutableCommandList commands = recorder.complete_current_commands();
+    device.submit_commands({ .command_lists = std::array{ commands } });
+    device.wait_idle();
+
+    WorldAABBs boxes;
+    boxes.resize(instance_count);
+    for (std::uint32_t i = 0; i < instance_count; i++) {
+        const meshRenderer::CullDrawInfo& draw = draws[instance_draws[i]];
+        boxes.set(i, models[i], { draw.aabb_min.x, draw.aabb_min.y, draw.aabb_min.z }, { draw.aabb_max.x, draw.aabb_max.y, draw.aabb_max.z });
+    }
+    std::vector<std::uint8_t> cpu_visible(instance_count);
+    cull_aabbs(frustum, boxes, cpu_visible.data());
+
+    const auto* counters = reinterpret_cast<const std::uint32_t*>(counter_buffer.data);
+    const auto* visible_instances = reinterpret_cast<const std::uint32_t*>(visible_instance_buffer.data);
+    const auto* written_commands = reinterpret_cast<const meshRenderer::DrawCommand*>(command_buffer.data);
+
+    std::size_t failures = 0;
+    std::size_t borderline = 0;
+    std::size_t visible_total = 0;
+    std::uint32_t expected_command_count = 0;
+    for (std::uint32_t draw = 0; draw < draw_count; draw++) {
+        const meshRenderer::CullDrawInfo& info = draws[draw];
+        // Every level but the first is empty with lod_error_scale 0
+        const std::uint32_t gpu_count = counters[1 + draw * MAX_LOD_COUNT];
+        std::vector<std::uint8_t> gpu_visible(instance_count, 0);
+        for (std::uint32_t slot = 0; slot < gpu_count; slot++) {
+            const std::uint32_t instance = visible_instances[info.first_instance * MAX_LOD_COUNT + slot];
+            if (instance >= instance_count || instance_draws[instance] != draw || gpu_visible[instance]) {
+                std::printf("Error: draw %u lists instance %u which is not one of its own or is listed twice\n", draw, instance);
+                failures++;
+                continue;
+            }
+            gpu_visible[instance] = 1;
+        }
+
+        for (std::uint32_t i = info.first_instance; i < info.first_instance + info.instance_count; i++) {
+            if (gpu_visible[i] == cpu_visible[i])
+                continue;
+            if (std::abs(plane_margin(frustum, boxes, i)) < PLANE_TOLERANCE) {
+                borderline++;
+                continue;
+            }
+            std::printf("Error: instance %u of draw %u is %s on the GPU but %s by cull_aabbs\n", i, draw,
+                        gpu_visible[i] ? "visible" : "culled", cpu_visible[i] ? "visible" : "culled");
+            failures++;
+        }
+
+        for (std::uint32_t lod = 1; lod < MAX_LOD_COUNT; lod++) {
+            if (counters[1 + draw * MAX_LOD_COUNT + lod] != 0) {
+                std::printf("Error: draw %u has instances at level %u with only one level\n", draw, lod);
+                failures++;
+            }
+        }
+        visible_total += gpu_count;
+        expected_command_count += gpu_count != 0 ? 1 : 0;
+    }
+
+    // One command per draw with visible instances, in whatever order the atomics handed out the slots
+    if (counters[0] != expected_command_count) {
+        std::printf("Error: %u commands were written, expected %u\n", counters[0], expected_command_count);
+        failures++;
+    }
+    for (std::uint32_t command = 0; command < std::min(counters[0], command_slot_count); command++) {
+        const meshRenderer::DrawCommand& written = written_commands[command];
+        const auto draw = static_cast<std::uint32_t>(std::find_if(draws.begin(), draws.end(), [&](const meshRenderer::CullDrawInfo& info) {
+            return info.first_instance * MAX_LOD_COUNT == written.first_instance;
+        }) - draws.begin());
+        if (draw == draw_count || written.instance_count != counters[1 + draw * MAX_LOD_COUNT] || written.first_index != draws[draw].lods[0].first_index ||
+            written.index_count != draws[draw].lods[0].index_count) {
+            std::printf("Error: command %u doesn't match any draw's visible instances\n", command);
+            failures++;
+        }
+    }
+
+    for (daxa::BufferId buffer : buffers)
+        device.destroy_buffer(buffer);
+    device.collect_garbage();
+
+    std::printf("%u draws, %zu of %u instances visible, %zu borderline boxes ignored, %zu failures\n", draw_count, visible_total, instance_count, borderline, failures);
+    return failures == 0 ? 0 : 1;
+}
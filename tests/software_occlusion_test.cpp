@@ -0,0 +1,257 @@
+/**
+ * Rasterizes random scenes of walls with window holes and boxes into a @ref SoftwareOcclusionBuffer and checks that
+ * - the tiled buffer and tile test agree with the per pixel ones (@ref SoftwareOcclusionBuffer::validate_depth, @ref SoftwareOcclusionBuffer::is_occluded_reference)
+ * - no box the full resolution reference below can see is reported occluded
+ *
+ * The reference draws the source meshes, not their proxies, in double precision at several samples per pixel, anything it sees is really visible
+ *
+ * Usage: software_occlusion_test [scene count]
+ */
+
+#include "Core/Camera.h"
+#include "Core/JobSystem.h"
+#include "Renderer/Culling/OccluderProxy.h"
+#include "Renderer/Culling/SoftwareOcclusion.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int DEFAULT_SCENE_COUNT = 60;
+    constexpr std::size_t BOXES_PER_SCENE = 400;
+    /// @brief Reference samples per buffer pixel along each axis
+    constexpr std::uint32_t SAMPLES_PER_PIXEL = 4;
+    constexpr std::uint32_t REFERENCE_WIDTH = SoftwareOcclusionBuffer::WIDTH * SAMPLES_PER_PIXEL;
+    constexpr std::uint32_t REFERENCE_HEIGHT = SoftwareOcclusionBuffer::HEIGHT * SAMPLES_PER_PIXEL;
+
+    struct Mesh {
+        std::vector<glm::vec3> positions;
+        std::vector<std::uint32_t> indices;
+
+        void add_quad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+            const auto first = static_cast<std::uint32_t>(positions.size());
+            positions.insert(positions.end(), { a, b, c, d });
+            indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+        }
+    };
+
+    struct Occluder {
+        Mesh mesh;
+        glm::mat4 model;
+    };
+
+    /// @brief A unit wall in the xy plane with a window hole, made of the four strips around the hole
+    Mesh wall_with_window(float hole_min_x, float hole_min_y, float hole_max_x, float hole_max_y) {
+        Mesh mesh;
+        auto rect = [&mesh](float min_x, float min_y, float max_x, float max_y) {
+            if (min_x < max_x && min_y < max_y)
+                mesh.add_quad({ min_x, min_y, 0.0f }, { max_x, min_y, 0.0f }, { max_x, max_y, 0.0f }, { min_x, max_y, 0.0f });
+        };
+        rect(0.0f, 0.0f, 1.0f, hole_min_y);
+        rect(0.0f, hole_max_y, 1.0f, 1.0f);
+        rect(0.0f, hole_min_y, hole_min_x, hole_max_y);
+        rect(hole_max_x, hole_min_y, 1.0f, hole_max_y);
+        return mesh;
+    }
+
+    Mesh unit_cube() {
+        Mesh mesh;
+        const glm::vec3 c[8] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } };
+        mesh.add_quad(c[0], c[1], c[2], c[3]);
+        mesh.add_quad(c[4], c[5], c[6], c[7]);
+        mesh.add_quad(c[0], c[1], c[5], c[4]);
+        mesh.add_quad(c[3], c[2], c[6], c[7]);
+        mesh.add_quad(c[0], c[3], c[7], c[4]);
+        mesh.add_quad(c[1], c[2], c[6], c[5]);
+        return mesh;
+    }
+
+    /// @brief A point in reference sample space, @c z is the NDC depth
+    struct ReferenceVertex {
+        double x, y, z;
+    };
+
+    /// @return @c false where @ref SoftwareOcclusionBuffer drops the triangle or box for crossing the near plane
+    bool project(const glm::mat4& view_proj, const glm::mat4& model, const glm::vec3& position, ReferenceVertex& vertex) {
+        double world[4];
+        for (int row = 0; row < 4; row++)
+            world[row] = double(model[0][row]) * position.x + double(model[1][row]) * position.y + double(model[2][row]) * position.z + double(model[3][row]);
+        double clip[4];
+        for (int row = 0; row < 4; row++)
+            clip[row] = double(view_proj[0][row]) * world[0] + double(view_proj[1][row]) * world[1] + double(view_proj[2][row]) * world[2] + double(view_proj[3][row]) * world[3];
+        if (clip[3] <= 0.0 || clip[2] < -clip[3])
+            return false;
+
+        vertex = {
+            (clip[0] / clip[3] * 0.5 + 0.5) * REFERENCE_WIDTH,
+            (clip[1] / clip[3] * 0.5 + 0.5) * REFERENCE_HEIGHT,
+            clip[2] / clip[3],
+        };
+        return true;
+    }
+
+    /// @brief Calls @c visit(index, depth) for every sample inside the triangle, @c inclusive also counts the samples on its edges
+    template <typename Visit>
+    void rasterize_reference(ReferenceVertex v0, ReferenceVertex v1, ReferenceVertex v2, bool inclusive, Visit&& visit) {
+        double area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (area == 0.0)
+            return;
+        if (area < 0.0) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        const int min_x = std::max(static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))) - 1, 0);
+        const int min_y = std::max(static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))) - 1, 0);
+        const int max_x = std::min(static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))), static_cast<int>(REFERENCE_WIDTH) - 1);
+        const int max_y = std::min(static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))), static_cast<int>(REFERENCE_HEIGHT) - 1);
+        for (int y = min_y; y <= max_y; y++) {
+            for (int x = min_x; x <= max_x; x++) {
+                const double px = x + 0.5, py = y + 0.5;
+                const double w0 = (v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x);
+                const double w1 = (v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x);
+                const double w2 = (v1.x - v0.x) * (py - v0.y) - (v1.y - v0.y) * (px - v0.x);
+                const bool inside = inclusive ? (w0 >= 0.0 && w1 >= 0.0 && w2 >= 0.0) : (w0 > 0.0 && w1 > 0.0 && w2 > 0.0);
+                if (inside)
+                    visit(static_cast<std::size_t>(y) * REFERENCE_WIDTH + x, (w0 * v0.z + w1 * v1.z + w2 * v2.z) / area);
+            }
+        }
+    }
+
+    /// @brief Draws the triangles of @c mesh placed by @c model, @c visit is called like for @c rasterize_reference
+    template <typename Visit>
+    void rasterize_reference(const glm::mat4& view_proj, const Mesh& mesh, const glm::mat4& model, bool inclusive, Visit&& visit) {
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            ReferenceVertex v0, v1, v2;
+            if (project(view_proj, model, mesh.positions[mesh.indices[i]], v0) && project(view_proj, model, mesh.positions[mesh.indices[i + 1]], v1) &&
+                project(view_proj, model, mesh.positions[mesh.indices[i + 2]], v2))
+                rasterize_reference(v0, v1, v2, inclusive, visit);
+        }
+    }
+
+    struct SceneResult {
+        std::size_t failures = 0;
+        std::size_t tested = 0;
+        std::size_t occluded = 0;
+    };
+
+    SceneResult run_scene(std::uint32_t seed, const Mesh& cube) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        auto between = [&](float min, float max) { return min + (max - min) * unit(random); };
+
+        Camera camera;
+        camera.position = glm::vec3(between(-2.0f, 2.0f), between(0.0f, 2.0f), between(-2.0f, 2.0f));
+        camera.yaw = -90.0f + between(-30.0f, 30.0f);
+        camera.pitch = between(-10.0f, 10.0f);
+        camera.update_vectors();
+        const float aspect_ratio = static_cast<float>(SoftwareOcclusionBuffer::WIDTH) / static_cast<float>(SoftwareOcclusionBuffer::HEIGHT);
+        const glm::mat4 view_proj = camera.get_projection(aspect_ratio) * camera.get_view_matrix();
+
+        // Walls facing the camera at random angles, some with windows narrower than a pixel, plus solid blocks
+        std::vector<Occluder> occluders;
+        const int wall_count = 2 + static_cast<int>(unit(random) * 6.0f);
+        for (int i = 0; i < wall_count; i++) {
+            const float hole_width = unit(random) < 0.3f ? between(0.001f, 0.02f) : between(0.05f, 0.5f);
+            const float hole_x = between(0.05f, 0.9f);
+            const float hole_y = between(0.05f, 0.8f);
+            Occluder wall{ wall_with_window(hole_x, hole_y, std::min(hole_x + hole_width, 0.95f), std::min(hole_y + between(0.01f, 0.3f), 0.95f)), glm::mat4(1.0f) };
+            wall.model = glm::translate(glm::mat4(1.0f), camera.position + glm::vec3(between(-12.0f, 4.0f), between(-4.0f, 1.0f), -between(4.0f, 30.0f)));
+            wall.model = glm::rotate(wall.model, between(-1.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            wall.model = glm::scale(wall.model, glm::vec3(between(3.0f, 16.0f), between(2.0f, 8.0f), 1.0f));
+            occluders.push_back(std::move(wall));
+        }
+        const int block_count = static_cast<int>(unit(random) * 4.0f);
+        for (int i = 0; i < block_count; i++) {
+            Occluder block{ cube, glm::mat4(1.0f) };
+            block.model = glm::translate(glm::mat4(1.0f), camera.position + glm::vec3(between(-6.0f, 6.0f), between(-3.0f, 2.0f), -between(3.0f, 20.0f)));
+            block.model = glm::rotate(block.model, between(0.0f, 6.28f), glm::normalize(glm::vec3(between(-1.0f, 1.0f), 1.0f, between(-1.0f, 1.0f))));
+            block.model = glm::scale(block.model, glm::vec3(between(0.5f, 4.0f), between(0.5f, 4.0f), between(0.5f, 4.0f)));
+            occluders.push_back(std::move(block));
+        }
+
+        SoftwareOcclusionBuffer buffer;
+        buffer.begin_frame(view_proj);
+        for (const Occluder& occluder : occluders) {
+            // A tight budget on some proxies leaves triangles out, which may only lose culling
+            const std::uint32_t max_triangles = unit(random) < 0.25f ? 3 : OCCLUDER_PROXY_MAX_TRIANGLES;
+            buffer.add_occluder(build_occluder_proxy(occluder.mesh.positions, occluder.mesh.indices, max_triangles), occluder.model);
+        }
+        buffer.rasterize();
+
+        SceneResult result;
+        if (const std::size_t mismatches = buffer.validate_depth(); mismatches != 0) {
+            std::printf("Error: scene %u: the tiled buffer differs from the per pixel reference in %zu pixels\n", seed, mismatches);
+            result.failures++;
+        }
+
+        // What the source meshes really hide, sampled finer than the buffer
+        std::vector<double> reference_depth(static_cast<std::size_t>(REFERENCE_WIDTH) * REFERENCE_HEIGHT, INFINITY);
+        for (const Occluder& occluder : occluders) {
+            rasterize_reference(view_proj, occluder.mesh, occluder.model, false, [&](std::size_t index, double depth) {
+                reference_depth[index] = std::min(reference_depth[index], depth);
+            });
+        }
+
+        for (std::size_t i = 0; i < BOXES_PER_SCENE; i++) {
+            const glm::vec3 center = camera.position + glm::vec3(between(-25.0f, 25.0f), between(-8.0f, 8.0f), -between(1.0f, 60.0f));
+            const glm::vec3 half_size = glm::vec3(between(0.02f, 1.5f), between(0.02f, 1.5f), between(0.02f, 1.5f));
+            const glm::vec3 world_min = center - half_size;
+            const glm::vec3 world_max = center + half_size;
+
+            const bool occluded = buffer.is_occluded(world_min, world_max);
+            result.tested++;
+            if (occluded != buffer.is_occluded_reference(world_min, world_max)) {
+                std::printf("Error: scene %u: the tile test and the per pixel test disagree on box %zu\n", seed, i);
+                result.failures++;
+            }
+            if (!occluded)
+                continue;
+            result.occluded++;
+
+            const glm::mat4 box_model = glm::scale(glm::translate(glm::mat4(1.0f), world_min), world_max - world_min);
+            bool visible = false;
+            rasterize_reference(view_proj, cube, box_model, true, [&](std::size_t index, double depth) {
+                visible = visible || depth < reference_depth[index];
+            });
+            if (visible) {
+                std::printf("Error: scene %u: box %zu (%g, %g, %g) to (%g, %g, %g) is visible but was reported occluded\n", seed, i,
+                            world_min.x, world_min.y, world_min.z, world_max.x, world_max.y, world_max.z);
+                result.failures++;
+            }
+        }
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    const int scene_count = argc > 1 ? std::atoi(argv[1]) : DEFAULT_SCENE_COUNT;
+    jobs::job_system.init();
+
+    const Mesh cube = unit_cube();
+    SceneResult total;
+    for (int scene = 0; scene < scene_count; scene++) {
+        const SceneResult result = run_scene(static_cast<std::uint32_t>(scene), cube);
+        total.failures += result.failures;
+        total.tested += result.tested;
+        total.occluded += result.occluded;
+    }
+    jobs::job_system.shutdown();
+
+    std::printf("%d scenes, %zu of %zu boxes occluded, %zu failures\n", scene_count, total.occluded, total.tested, total.failures);
+    // A buffer that never occludes anything would pass every other check
+    if (total.occluded == 0) {
+        std::printf("Error: no box was ever occluded\n");
+        return 1;
+    }
+    return total.failures == 0 ? 0 : 1;
+}